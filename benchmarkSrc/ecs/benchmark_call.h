@@ -3,6 +3,7 @@
 #include <benchmark/benchmark.h>
 
 #include "../../src/ecs/engine.h"
+#include "../../src/ecs/archetype_engine_core.h"
 
 //Screen dimension constants
 const int SCREEN_WIDTH = 640;
@@ -188,3 +189,84 @@ static void BM_ECSCall2(benchmark::State &state) {
 }
 
 //BENCHMARK(BM_ECSCall2)->RangeMultiplier(2)->Range(8, 8 << 6)->MinTime(2);
+
+static void BM_ECSCallArchetype(benchmark::State &state) {
+    int numEntities = state.range(0);
+
+    auto engine = new ECS::Engine(new ECS::ArchetypeEngineCore());
+
+    ECSSetup(numEntities, engine);
+
+    for (auto _ : state) {
+        ECSGameLoop2(numEntities, engine);
+    }
+}
+
+//BENCHMARK(BM_ECSCallArchetype)->RangeMultiplier(2)->Range(8, 8 << 6)->MinTime(2);
+
+///
+struct Position {
+    float x, y;
+};
+
+struct Speed {
+    float x, y;
+};
+
+SparseSetComponent(Position);
+SparseSetComponent(Speed);
+FloatArraysComponent(Position, 2);
+FloatArraysComponent(Speed, 2);
+
+template <typename T>
+void ECSBatchSetup(int numEntities, ECS::Engine<T> *engine) {
+    if constexpr (std::is_same_v<T, ECS::DefaultEngineCore>) {
+        engine->template CreateOwnedGroup<Position, Speed>();
+    }
+
+    for (int i = 0; i < numEntities; i++) {
+        auto entity = engine->CreateEntity();
+
+        engine->AddComponent(entity, Position{0, 0});
+        engine->AddComponent(entity, Speed{1000, 1000});
+    }
+}
+
+static void BM_ECSEach(benchmark::State &state) {
+    auto engine = new ECS::Engine(new ECS::DefaultEngineCore());
+    float dt = 0.01;
+
+    ECSBatchSetup(state.range(0), engine);
+
+    for (auto _ : state) {
+        engine->ParallelEach<Position, Speed>([dt](auto &, Position &position, Speed &speed) {
+            position.x += dt * speed.x;
+            position.y += dt * speed.y;
+        });
+    }
+}
+
+//BENCHMARK(BM_ECSEach)->RangeMultiplier(4)->Range(1 << 10, 1 << 16)->MinTime(1);
+
+// The owned group's prefix is handed to the loop as the pools' own float arrays
+template <typename T>
+void BM_ECSEachBatch(benchmark::State &state) {
+    auto engine = new ECS::Engine(new T());
+    float dt = 0.01;
+
+    ECSBatchSetup(state.range(0), engine);
+
+    for (auto _ : state) {
+        engine->template ParallelEachBatch<Position, Speed>([dt](auto &, auto &batch) {
+            float *position = batch.template Write<0>();
+            const float *speed = batch.template Read<1>();
+
+            for (size_t i = 0; i < 2 * batch.size(); i++) {
+                position[i] += dt * speed[i];
+            }
+        });
+    }
+}
+
+//BENCHMARK_TEMPLATE(BM_ECSEachBatch, ECS::DefaultEngineCore)->RangeMultiplier(4)->Range(1 << 10, 1 << 16)->MinTime(1);
+//BENCHMARK_TEMPLATE(BM_ECSEachBatch, ECS::ArchetypeEngineCore)->RangeMultiplier(4)->Range(1 << 10, 1 << 16)->MinTime(1);
@@ -21,11 +21,17 @@ struct Exit {
     Exit(int playerScoreID) : playerScoreID(playerScoreID) {}
 };
 
-struct PlayerCollision {};
-
-struct WallCollision {};
+// BIECS::CollisionLayer categories
+enum Layers : uint32_t {
+    PLAYER_LAYER = 1 << 0,
+    BALL_LAYER = 1 << 1,
+    WALL_LAYER = 1 << 2,
+    EXIT_LAYER = 1 << 3
+};
 
-struct ExitCollision {};
+inline bool Involves(const BIECS::Collision &collision, uint32_t layer) {
+    return (collision.categories[0] | collision.categories[1]) & layer;
+}
 
 struct ScoreBoard {
     bool dirty = true;
@@ -66,7 +66,7 @@ void RunPongGame() {
     engine->Register([&gameContext]() {
         const float movementSpeed = 1500;
 
-        for (auto [velocity, playerMovement] : gameContext.engine->GetGroupView<Velocity2D, Pong::PlayerMovement>()) {
+        for (auto [velocity, playerMovement] : gameContext.engine->GetGroupView<Velocity2D, const Pong::PlayerMovement>()) {
             int direction = 0;
 
             if (gameContext.window->GetKeystate(playerMovement.keyUp)) {
@@ -82,59 +82,27 @@ void RunPongGame() {
     });
 
     engine->Register([ctx]() {
-        for (auto [entity, transform2D, velocity] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, Velocity2D>()) {
-            //transform2D += (*ctx->dt) * velocity;
-
-            NewTransform2D newTransform = transform2D;
-            newTransform += (*ctx->dt) * velocity;
-            ctx->engine->AddComponent(entity, newTransform);
-        }
-    });
-
-    std::vector<BIECS::CollisionFilter> filters;
-
-    filters.push_back([](ECS::Entity collisionEnt, const Collision & collision, GameContext * ctx) {
-        auto ent1 = collision.entities[0];
-        auto ent2 = collision.entities[1];
-
-        if (ctx->engine->GetComponent<PlayerMovement>(ent1) || ctx->engine->GetComponent<PlayerMovement>(ent2)) {
-            ctx->engine->AddComponent(collisionEnt, PlayerCollision());
-        }
-    });
-
-    filters.push_back([](ECS::Entity collisionEnt, const Collision & collision, GameContext * ctx) {
-        auto ent1 = collision.entities[0];
-        auto ent2 = collision.entities[1];
-
-        if (ctx->engine->GetComponent<Wall>(ent1) && ctx->engine->GetComponent<Wall>(ent2)) {
-            return;
-        }
-
-        if (ctx->engine->GetComponent<Wall>(ent1) || ctx->engine->GetComponent<Wall>(ent2)) {
-            ctx->engine->AddComponent(collisionEnt, WallCollision());
-        }
-    });
-
-    filters.push_back([](ECS::Entity collisionEnt, const Collision & collision, GameContext * ctx) {
-        auto ent1 = collision.entities[0];
-        auto ent2 = collision.entities[1];
-
-        if (ctx->engine->GetComponent<Exit>(ent1) || ctx->engine->GetComponent<Exit>(ent2)) {
-            ctx->engine->AddComponent(collisionEnt, ExitCollision());
+        // Transform2D is buffered, the view hands out the next transforms
+        for (auto [transform2D, velocity] : ctx->engine->GetGroupView<Transform2D, const Velocity2D>()) {
+            transform2D += (*ctx->dt) * velocity;
         }
     });
 
-    engine->Register(new BIECS::CollisionDetectionSystem(&gameContext, filters));
+    engine->Register(new BIECS::CollisionDetectionSystem(&gameContext));
 
     engine->Register([&ctx]() {
         const float ballVelocity = 1500;
         const float maxAngle = glm::pi<float>() * 0.3f;
 
-        for (auto [collision] : ctx->engine->GetGroupView<Collision>(ECS::Unused<PlayerCollision>())) {
+        for (auto &collision : ctx->engine->GetEvents<Collision>()) {
+            if (!Involves(collision, PLAYER_LAYER)) {
+                continue;
+            }
+
             auto player = collision.entities[0];
             auto ball = collision.entities[1];
 
-            if (ctx->engine->GetComponent<PlayerMovement>(ball)) {
+            if (ctx->engine->GetComponent<const PlayerMovement>(ball)) {
                 std::swap(player, ball);
             }
 
@@ -144,13 +112,13 @@ void RunPongGame() {
                 continue;
             }
 
-            Collider ballCollider = *ctx->engine->GetComponent<Collider>(ball);
+            Collider ballCollider = *ctx->engine->GetComponent<const Collider>(ball);
             {
-                auto ballTransform = *ctx->engine->GetComponent<Transform2D>(ball);
+                auto ballTransform = *ctx->engine->GetComponent<const Transform2D>(ball);
                 ballCollider.x += ballTransform.x;
                 ballCollider.y += ballTransform.y;
 
-                auto ballScalingPtr = ctx->engine->GetComponent<Scaling>(ball);
+                auto ballScalingPtr = ctx->engine->GetComponent<const Scaling>(ball);
 
                 if (ballScalingPtr) {
                     ballCollider.w *= ballScalingPtr->x;
@@ -158,13 +126,13 @@ void RunPongGame() {
                 }
             }
 
-            Collider playerCollider = *ctx->engine->GetComponent<Collider>(player);
+            Collider playerCollider = *ctx->engine->GetComponent<const Collider>(player);
             {
-                auto playerTransform = *ctx->engine->GetComponent<Transform2D>(player);
+                auto playerTransform = *ctx->engine->GetComponent<const Transform2D>(player);
                 playerCollider.x += playerTransform.x;
                 playerCollider.y += playerTransform.y;
 
-                auto playerScalingPtr = ctx->engine->GetComponent<Scaling>(player);
+                auto playerScalingPtr = ctx->engine->GetComponent<const Scaling>(player);
 
                 if (playerScalingPtr) {
                     playerCollider.w *= playerScalingPtr->x;
@@ -181,12 +149,17 @@ void RunPongGame() {
 
             *ballVelocityPtr = glm::normalize(Velocity2D(xDirection * glm::cos(angle), glm::sin(angle))) * ballVelocity;
 
-            ctx->engine->DeleteComponents<NewTransform2D>(ball);
+            // The ball stays where it is this frame
+            *ctx->engine->GetNextComponent<Transform2D>(ball) = *ctx->engine->GetComponent<const Transform2D>(ball);
         }
     });
 
     engine->Register([&ctx]() {
-        for (auto [collision] : ctx->engine->GetGroupView<Collision>(ECS::Unused<WallCollision>())) {
+        for (auto &collision : ctx->engine->GetEvents<Collision>()) {
+            if (!Involves(collision, WALL_LAYER)) {
+                continue;
+            }
+
             auto ent1 = collision.entities[0];
             auto ent2 = collision.entities[1];
 
@@ -195,12 +168,12 @@ void RunPongGame() {
 
             Transform2D wallPos;
 
-            if (ctx->engine->GetComponent<Wall>(ent1)) {
-                wallPos = *ctx->engine->GetComponent<Transform2D>(ent1);
+            if (collision.categories[0] & WALL_LAYER) {
+                wallPos = *ctx->engine->GetComponent<const Transform2D>(ent1);
                 std::swap(ent1, ent2);
                 std::swap(vel1, vel2);
             } else {
-                wallPos = *ctx->engine->GetComponent<Transform2D>(ent2);
+                wallPos = *ctx->engine->GetComponent<const Transform2D>(ent2);
             }
 
             if (!vel1) {
@@ -208,42 +181,43 @@ void RunPongGame() {
             }
 
             vel1->y *= -1.0f;
-            ctx->engine->DeleteComponents<NewTransform2D>(ent1);
+            *ctx->engine->GetNextComponent<Transform2D>(ent1) = *ctx->engine->GetComponent<const Transform2D>(ent1);
         }
     });
 
     const float ballStartingSpeed = 1000;
 
     engine->Register([&ctx, &ballStartingSpeed]() {
-        for (auto [collision] : ctx->engine->GetGroupView<Collision>(ECS::Unused<ExitCollision>())) {
+        for (auto &collision : ctx->engine->GetEvents<Collision>()) {
+            if (!Involves(collision, EXIT_LAYER)) {
+                continue;
+            }
+
             auto ent1 = collision.entities[0];
             auto ent2 = collision.entities[1];
 
-            auto transform1 = ctx->engine->GetComponent<NewTransform2D>(collision.entities[0]);
-            auto transform2 = ctx->engine->GetComponent<NewTransform2D>(collision.entities[1]);
-
             int playerScoreID = 0;
 
-            auto exitComponent = ctx->engine->GetComponent<Exit>(ent1);
+            auto exitComponent = ctx->engine->GetComponent<const Exit>(ent1);
 
             if (exitComponent) {
                 std::swap(ent1, ent2);
-                std::swap(transform1, transform2);
             } else {
-                exitComponent = ctx->engine->GetComponent<Exit>(ent2);
+                exitComponent = ctx->engine->GetComponent<const Exit>(ent2);
             }
 
             playerScoreID = exitComponent->playerScoreID;
+            auto transform1 = ctx->engine->GetNextComponent<Transform2D>(ent1);
 
             if (!transform1) {
                 continue;
             }
 
-            auto texture = *ctx->engine->GetComponent<SharedTexturePtr>(ent1);
-            auto scaling = ctx->engine->GetComponent<Scaling>(ent1);
+            auto texture = *ctx->engine->GetComponent<const SharedTexturePtr>(ent1);
+            auto scaling = ctx->engine->GetComponent<const Scaling>(ent1);
 
             // Move ball to center
-            *transform1 = NewTransform2D((ctx->window->GetPosition().w - texture->w * scaling->x) / 2, (ctx->window->GetPosition().h - texture->h * scaling->y) / 2);
+            *transform1 = Transform2D((ctx->window->GetPosition().w - texture->w * scaling->x) / 2, (ctx->window->GetPosition().h - texture->h * scaling->y) / 2);
             auto velocity = ctx->engine->GetComponent<Velocity2D>(ent1);
             *velocity = glm::normalize(*velocity) * ballStartingSpeed;
 
@@ -259,7 +233,7 @@ void RunPongGame() {
         static auto font = ctx->resourceManager->LoadShared<Engine::Font>(Engine::FontLoadArgs("consola.ttf", 25));
         static auto ttfManager = ctx->resourceManager->GetUniqueManager<Engine::Texture, Engine::TTFTextureLoadArgs>();
 
-        for (auto [entity, scoreBoard, transform2, scaling, centered, texture] : ctx->engine->GetGroupView<ECS::Entity, ScoreBoard, Transform2D, Scaling, Centered>(ECS::Optional<UniqueTexturePtr>())) {
+        for (auto [entity, scoreBoard, transform2, scaling, centered, texture] : ctx->engine->GetGroupView<ECS::Entity, ScoreBoard, Transform2D, const Scaling, const Centered>(ECS::Optional<const UniqueTexturePtr>())) {
             if (scoreBoard.dirty) {
                 auto ttf = ttfManager->Load(font.get(), std::to_string(scoreBoard.scores[0]) + " - " + std::to_string(scoreBoard.scores[1]), Engine::Color(255, 0, 0));
 
@@ -273,15 +247,6 @@ void RunPongGame() {
         }
     });
 
-    engine->Register(new BIECS::CollisionClearSystem(&gameContext));
-
-    engine->Register([ctx]() {
-        for (auto [entity, transform2D, newTransform] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, NewTransform2D>()) {
-            transform2D = newTransform;
-            ctx->engine->DeleteComponents<NewTransform2D>(entity);
-        }
-    });
-
     engine->Register(new BIECS::TextureRendererSystem(&gameContext));
 
     // Set entities and components
@@ -308,6 +273,7 @@ void RunPongGame() {
         engine->AddComponent(player, VelocityMoved());
         engine->AddComponent(player, Collider(0, 0, 2, texture->h));
         engine->AddComponent(player, Pong::PlayerMovement(Engine::Scancode::SCANCODE_UP, Engine::Scancode::SCANCODE_DOWN));
+        engine->AddComponent(player, CollisionLayer(PLAYER_LAYER, BALL_LAYER | WALL_LAYER | EXIT_LAYER));
     }
 
     // Left player
@@ -323,6 +289,7 @@ void RunPongGame() {
         engine->AddComponent(player, VelocityMoved());
         engine->AddComponent(player, Collider(0, 0, 2, texture->h));
         engine->AddComponent(player, Pong::PlayerMovement(Engine::Scancode::SCANCODE_W, Engine::Scancode::SCANCODE_S));
+        engine->AddComponent(player, CollisionLayer(PLAYER_LAYER, BALL_LAYER | WALL_LAYER | EXIT_LAYER));
     }
 
     // Ball
@@ -337,6 +304,7 @@ void RunPongGame() {
         engine->AddComponent(ball, VelocityMoved());
         engine->AddComponent(ball, Velocity2D(glm::normalize(Velocity2D(1, 1)) * ballStartingSpeed));
         engine->AddComponent(ball, Collider(0, 0, texture->w, texture->h));
+        engine->AddComponent(ball, CollisionLayer(BALL_LAYER, PLAYER_LAYER | WALL_LAYER | EXIT_LAYER));
     }
 
     // Screen edges colliders
@@ -348,21 +316,29 @@ void RunPongGame() {
         engine->AddComponent(up, Collider(0, 0, windowPos.w + 2 * colliderSize, colliderSize));
         engine->AddComponent(up, Transform2D(-colliderSize, -colliderSize));
         engine->AddComponent(up, Wall());
+        engine->AddComponent(up, StaticCollider());
+        engine->AddComponent(up, CollisionLayer(WALL_LAYER, PLAYER_LAYER | BALL_LAYER));
 
         auto down = engine->CreateEntity();
         engine->AddComponent(down, Collider(0, 0, windowPos.w + colliderSize, colliderSize));
         engine->AddComponent(down, Transform2D(-colliderSize, windowPos.h + colliderSize));
         engine->AddComponent(down, Wall());
+        engine->AddComponent(down, StaticCollider());
+        engine->AddComponent(down, CollisionLayer(WALL_LAYER, PLAYER_LAYER | BALL_LAYER));
 
         auto left = engine->CreateEntity();
         engine->AddComponent(left, Collider(0, 0, colliderSize, windowPos.h));
         engine->AddComponent(left, Transform2D(-colliderSize, 0));
         engine->AddComponent(left, Exit(1));
+        engine->AddComponent(left, StaticCollider());
+        engine->AddComponent(left, CollisionLayer(EXIT_LAYER, PLAYER_LAYER | BALL_LAYER));
 
         auto right = engine->CreateEntity();
         engine->AddComponent(right, Collider(0, 0, colliderSize, windowPos.h));
         engine->AddComponent(right, Transform2D(windowPos.w, 0));
         engine->AddComponent(right, Exit(0));
+        engine->AddComponent(right, StaticCollider());
+        engine->AddComponent(right, CollisionLayer(EXIT_LAYER, PLAYER_LAYER | BALL_LAYER));
     }
 
     const int TARGET_FRAMERATE = 1000;
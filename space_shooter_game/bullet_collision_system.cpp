@@ -12,6 +12,7 @@ void BulletCollisionSystem::Update() {
 
         if (hp) {
             *hp = (*hp) - 1;
+            engine->MarkChanged<Health>(entity);
             if (*hp == 0) {
                 entitiesToRemove.push_back(entity);
             }
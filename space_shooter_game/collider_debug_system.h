@@ -17,7 +17,7 @@ class ColliderDebugSystem : public ECS::SystemInterface {
         auto fontManager = ctx->resourceManager->GetSharedManager<Engine::Font, Engine::FontLoadArgs>();
         auto ttfManager = ctx->resourceManager->GetUniqueManager<Engine::Texture, Engine::TTFTextureLoadArgs>();
 
-        for (const auto &[entity, oldCollider, transform2D, optScaling, optVelocity] : ctx->engine->GetGroupView<ECS::Entity, Collider, Transform2D>(ECS::Optional<Scaling, Velocity2D>())) {
+        for (const auto &[entity, oldCollider, transform2D, optScaling, optVelocity] : ctx->engine->GetGroupView<ECS::Entity, Collider, const Transform2D>(ECS::Optional<Scaling, Velocity2D>())) {
             Scaling scaling(1, 1);
 
             if (optScaling) {
@@ -53,7 +53,7 @@ class ColliderDebugSystem : public ECS::SystemInterface {
 
             {
                 static auto font = fontManager->Load("consola.ttf", 30);
-                auto ttf = ttfManager->Load(font.get(), std::to_string(entity), Engine::Color(255, 0, 255));
+                auto ttf = ttfManager->Load(font.get(), std::to_string(entity.GetId()), Engine::Color(255, 0, 255));
                 ctx->window->GetRenderer()->DrawTexture(
                     collider.x + collider.w, collider.y + 20,
                     ttf.get());
@@ -1,54 +1,111 @@
 #include "collision_detection_system.h"
 
+#include <algorithm>
+
 namespace SpaceShooter {
 
-static bool CollidesX(Collider &a, Collider &b) {
-    return (a.x >= b.x && a.x <= b.x + b.w) ||
-           (b.x >= a.x && b.x <= a.x + a.w);
+static Collider ToWorld(const Collider &colliderOriginal, const Transform2D &transform2D, const Scaling *optScaling) {
+    Scaling scaling(1, 1);
+
+    if (optScaling) {
+        scaling = *optScaling;
+    }
+
+    Collider collider = colliderOriginal;
+
+    collider.x += transform2D.x;
+    collider.y += transform2D.y;
+
+    collider.w *= scaling.x;
+    collider.h *= scaling.y;
+    return collider;
 }
 
-static bool CollidesY(Collider &a, Collider &b) {
-    return (a.y >= b.y && a.y <= b.y + b.h) ||
-           (b.y >= a.y && b.y <= a.y + a.h);
+static bool SameColliders(const std::vector<std::pair<ECS::Entity, Collider>> &a, const std::vector<std::pair<ECS::Entity, Collider>> &b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](auto &x, auto &y) {
+        return x.first == y.first && x.second.x == y.second.x && x.second.y == y.second.y &&
+               x.second.w == y.second.w && x.second.h == y.second.h;
+    });
 }
 
-static bool Collides(Collider &a, Collider &b) {
-    return CollidesX(a, b) && CollidesY(b, a);
+// The static grid is only rebuilt when a static collider was added, removed, moved or resized
+void CollisionDetectionSystem::UpdateStaticLayer() {
+    if (!staticQuery.IsValid()) {
+        staticQuery = engine->CreateQuery<ECS::Entity, const Transform2D, const Collider>(ECS::Optional<const Scaling>(), ECS::Unused<StaticCollider>());
+    }
+
+    currentStaticColliders.clear();
+
+    for (auto const &[entity, transform2D, colliderOriginal, optScaling] : engine->GetGroupView(staticQuery)) {
+        currentStaticColliders.push_back({entity, ToWorld(colliderOriginal, *engine->GetLatestComponent<Transform2D>(entity), optScaling)});
+    }
+
+    if (SameColliders(currentStaticColliders, staticColliders)) {
+        return;
+    }
+
+    std::swap(staticColliders, currentStaticColliders);
+    staticGrid.Clear();
+    staticBoxes.Clear();
+
+    for (auto &[entity, collider] : staticColliders) {
+        staticGrid.Insert(collider);
+        staticBoxes.Push(collider);
+    }
+
+    staticGrid.Build();
 }
 
 void CollisionDetectionSystem::Update() {
     entitiesColliders.clear();
+    grid.Clear();
+    boxes.Clear();
+    UpdateStaticLayer();
 
-    for (auto const &[entity, oldTransform, colliderOriginal, optNewTranform, optScaling] : engine->GetGroupView<ECS::Entity, Transform2D, Collider>(ECS::Optional<NewTransform2D, Scaling>())) {
-        Scaling scaling(1, 1);
+    if (!query.IsValid()) {
+        query = engine->CreateQuery<ECS::Entity, const Transform2D, const Collider>(ECS::Optional<const Scaling, const StaticCollider>());
+    }
 
-        if (optScaling) {
-            scaling = *optScaling;
+    // The bodies moved this frame are tested at their next transforms
+    for (auto const &[entity, transform2D, colliderOriginal, optScaling, optStatic] : engine->GetGroupView(query)) {
+        if (optStatic) {
+            continue;
         }
 
-        Transform2D transform2D = oldTransform;
+        Collider collider = ToWorld(colliderOriginal, *engine->GetLatestComponent<Transform2D>(entity), optScaling);
+        entitiesColliders.push_back({entity, collider});
+        grid.Insert(collider);
+        boxes.Push(collider);
+    }
+
+    auto &events = engine->GetEvents<Collision>();
 
-        if (optNewTranform) {
-            transform2D = *optNewTranform;
-        }
+    auto &pairs = grid.FindPairs();
+    std::vector<unsigned int> candidates;
 
-        Collider collider = colliderOriginal;
+    // The pairs are sorted, so the candidates of each collider are tested as one block
+    for (size_t first = 0; first < pairs.size();) {
+        unsigned int i = pairs[first].first;
+        candidates.clear();
 
-        collider.x += transform2D.x;
-        collider.y += transform2D.y;
+        for (; first < pairs.size() && pairs[first].first == i; first++) {
+            candidates.push_back(pairs[first].second);
+        }
 
-        collider.w *= scaling.x;
-        collider.h *= scaling.y;
-        entitiesColliders.push_back({entity, collider});
+        BIECS::Kernels::ForEachOverlap(entitiesColliders[i].second, boxes, candidates.data(), candidates.size(), [&](unsigned int j) {
+            events.Publish(Collision(entitiesColliders[i].first, entitiesColliders[j].first));
+        });
     }
 
-    for (size_t i = 0; i < entitiesColliders.size(); i++) {
-        for (size_t j = i + 1; j < entitiesColliders.size(); j++) {
-            if (Collides(entitiesColliders[i].second, entitiesColliders[j].second)) {
-                auto collision = engine->CreateEntity();
-                engine->AddComponent(collision, Collision(entitiesColliders[i].first, entitiesColliders[j].first));
-            }
-        }
+    // Static colliders are never tested against each other
+    for (auto &[entity, collider] : entitiesColliders) {
+        staticGrid.Query(collider, candidates);
+        auto dynamicEntity = entity;
+
+        BIECS::Kernels::ForEachOverlap(collider, staticBoxes, candidates.data(), candidates.size(), [&](unsigned int j) {
+            auto staticEntity = staticColliders[j].first;
+            events.Publish(dynamicEntity < staticEntity ? Collision(dynamicEntity, staticEntity) : Collision(staticEntity, dynamicEntity));
+        });
     }
 }
 };
@@ -2,6 +2,8 @@
 
 #include "../src/ecs/engine.h"
 #include "../src/engine/window.h"
+#include "../src/engine/spatial_hash_grid.h"
+#include "../src/biecs/systems/physics/kernels.h"
 #include "components.h"
 
 namespace SpaceShooter {
@@ -14,6 +16,17 @@ class CollisionDetectionSystem : public ECS::SystemInterface {
     Collider &windowPos;
 
     std::vector<std::pair<ECS::Entity, Collider>> entitiesColliders;
+    Engine::SpatialHashGrid grid;
+    BIECS::Kernels::BoxArrays boxes;
+    ECS::Query<std::tuple<ECS::Entity, const Transform2D, const Collider>, std::tuple<const Scaling, const StaticCollider>> query;
+
+    std::vector<std::pair<ECS::Entity, Collider>> staticColliders;
+    std::vector<std::pair<ECS::Entity, Collider>> currentStaticColliders;
+    Engine::SpatialHashGrid staticGrid;
+    BIECS::Kernels::BoxArrays staticBoxes;
+    ECS::Query<std::tuple<ECS::Entity, const Transform2D, const Collider>, std::tuple<const Scaling>> staticQuery;
+
+    void UpdateStaticLayer();
 
   public:
     CollisionDetectionSystem(Engine::Window* &window,
@@ -22,6 +35,11 @@ class CollisionDetectionSystem : public ECS::SystemInterface {
                              Collider &windowPos):
         window(window), dt(dt), engine(engine), windowPos(windowPos) {}
 
+    void SetCellSize(float cellSize) {
+        grid.SetCellSize(cellSize);
+        staticGrid.SetCellSize(cellSize);
+    }
+
     virtual void Update() override;
 };
 
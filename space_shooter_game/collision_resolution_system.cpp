@@ -1,16 +1,15 @@
 #include "collision_resolution_system.h"
 
-#include <unordered_set>
-
 namespace SpaceShooter {
 
 struct CollidingEntity {
-    Transform2D *oldTransform2D;
+    ECS::Entity entity;
+    const Transform2D *oldTransform2D;
     Velocity2D *velocity;
-    Transform2D *transform2D;
-    Collider *collider;
-    Scaling *scaling;
-    ReflectCollider *reflectCollider;
+    const Transform2D *transform2D;
+    const Collider *collider;
+    const Scaling *scaling;
+    const ReflectCollider *reflectCollider;
     float invMass = 1;
     float restitution = 1;
 };
@@ -60,41 +59,37 @@ static void ResolveCollision2(CollidingEntity A, CollidingEntity B) {
     (*A.velocity) = ((*A.velocity) - 2 * glm::dot(*A.velocity, normal) * normal);
 }
 
+// The bodies moved this frame are resolved at their next transforms, the resolved transforms are written to the
+// next ones
 void CollisionResolutionSystem::Update() {
-    std::vector<ECS::Entity> entities;
-    std::unordered_set<ECS::Entity> newTransformRemove;
-
-    for (const auto &[entity, collision] : ctx->engine->GetGroupView<ECS::Entity, Collision>()) {
-        entities.push_back(entity);
+    for (const auto &collision : ctx->engine->GetEvents<Collision>()) {
+        // Either side may have been deleted since the collision was recorded
+        if (!ctx->engine->IsAlive(collision.entities[0]) || !ctx->engine->IsAlive(collision.entities[1])) {
+            continue;
+        }
 
         CollidingEntity ent1, ent2;
 
+        ent1.entity = collision.entities[0];
+        ent2.entity = collision.entities[1];
+
         ent1.velocity = ctx->engine->GetComponent<Velocity2D>(collision.entities[0]);
         ent2.velocity = ctx->engine->GetComponent<Velocity2D>(collision.entities[1]);
 
-        ent1.transform2D = ctx->engine->GetComponent<NewTransform2D>(collision.entities[0]);
-
-        if (ent1.transform2D == nullptr) {
-            ent1.transform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[0]);
-        }
+        ent1.oldTransform2D = ctx->engine->GetComponent<const Transform2D>(collision.entities[0]);
+        ent2.oldTransform2D = ctx->engine->GetComponent<const Transform2D>(collision.entities[1]);
 
-        ent1.oldTransform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[0]);
-        ent2.oldTransform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[1]);
+        ent1.transform2D = ctx->engine->GetLatestComponent<Transform2D>(collision.entities[0]);
+        ent2.transform2D = ctx->engine->GetLatestComponent<Transform2D>(collision.entities[1]);
 
-        ent2.transform2D = ctx->engine->GetComponent<NewTransform2D>(collision.entities[1]);
+        ent1.collider = ctx->engine->GetComponent<const Collider>(collision.entities[0]);
+        ent2.collider = ctx->engine->GetComponent<const Collider>(collision.entities[1]);
 
-        if (ent2.transform2D == nullptr) {
-            ent2.transform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[1]);
-        }
+        ent1.reflectCollider = ctx->engine->GetComponent<const ReflectCollider>(collision.entities[0]);
+        ent2.reflectCollider = ctx->engine->GetComponent<const ReflectCollider>(collision.entities[1]);
 
-        ent1.collider = ctx->engine->GetComponent<Collider>(collision.entities[0]);
-        ent2.collider = ctx->engine->GetComponent<Collider>(collision.entities[1]);
-
-        ent1.reflectCollider = ctx->engine->GetComponent<ReflectCollider>(collision.entities[0]);
-        ent2.reflectCollider = ctx->engine->GetComponent<ReflectCollider>(collision.entities[1]);
-
-        ent1.scaling = ctx->engine->GetComponent<Scaling>(collision.entities[0]);
-        ent2.scaling = ctx->engine->GetComponent<Scaling>(collision.entities[1]);
+        ent1.scaling = ctx->engine->GetComponent<const Scaling>(collision.entities[0]);
+        ent2.scaling = ctx->engine->GetComponent<const Scaling>(collision.entities[1]);
 
         if (ent1.velocity == nullptr && ent2.velocity == nullptr) {
             //LOG_INFO("debug", "Collision ignored");
@@ -132,11 +127,8 @@ void CollisionResolutionSystem::Update() {
             ent2.restitution = 0.9;
             ResolveCollision(ent1, ent2);
 
-            *(ent1.oldTransform2D) += *(ctx->dt) * (*ent1.velocity);
-            *(ent2.oldTransform2D) += *(ctx->dt) * (*ent2.velocity);
-
-            //newTransformRemove.insert(collision.entities[0]);
-            //newTransformRemove.insert(collision.entities[1]);
+            *ctx->engine->GetNextComponent<Transform2D>(ent1.entity) = *(ent1.oldTransform2D) + *(ctx->dt) * (*ent1.velocity);
+            *ctx->engine->GetNextComponent<Transform2D>(ent2.entity) = *(ent2.oldTransform2D) + *(ctx->dt) * (*ent2.velocity);
             continue;
         }
 
@@ -151,16 +143,7 @@ void CollisionResolutionSystem::Update() {
 
         ResolveCollision2(ent1, ent2);
 
-        *(ent1.oldTransform2D) += *(ctx->dt) * 2.0f * (*ent1.velocity);
-
-        //newTransformRemove.insert(collision.entities[0]);
-        //newTransformRemove.insert(collision.entities[1]);
-    }
-
-    ctx->engine->DeleteEntities(entities);
-
-    for (auto ent : newTransformRemove) {
-        ctx->engine->DeleteComponents<NewTransform2D>(ent);
+        *ctx->engine->GetNextComponent<Transform2D>(ent1.entity) = *(ent1.oldTransform2D) + *(ctx->dt) * 2.0f * (*ent1.velocity);
     }
 }
 };
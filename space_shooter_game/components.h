@@ -33,12 +33,6 @@ struct Scaling : public Transform2D {
     Scaling() : Transform2D(0, 0) {}
 };
 
-struct NewTransform2D : public Transform2D {
-    template <typename... T>
-    NewTransform2D(T... args) : Transform2D(args...) {
-    }
-};
-
 struct RenderRect : public Engine::Rectangle {
     template <typename... T>
     RenderRect(T... args) : Rectangle(args...) {
@@ -98,8 +92,26 @@ struct Collision {
 
 struct ReflectCollider {};
 
+// Colliders that never move, CollisionDetectionSystem keeps them in a separate grid that is rebuilt only when
+// one of them changes
+struct StaticCollider {};
+
 struct DestroyOnCollision {};
 
 struct Rigidbody {};
 
 }
+
+// Moved by the physics and by the collision resolution, their next transforms become current at the end of the frame
+BufferedSparseSetComponent(SpaceShooter::Transform2D);
+
+// Sought by entity in the collision resolution, which the sparse table answers in O(1)
+SparseSetComponent(SpaceShooter::Scaling);
+SparseSetComponent(SpaceShooter::Collider);
+SparseSetComponent(SpaceShooter::Velocity2D);
+
+// Joined with Transform2D by the renderers
+SparseSetComponent(SpaceShooter::RenderRect);
+
+// Added on a collision and removed once it is handled
+SparseSetComponent(SpaceShooter::Colliding);
@@ -100,21 +100,25 @@ void SpaceShooterGameWithSystems(Engine::Window *window) {
         engine->AddComponent(up, Collider(0, 0, windowPos.w + 2 * colliderSize, colliderSize));
         engine->AddComponent(up, Transform2D(-colliderSize, -colliderSize));
         engine->AddComponent(up, ReflectCollider());
+        engine->AddComponent(up, StaticCollider());
 
         auto down = engine->CreateEntity();
         engine->AddComponent(down, Collider(0, 0, windowPos.w + colliderSize, colliderSize));
         engine->AddComponent(down, Transform2D(-colliderSize, windowPos.h + colliderSize));
         engine->AddComponent(down, ReflectCollider());
+        engine->AddComponent(down, StaticCollider());
 
         auto left = engine->CreateEntity();
         engine->AddComponent(left, Collider(0, 0, colliderSize, windowPos.h));
         engine->AddComponent(left, Transform2D(-colliderSize, 0));
         engine->AddComponent(left, ReflectCollider());
+        engine->AddComponent(left, StaticCollider());
 
         auto right = engine->CreateEntity();
         engine->AddComponent(right, Collider(0, 0, colliderSize, windowPos.h));
         engine->AddComponent(right, Transform2D(windowPos.w, 0));
         engine->AddComponent(right, ReflectCollider());
+        engine->AddComponent(right, StaticCollider());
     }
 
     auto playerMovementScript = dynamicScriptManager.Load("script1.dll", "CreatePlayerMovementScript");
@@ -190,7 +194,6 @@ void SpaceShooterGameWithSystems(Engine::Window *window) {
     engine->Register(new PhysicsSystem(&gameContext, windowPos));
     engine->Register(new CollisionDetectionSystem(window, dt, engine, windowPos));
     engine->Register(new CollisionResolutionSystem(&gameContext));
-    engine->Register(new PhysicsTransformUpdateSystem(&gameContext));
 
     engine->Register(new TextureRendererSystem(&gameContext));
     engine->Register(new ColliderDebugSystem(&gameContext));
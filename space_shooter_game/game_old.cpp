@@ -214,7 +214,6 @@ void SpaceShooterGameWithSystems(Engine::Window *window) {
     engine->Register(new PhysicsSystem(&gameContext, windowPos));
     engine->Register(new CollisionDetectionSystem(window, dt, engine, windowPos));
     engine->Register(new CollisionResolutionSystem(&gameContext));
-    engine->Register(new PhysicsTransformUpdateSystem(&gameContext));
 
     engine->Register(new TextureRendererSystem(window, engine));
     engine->Register(new ColliderDebugSystem(&gameContext));
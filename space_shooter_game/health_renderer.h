@@ -5,12 +5,15 @@
 #include "components.h"
 #include "shared.h"
 #include <string>
+#include <unordered_map>
 
 namespace SpaceShooter {
 class HealthRenderer : public ECS::SystemInterface {
   private:
     GameContext *ctx;
     Engine::SharedResource<Engine::Font> font;
+    // HP text of every entity, rebuilt only when its Health changes
+    std::unordered_map<ECS::Entity, UniqueTexturePtr> texts;
 
   public:
     HealthRenderer(GameContext *ctx,
@@ -22,8 +25,29 @@ class HealthRenderer : public ECS::SystemInterface {
         auto ttfManager = ctx->resourceManager->GetUniqueManager<Engine::Texture, Engine::TTFTextureLoadArgs>();
         static auto texture = textureManager->Load("assets/red.png");
 
-        for (const auto &[transform2D, hp] : ctx->engine->GetGroupView<Transform2D, Health>()) {
-            auto ttf = ttfManager->Load(font.get(), std::to_string(hp), Engine::Color(255, 0, 0));
+        for (const auto &[entity, hp] : ctx->engine->GetGroupView<ECS::Entity, Health>(ECS::Changed<Health>())) {
+            texts[entity] = ttfManager->Load(font.get(), std::to_string(hp), Engine::Color(255, 0, 0));
+        }
+
+        // Texts of deleted entities are dropped once they outnumber the entities with Health
+        if (texts.size() > ctx->engine->GetComponents<Health>()->size()) {
+            for (auto it = texts.begin(); it != texts.end();) {
+                if (ctx->engine->IsAlive(it->first)) {
+                    it++;
+                } else {
+                    it = texts.erase(it);
+                }
+            }
+        }
+
+        for (const auto &[entity, transform2D] : ctx->engine->GetGroupView<ECS::Entity, const Transform2D>(ECS::Unused<Health>())) {
+            auto it = texts.find(entity);
+
+            if (it == texts.end()) {
+                continue;
+            }
+
+            auto &ttf = it->second;
 
             Engine::Rectangle pos(transform2D.x, transform2D.y);
             pos.y -= ttf.get()->h;
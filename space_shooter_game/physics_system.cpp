@@ -2,22 +2,11 @@
 
 namespace SpaceShooter {
 void PhysicsSystem::Update() {
-    for (const auto &[entity, transform2D, velocity2D] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, Velocity2D>()) {
-        float dt = *(ctx->dt);
+    float dt = *(ctx->dt);
 
-        NewTransform2D newTranform = transform2D;
-
-        newTranform += dt * velocity2D;
-
-        /*newTranform.x += dt * velocity2D.x;
-        newTranform.y += dt * velocity2D.y;*/
-
-        ctx->engine->AddComponent(entity, newTranform);
-
-        //transform2D = newTranform;
-
-        //transform2D.y += dt * velocity2D.y;
-    }
+    // Transform2D is buffered, the view hands out the next transforms that are swapped in at the end of the frame
+    ctx->engine->ParallelEach<Transform2D, const Velocity2D>([dt](auto &, Transform2D &transform2D, const Velocity2D &velocity2D) {
+        transform2D += dt * velocity2D;
+    });
 }
 }
-
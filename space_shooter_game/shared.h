@@ -43,7 +43,7 @@ class EngineWrapper {
 
 /*EVAL(CREATE_CLASS_WRAPPER(ECSEngine, ECS::Engine<ECS::DefaultEngineCore>,
                (AddComponent, (ComponentT), (void), (unsigned int, entity), (ComponentT, component)),
-               (GetGroupView, (Transform2D, RenderRect, Scaling, PlayerMovement), (ECS::ComponentGroupView<std::tuple<Transform2D, RenderRect, Scaling>, std::tuple<>>), (ECS::Unused<PlayerMovement>, unused)),
+               (GetGroupView, (Transform2D, RenderRect, Scaling, PlayerMovement), (ECS::ComponentJoinView<std::tuple<Transform2D, RenderRect, Scaling>, std::tuple<>, std::tuple<PlayerMovement>>), (ECS::Unused<PlayerMovement>, unused)),
                (CreateEntity, (), (unsigned int), (void, ))))*/
 
 /*EVAL(CREATE_CLASS_WRAPPER(ResourceManager, ResourceManagerT,
@@ -6,8 +6,8 @@ void VelocityMovementSystem::Update() {
     auto windowPos = Collider(aux.x, aux.y, aux.w, aux.h);
     auto dt = *ctx->dt;
 
-    for (const auto &[transform2D, velocity2D, scaling, colliderOriginal] : ctx->engine->GetGroupView<Transform2D, Velocity2D, Scaling>(ECS::Optional<Collider>())) {
-        //auto  = *it;
+    ctx->engine->ParallelEach<Transform2D, Velocity2D, Scaling>([windowPos, dt](auto &, Transform2D &transform2D, Velocity2D &velocity2D,
+    Scaling &scaling, Collider *colliderOriginal) {
         Collider collider;
 
         if (colliderOriginal != nullptr) {
@@ -57,11 +57,15 @@ void VelocityMovementSystem::Update() {
         if (collidedY) {
             transform2D.y = collider.y;
         }
-    }
+    }, ECS::Optional<Collider>());
 }
 
 void TextureRendererSystem::Update() {
-    for (const auto &[transform2D, optRenderRect, optScaling, optSharedTexturePtr, optUniqueTexturePtr] : ctx->engine->GetGroupView<Transform2D>(ECS::Optional<RenderRect, Scaling, SharedTexturePtr, UniqueTexturePtr>())) {
+    if (!query.IsValid()) {
+        query = ctx->engine->CreateQuery<const Transform2D>(ECS::Optional<RenderRect, Scaling, SharedTexturePtr, UniqueTexturePtr>());
+    }
+
+    for (const auto &[transform2D, optRenderRect, optScaling, optSharedTexturePtr, optUniqueTexturePtr] : ctx->engine->GetGroupView(query)) {
         Engine::Texture *texture = nullptr;
 
         if (optSharedTexturePtr) {
@@ -93,7 +97,7 @@ void TextureRendererSystem::Update() {
 void BulletShooterSystem::Update() {
     auto manager = ctx->resourceManager->GetSharedManager<Engine::Texture, Engine::TextureLoadArgs>();
 
-    for (const auto &[transform2D, bulletShooter, shooterTexture, scaling] : ctx->engine->GetGroupView<Transform2D, BulletShooter, SharedTexturePtr, Scaling>()) {
+    for (const auto &[transform2D, bulletShooter, shooterTexture, scaling] : ctx->engine->GetGroupView<const Transform2D, BulletShooter, SharedTexturePtr, Scaling>()) {
         if (!ctx->window->GetKeystate(bulletShooter.key)) {
             continue;
         }
@@ -6,7 +6,6 @@
 #include "health_renderer.h"
 #include "physics_system.h"
 #include "collision_resolution_system.h"
-#include "physics_transform_update_system.h"
 #include "player_movement_system.h"
 
 #include "shared.h"
@@ -14,7 +13,19 @@
 namespace SpaceShooter {
 
 StatelessSystem(VelocityMovementSystem, GameContext);
-StatelessSystem(TextureRendererSystem, GameContext);
+
+class TextureRendererSystem : public ECS::SystemInterface {
+  private:
+    GameContext *ctx;
+    ECS::Query<std::tuple<const Transform2D>, std::tuple<RenderRect, Scaling, SharedTexturePtr, UniqueTexturePtr>> query;
+
+  public:
+    TextureRendererSystem(GameContext *ctx):
+        ctx(ctx) {}
+
+    virtual void Update() override;
+};
+
 StatelessSystem(BulletShooterSystem, GameContext);
 
 }
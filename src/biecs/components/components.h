@@ -5,6 +5,7 @@
 #include "../src/engine/resource_manager.h"
 #include "../src/ecs/engine.h"
 #include "../src/engine/scancodes.h"
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <iomanip>
@@ -37,12 +38,6 @@ struct Scaling : public Transform2D {
     Scaling() : Transform2D(0, 0) {}
 };
 
-struct NewTransform2D : public Transform2D {
-    template <typename... T>
-    NewTransform2D(T... args) : Transform2D(args...) {
-    }
-};
-
 struct RenderRect : public Engine::Rectangle {
     template <typename... T>
     RenderRect(T... args) : Rectangle(args...) {
@@ -93,13 +88,54 @@ struct Colliding {
     Colliding(ECS::Entity other) : other(other) {}
 };
 
+// Collider category bits and the categories it collides with. A pair is only tested when each mask contains the
+// other collider's category, colliders without a layer collide with everything
+struct CollisionLayer {
+    static constexpr uint32_t DEFAULT = 1;
+    static constexpr uint32_t ALL = ~0u;
+
+    uint32_t category;
+    uint32_t mask;
+
+    CollisionLayer(uint32_t category = DEFAULT, uint32_t mask = ALL) : category(category), mask(mask) {}
+
+    bool CollidesWith(const CollisionLayer &other) const {
+        return (mask & other.category) && (other.mask & category);
+    }
+};
+
 struct Collision {
     ECS::Entity entities[2];
-    Collision(ECS::Entity ent1, ECS::Entity ent2) : entities{ent1, ent2} {}
+    // Categories of the entities' collision layers
+    uint32_t categories[2];
+
+    Collision(ECS::Entity ent1, ECS::Entity ent2, uint32_t category1 = CollisionLayer::DEFAULT, uint32_t category2 = CollisionLayer::DEFAULT) :
+        entities{ent1, ent2}, categories{category1, category2} {}
+};
+
+enum class ContactState {
+    BEGIN,
+    STAY,
+    END
+};
+
+// Published by CollisionResolutionSystem for every pair touching this frame and once more when they separate.
+// The entities are ordered, the normal points from entities[1] to entities[0] and is zero until it is resolved.
+struct Contact {
+    ECS::Entity entities[2];
+    glm::vec2 normal;
+    ContactState state;
+
+    Contact(ECS::Entity ent1, ECS::Entity ent2, glm::vec2 normal, ContactState state) :
+        entities{ent1, ent2}, normal(normal), state(state) {}
 };
 
 struct ReflectCollider {};
 
+// Colliders that never move, CollisionDetectionSystem keeps them in a separate grid that is rebuilt only when
+// one of them changes
+struct StaticCollider {};
+
 struct DestroyOnCollision {};
 
 struct Rigidbody : public Transform2D {
@@ -108,3 +144,26 @@ struct Rigidbody : public Transform2D {
 
 }
 
+// Owned by VelocityMovementSystem's group together with Transform2D, owned pools must be sparse sets
+SparseSetComponent(BIECS::Scaling);
+SparseSetComponent(BIECS::Velocity2D);
+
+// Sought by entity in the renderer and collision joins and by GetComponent, which the sparse table answers in O(1)
+SparseSetComponent(BIECS::RenderRect);
+SparseSetComponent(BIECS::Collider);
+
+// Added on a collision and removed once it is handled
+SparseSetComponent(BIECS::Colliding);
+
+// Looked up by entity for every contact in every frame
+SparseSetComponent(BIECS::Rigidbody);
+
+// Systems read the current transforms and write the next ones, which become current at the end of the frame
+BufferedSparseSetComponent(BIECS::Transform2D);
+
+// Plain float components are read by the batches as packed float arrays for the SIMD kernels
+FloatArraysComponent(BIECS::Transform2D, 2);
+FloatArraysComponent(BIECS::Scaling, 2);
+FloatArraysComponent(BIECS::Velocity2D, 2);
+FloatArraysComponent(BIECS::Rigidbody, 2);
+FloatArraysComponent(BIECS::Collider, 4);
@@ -0,0 +1,421 @@
+#pragma once
+
+// Optional Box2D v3 physics backend. It is not included by biecs.h, include it explicitly and link box2d from
+// redist/box2D/lib. It replaces PhysicsSystem and the collision systems.
+
+#include "../../components/components.h"
+#include "box2d/box2d.h"
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace BIECS {
+
+// Mirrors the entities with a Transform2D and a Collider into a Box2D world and steps it once per frame.
+// Entities with a Rigidbody become dynamic bodies, or kinematic ones when both axes are locked, entities with only
+// a Velocity2D become kinematic bodies and the others static bodies. Bodies are created and destroyed only after a
+// structural change of the mirrored component types, and rebuilt when their Collider, Scaling, CollisionLayer or
+// Rigidbody changes. Bodies keep no component pointers, the components are looked up by entity every step. The move
+// events of the step are written to the next Transform2D and to Velocity2D in one pass, so sleeping bodies are
+// neither read nor written. Touches that begin are published as Collision events. Changing the Transform2D or the
+// Velocity2D of a sleeping body requires calling Wake for it.
+template <typename ContextT>
+class Box2DPhysicsSystem : public ECS::SystemInterface {
+  private:
+    // B2_MAX_WORKERS, it is not part of the public headers
+    static constexpr unsigned int MAX_WORKERS = 64;
+
+    struct Body {
+        ECS::Entity entity;
+        b2BodyId id;
+        b2ShapeId shape;
+        b2BodyType type;
+        Collider collider;
+        CollisionLayer layer;
+        bool hasVelocity;
+        // Rigidbody axes, a locked axis keeps no velocity
+        glm::vec2 axes;
+        // Values last exchanged with Box2D, game code changed the component when they differ
+        glm::vec2 position;
+        glm::vec2 linearVelocity;
+        uint64_t frame = 0;
+        bool awake = true;
+    };
+
+    struct Task {
+        b2TaskCallback *callback;
+        int32_t start;
+        int32_t end;
+        void *context;
+    };
+
+    ContextT *ctx;
+    b2WorldId world;
+    float pixelsPerMeter;
+    int subSteps;
+    // Node based, Box2D keeps pointers to the bodies as user data
+    std::unordered_map<ECS::Entity, Body> bodies;
+    std::vector<Body*> awakeBodies;
+    std::array<uint64_t, 6> versions = {};
+    uint64_t frame = 0;
+    bool synced = false;
+
+    std::mutex tasksMutex;
+    std::vector<Task> tasks;
+
+    static void *EnqueueTask(b2TaskCallback *callback, int32_t itemCount, int32_t minRange, void *taskContext, void *userContext);
+    static void FinishTask(void *userTask, void *userContext);
+    void RunTasks();
+
+    std::array<uint64_t, 6> GetVersions();
+    static b2BodyType GetBodyType(const Rigidbody *rigidbody, const Velocity2D *velocity);
+    b2Polygon MakeBox(const Collider &collider) const;
+    void CreateBody(Body &body);
+    void SyncBody(ECS::Entity entity);
+    template <typename T>
+    bool SyncChanged();
+    void ListAwakeBodies();
+    void SyncBodies();
+    void PushChanges();
+    void WriteBack();
+    void PublishCollisions();
+
+  public:
+    // gravity is in pixels per second squared
+    Box2DPhysicsSystem(ContextT *ctx, glm::vec2 gravity = glm::vec2(0, 0), float pixelsPerMeter = 32, int subSteps = 4);
+    virtual ~Box2DPhysicsSystem();
+
+    Box2DPhysicsSystem(const Box2DPhysicsSystem &other) = delete;
+    Box2DPhysicsSystem &operator=(const Box2DPhysicsSystem &other) = delete;
+
+    // Wakes the body, so the next update pushes the changes made to its Transform2D and Velocity2D
+    void Wake(ECS::Entity entity);
+
+    virtual void Update() override;
+};
+
+template <typename ContextT>
+Box2DPhysicsSystem<ContextT>::Box2DPhysicsSystem(ContextT *ctx, glm::vec2 gravity, float pixelsPerMeter, int subSteps) :
+    ctx(ctx), pixelsPerMeter(pixelsPerMeter), subSteps(subSteps) {
+    b2WorldDef worldDef = b2DefaultWorldDef();
+    worldDef.gravity = {gravity.x / pixelsPerMeter, gravity.y / pixelsPerMeter};
+    worldDef.enableSleep = true;
+
+    // The solver runs on the engine's job system, Box2D indexes its per worker data with the thread index
+    unsigned int threads = ctx->engine->GetJobSystem()->GetThreadsCount();
+
+    if (threads > 1 && threads <= MAX_WORKERS) {
+        worldDef.workerCount = threads;
+        worldDef.enqueueTask = &Box2DPhysicsSystem::EnqueueTask;
+        worldDef.finishTask = &Box2DPhysicsSystem::FinishTask;
+        worldDef.userTaskContext = this;
+    }
+
+    world = b2CreateWorld(&worldDef);
+}
+
+template <typename ContextT>
+Box2DPhysicsSystem<ContextT>::~Box2DPhysicsSystem() {
+    b2DestroyWorld(world);
+}
+
+// Tasks are only recorded here and run together when Box2D waits for the first of them. The solver's worker tasks
+// wait for its main task, which can always be picked up because there is one worker task less than threads.
+template <typename ContextT>
+void *Box2DPhysicsSystem<ContextT>::EnqueueTask(b2TaskCallback *callback, int32_t itemCount, int32_t minRange, void *taskContext, void *userContext) {
+    auto system = static_cast<Box2DPhysicsSystem*>(userContext);
+    int32_t threads = system->ctx->engine->GetJobSystem()->GetThreadsCount();
+    int32_t range = std::max(minRange, (itemCount + threads - 1) / threads);
+
+    std::lock_guard<std::mutex> lock(system->tasksMutex);
+
+    for (int32_t start = 0; start < itemCount; start += range) {
+        system->tasks.push_back({callback, start, std::min(itemCount, start + range), taskContext});
+    }
+
+    // Any non null handle makes Box2D call FinishTask
+    return system;
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::FinishTask(__attribute__((unused)) void *userTask, void *userContext) {
+    static_cast<Box2DPhysicsSystem*>(userContext)->RunTasks();
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::RunTasks() {
+    std::vector<Task> pending;
+
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        std::swap(pending, tasks);
+    }
+
+    ctx->engine->GetJobSystem()->Run(pending.size(), [&pending](size_t job, unsigned int thread) {
+        pending[job].callback(pending[job].start, pending[job].end, thread, pending[job].context);
+    });
+}
+
+template <typename ContextT>
+std::array<uint64_t, 6> Box2DPhysicsSystem<ContextT>::GetVersions() {
+    return {ctx->engine->template GetComponentVersion<Transform2D>(), ctx->engine->template GetComponentVersion<Collider>(),
+            ctx->engine->template GetComponentVersion<Rigidbody>(), ctx->engine->template GetComponentVersion<Velocity2D>(),
+            ctx->engine->template GetComponentVersion<Scaling>(), ctx->engine->template GetComponentVersion<CollisionLayer>()};
+}
+
+template <typename ContextT>
+b2BodyType Box2DPhysicsSystem<ContextT>::GetBodyType(const Rigidbody *rigidbody, const Velocity2D *velocity) {
+    if (rigidbody) {
+        bool locked = glm::abs(rigidbody->x) < 1 && glm::abs(rigidbody->y) < 1;
+        return locked ? b2_kinematicBody : b2_dynamicBody;
+    }
+
+    return velocity ? b2_kinematicBody : b2_staticBody;
+}
+
+// The body origin is the entity's Transform2D, the box is offset by the collider position
+template <typename ContextT>
+b2Polygon Box2DPhysicsSystem<ContextT>::MakeBox(const Collider &collider) const {
+    b2Vec2 center = {(collider.x + collider.w / 2) / pixelsPerMeter, (collider.y + collider.h / 2) / pixelsPerMeter};
+    return b2MakeOffsetBox(collider.w / 2 / pixelsPerMeter, collider.h / 2 / pixelsPerMeter, center, b2Rot_identity);
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::CreateBody(Body &body) {
+    b2BodyDef bodyDef = b2DefaultBodyDef();
+    bodyDef.type = body.type;
+    bodyDef.position = {body.position.x / pixelsPerMeter, body.position.y / pixelsPerMeter};
+    bodyDef.linearVelocity = {body.linearVelocity.x / pixelsPerMeter, body.linearVelocity.y / pixelsPerMeter};
+    bodyDef.fixedRotation = true;
+    bodyDef.userData = &body;
+    body.id = b2CreateBody(world, &bodyDef);
+
+    // Elastic and frictionless, like the built-in resolution
+    b2ShapeDef shapeDef = b2DefaultShapeDef();
+    shapeDef.friction = 0;
+    shapeDef.restitution = 1;
+    shapeDef.filter.categoryBits = body.layer.category;
+    shapeDef.filter.maskBits = body.layer.mask;
+    shapeDef.userData = &body;
+
+    b2Polygon box = MakeBox(body.collider);
+    body.shape = b2CreatePolygonShape(body.id, &shapeDef, &box);
+}
+
+// Creates the entity's body or rebuilds it when its type, shape or layer changed, a rebuilt body is awake
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::SyncBody(ECS::Entity entity) {
+    auto transform2D = ctx->engine->template GetLatestComponent<Transform2D>(entity);
+    auto colliderOriginal = ctx->engine->template GetComponent<const Collider>(entity);
+
+    if (transform2D == nullptr || colliderOriginal == nullptr) {
+        return;
+    }
+
+    auto rigidbody = ctx->engine->template GetComponent<const Rigidbody>(entity);
+    auto velocity = ctx->engine->template GetComponent<const Velocity2D>(entity);
+    auto scaling = ctx->engine->template GetComponent<const Scaling>(entity);
+    auto layerComponent = ctx->engine->template GetComponent<const CollisionLayer>(entity);
+    Collider collider = *colliderOriginal;
+
+    if (scaling) {
+        collider.w *= scaling->x;
+        collider.h *= scaling->y;
+    }
+
+    auto [it, inserted] = bodies.try_emplace(entity);
+    auto &body = it->second;
+    auto type = GetBodyType(rigidbody, velocity);
+    auto layer = layerComponent ? *layerComponent : CollisionLayer();
+
+    body.frame = frame;
+    body.hasVelocity = velocity != nullptr;
+    body.axes = rigidbody ? glm::vec2(*rigidbody) : glm::vec2(1, 1);
+
+    bool changedShape = collider.x != body.collider.x || collider.y != body.collider.y || collider.w != body.collider.w ||
+                        collider.h != body.collider.h || layer.category != body.layer.category || layer.mask != body.layer.mask;
+
+    if (inserted || type != body.type || changedShape) {
+        if (!inserted) {
+            b2DestroyBody(body.id);
+        }
+
+        body.entity = entity;
+        body.type = type;
+        body.collider = collider;
+        body.layer = layer;
+        body.position = *transform2D;
+        body.linearVelocity = velocity ? glm::vec2(*velocity) : glm::vec2(0, 0);
+        CreateBody(body);
+        body.awake = true;
+    }
+}
+
+// Syncs the mirrored entities whose T was changed since the system last ran, returns true if there were any
+template <typename ContextT>
+template <typename T>
+bool Box2DPhysicsSystem<ContextT>::SyncChanged() {
+    bool changed = false;
+
+    for (auto const &[entity, component] : ctx->engine->template GetGroupView<ECS::Entity, const T>(ECS::Changed<T>())) {
+        if (bodies.find(entity) != bodies.end()) {
+            SyncBody(entity);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::ListAwakeBodies() {
+    awakeBodies.clear();
+
+    for (auto &[entity, body] : bodies) {
+        if (body.awake) {
+            awakeBodies.push_back(&body);
+        }
+    }
+}
+
+// Creates and destroys the bodies after a structural change, otherwise only the bodies whose shape, layer or type
+// components changed are synced
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::SyncBodies() {
+    auto currentVersions = GetVersions();
+
+    if (synced && currentVersions == versions) {
+        bool changed = SyncChanged<Collider>();
+        changed = SyncChanged<Scaling>() || changed;
+        changed = SyncChanged<CollisionLayer>() || changed;
+        changed = SyncChanged<Rigidbody>() || changed;
+
+        if (changed) {
+            ListAwakeBodies();
+        }
+
+        return;
+    }
+
+    versions = currentVersions;
+    synced = true;
+    frame++;
+
+    for (auto [entity] : ctx->engine->template GetGroupView<ECS::Entity>(ECS::Unused<Transform2D, Collider>())) {
+        SyncBody(entity);
+    }
+
+    for (auto it = bodies.begin(); it != bodies.end();) {
+        if (it->second.frame == frame) {
+            it++;
+            continue;
+        }
+
+        b2DestroyBody(it->second.id);
+        it = bodies.erase(it);
+    }
+
+    ListAwakeBodies();
+}
+
+// Only awake bodies are compared with their components, the transform written earlier in the frame included
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::PushChanges() {
+    for (auto body : awakeBodies) {
+        glm::vec2 position = *ctx->engine->template GetLatestComponent<Transform2D>(body->entity);
+
+        if (position != body->position) {
+            body->position = position;
+            b2Body_SetTransform(body->id, {position.x / pixelsPerMeter, position.y / pixelsPerMeter}, b2Rot_identity);
+        }
+
+        auto velocity = ctx->engine->template GetComponent<const Velocity2D>(body->entity);
+
+        if (velocity && glm::vec2(*velocity) != body->linearVelocity) {
+            body->linearVelocity = *velocity;
+            b2Body_SetLinearVelocity(body->id, {body->linearVelocity.x / pixelsPerMeter, body->linearVelocity.y / pixelsPerMeter});
+        }
+    }
+}
+
+// Bodies that moved are the awake ones, the others keep their components untouched
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::WriteBack() {
+    for (auto body : awakeBodies) {
+        body->awake = false;
+    }
+
+    awakeBodies.clear();
+    b2BodyEvents events = b2World_GetBodyEvents(world);
+
+    for (int32_t i = 0; i < events.moveCount; i++) {
+        auto &event = events.moveEvents[i];
+        auto body = static_cast<Body*>(event.userData);
+
+        body->position = glm::vec2(event.transform.p.x, event.transform.p.y) * pixelsPerMeter;
+        *ctx->engine->template GetNextComponent<Transform2D>(body->entity) = Transform2D(body->position.x, body->position.y);
+
+        if (body->hasVelocity) {
+            b2Vec2 velocity = b2Body_GetLinearVelocity(body->id);
+            glm::vec2 linearVelocity = glm::vec2(velocity.x, velocity.y) * pixelsPerMeter * body->axes;
+
+            if (body->axes != glm::vec2(1, 1)) {
+                b2Body_SetLinearVelocity(body->id, {linearVelocity.x / pixelsPerMeter, linearVelocity.y / pixelsPerMeter});
+            }
+
+            body->linearVelocity = linearVelocity;
+            *ctx->engine->template GetComponent<Velocity2D>(body->entity) = Velocity2D(linearVelocity.x, linearVelocity.y);
+        }
+
+        if (!event.fellAsleep) {
+            body->awake = true;
+            awakeBodies.push_back(body);
+        }
+    }
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::PublishCollisions() {
+    auto &collisions = ctx->engine->template GetEvents<Collision>();
+    b2ContactEvents events = b2World_GetContactEvents(world);
+
+    for (int32_t i = 0; i < events.beginCount; i++) {
+        auto &event = events.beginEvents[i];
+
+        if (!b2Shape_IsValid(event.shapeIdA) || !b2Shape_IsValid(event.shapeIdB)) {
+            continue;
+        }
+
+        auto bodyA = static_cast<Body*>(b2Shape_GetUserData(event.shapeIdA));
+        auto bodyB = static_cast<Body*>(b2Shape_GetUserData(event.shapeIdB));
+        collisions.Emplace(bodyA->entity, bodyB->entity, bodyA->layer.category, bodyB->layer.category);
+    }
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::Wake(ECS::Entity entity) {
+    auto it = bodies.find(entity);
+
+    if (it == bodies.end()) {
+        return;
+    }
+
+    b2Body_SetAwake(it->second.id, true);
+
+    if (!it->second.awake) {
+        it->second.awake = true;
+        awakeBodies.push_back(&it->second);
+    }
+}
+
+template <typename ContextT>
+void Box2DPhysicsSystem<ContextT>::Update() {
+    SyncBodies();
+    PushChanges();
+    b2World_Step(world, *(ctx->dt), subSteps);
+    WriteBack();
+    PublishCollisions();
+}
+
+}
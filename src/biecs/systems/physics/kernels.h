@@ -0,0 +1,255 @@
+#pragma once
+
+// Kernels over packed float arrays, such as the ones of ECS::ComponentBatch blocks. The AVX-512, AVX and SSE paths are
+// picked at compile time from the target flags, the scalar loop handles the tail and targets without SIMD.
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX__) || defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+namespace BIECS {
+namespace Kernels {
+
+// out = position + (dt * velocity) * scale, float by float, so (x, y) pairs are handled like separate arrays
+inline void MultiplyAdd(const float *position, const float *velocity, const float *scale, float dt, float *out, size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(dt);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 step = _mm256_mul_ps(_mm256_mul_ps(dt8, _mm256_loadu_ps(velocity + i)), _mm256_loadu_ps(scale + i));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(position + i), step));
+    }
+#endif
+
+#if defined(__SSE__)
+    __m128 dt4 = _mm_set1_ps(dt);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 step = _mm_mul_ps(_mm_mul_ps(dt4, _mm_loadu_ps(velocity + i)), _mm_loadu_ps(scale + i));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(position + i), step));
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = position[i] + (dt * velocity[i]) * scale[i];
+    }
+}
+
+// Moves the count positions, (x, y) pairs, by dt * velocity, dropping the part of the move on an axis where the
+// scaled collider would leave the [0, bound] area, unless it leaves it on both axes. The velocities and scales are
+// (x, y) pairs and the colliders (x, y, w, h) quadruples, so the arrays can be the components' own storage.
+inline void MoveInsideBounds(float *position, const float *velocity, const float *collider, const float *scale,
+                             float boundX, float boundY, float dt, size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX__)
+    __m256 dt8 = _mm256_set1_ps(dt);
+    __m256 zero8 = _mm256_setzero_ps();
+    __m256 bound8 = _mm256_setr_ps(boundX, boundY, boundX, boundY, boundX, boundY, boundX, boundY);
+
+    for (; i + 4 <= count; i += 4) {
+        __m256 oldPosition = _mm256_loadu_ps(position + 2 * i);
+        __m256 newPosition = _mm256_add_ps(oldPosition, _mm256_mul_ps(dt8, _mm256_loadu_ps(velocity + 2 * i)));
+        __m128 collider0 = _mm_loadu_ps(collider + 4 * i);
+        __m128 collider1 = _mm_loadu_ps(collider + 4 * i + 4);
+        __m128 collider2 = _mm_loadu_ps(collider + 4 * i + 8);
+        __m128 collider3 = _mm_loadu_ps(collider + 4 * i + 12);
+        // The (x, y) and the (w, h) pairs of the four colliders
+        __m256 offset = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_movelh_ps(collider0, collider1)), _mm_movelh_ps(collider2, collider3), 1);
+        __m256 size = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_movehl_ps(collider1, collider0)), _mm_movehl_ps(collider3, collider2), 1);
+        __m256 topLeft = _mm256_add_ps(offset, newPosition);
+        __m256 bottomRight = _mm256_add_ps(topLeft, _mm256_mul_ps(size, _mm256_loadu_ps(scale + 2 * i)));
+
+        __m256 collided = _mm256_or_ps(_mm256_cmp_ps(bottomRight, bound8, _CMP_GT_OQ), _mm256_cmp_ps(topLeft, zero8, _CMP_LT_OQ));
+        // A lane keeps the old value where its axis collided and the other axis of the row did not
+        __m256 keep = _mm256_andnot_ps(_mm256_permute_ps(collided, _MM_SHUFFLE(2, 3, 0, 1)), collided);
+
+        _mm256_storeu_ps(position + 2 * i, _mm256_blendv_ps(newPosition, oldPosition, keep));
+    }
+#endif
+
+#if defined(__SSE__)
+    __m128 dt4 = _mm_set1_ps(dt);
+    __m128 zero4 = _mm_setzero_ps();
+    __m128 bound4 = _mm_setr_ps(boundX, boundY, boundX, boundY);
+
+    for (; i + 2 <= count; i += 2) {
+        __m128 oldPosition = _mm_loadu_ps(position + 2 * i);
+        __m128 newPosition = _mm_add_ps(oldPosition, _mm_mul_ps(dt4, _mm_loadu_ps(velocity + 2 * i)));
+        __m128 collider0 = _mm_loadu_ps(collider + 4 * i);
+        __m128 collider1 = _mm_loadu_ps(collider + 4 * i + 4);
+        __m128 topLeft = _mm_add_ps(_mm_movelh_ps(collider0, collider1), newPosition);
+        __m128 bottomRight = _mm_add_ps(topLeft, _mm_mul_ps(_mm_movehl_ps(collider1, collider0), _mm_loadu_ps(scale + 2 * i)));
+
+        __m128 collided = _mm_or_ps(_mm_cmpgt_ps(bottomRight, bound4), _mm_cmplt_ps(topLeft, zero4));
+        __m128 keep = _mm_andnot_ps(_mm_shuffle_ps(collided, collided, _MM_SHUFFLE(2, 3, 0, 1)), collided);
+
+        _mm_storeu_ps(position + 2 * i, _mm_or_ps(_mm_and_ps(keep, oldPosition), _mm_andnot_ps(keep, newPosition)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        float newX = position[2 * i] + dt * velocity[2 * i];
+        float newY = position[2 * i + 1] + dt * velocity[2 * i + 1];
+        float left = collider[4 * i] + newX;
+        float top = collider[4 * i + 1] + newY;
+        bool collidedX = left + collider[4 * i + 2] * scale[2 * i] > boundX || left < 0;
+        bool collidedY = top + collider[4 * i + 3] * scale[2 * i + 1] > boundY || top < 0;
+
+        if (!collidedX || collidedY) {
+            position[2 * i] = newX;
+        }
+
+        if (!collidedY || collidedX) {
+            position[2 * i + 1] = newY;
+        }
+    }
+}
+
+// Writes to indices, in order, the i in [0, count) whose box (xs[i], ys[i], ws[i], hs[i]) overlaps (x, y, w, h) and
+// returns how many were written. Boxes touching on an edge overlap.
+inline size_t Overlaps(float x, float y, float w, float h, const float *xs, const float *ys, const float *ws, const float *hs,
+                       size_t count, unsigned int *indices) {
+    size_t i = 0;
+    size_t found = 0;
+    float right = x + w;
+    float bottom = y + h;
+
+    auto push = [&found, indices](size_t first, unsigned int mask) {
+        for (; mask != 0; mask &= mask - 1) {
+            indices[found++] = first + __builtin_ctz(mask);
+        }
+    };
+
+#if defined(__AVX512F__)
+    __m512 x16 = _mm512_set1_ps(x);
+    __m512 y16 = _mm512_set1_ps(y);
+    __m512 right16 = _mm512_set1_ps(right);
+    __m512 bottom16 = _mm512_set1_ps(bottom);
+
+    for (; i + 16 <= count; i += 16) {
+        __m512 otherX = _mm512_loadu_ps(xs + i);
+        __m512 otherY = _mm512_loadu_ps(ys + i);
+        __m512 otherRight = _mm512_add_ps(otherX, _mm512_loadu_ps(ws + i));
+        __m512 otherBottom = _mm512_add_ps(otherY, _mm512_loadu_ps(hs + i));
+
+        __mmask16 overlapX = (_mm512_cmp_ps_mask(x16, otherX, _CMP_GE_OQ) & _mm512_cmp_ps_mask(x16, otherRight, _CMP_LE_OQ)) |
+                             (_mm512_cmp_ps_mask(otherX, x16, _CMP_GE_OQ) & _mm512_cmp_ps_mask(otherX, right16, _CMP_LE_OQ));
+        __mmask16 overlapY = (_mm512_cmp_ps_mask(y16, otherY, _CMP_GE_OQ) & _mm512_cmp_ps_mask(y16, otherBottom, _CMP_LE_OQ)) |
+                             (_mm512_cmp_ps_mask(otherY, y16, _CMP_GE_OQ) & _mm512_cmp_ps_mask(otherY, bottom16, _CMP_LE_OQ));
+        push(i, overlapX & overlapY);
+    }
+#endif
+
+#if defined(__AVX__)
+    __m256 x8 = _mm256_set1_ps(x);
+    __m256 y8 = _mm256_set1_ps(y);
+    __m256 right8 = _mm256_set1_ps(right);
+    __m256 bottom8 = _mm256_set1_ps(bottom);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256 otherX = _mm256_loadu_ps(xs + i);
+        __m256 otherY = _mm256_loadu_ps(ys + i);
+        __m256 otherRight = _mm256_add_ps(otherX, _mm256_loadu_ps(ws + i));
+        __m256 otherBottom = _mm256_add_ps(otherY, _mm256_loadu_ps(hs + i));
+
+        __m256 overlapX = _mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(x8, otherX, _CMP_GE_OQ), _mm256_cmp_ps(x8, otherRight, _CMP_LE_OQ)),
+                                       _mm256_and_ps(_mm256_cmp_ps(otherX, x8, _CMP_GE_OQ), _mm256_cmp_ps(otherX, right8, _CMP_LE_OQ)));
+        __m256 overlapY = _mm256_or_ps(_mm256_and_ps(_mm256_cmp_ps(y8, otherY, _CMP_GE_OQ), _mm256_cmp_ps(y8, otherBottom, _CMP_LE_OQ)),
+                                       _mm256_and_ps(_mm256_cmp_ps(otherY, y8, _CMP_GE_OQ), _mm256_cmp_ps(otherY, bottom8, _CMP_LE_OQ)));
+        push(i, _mm256_movemask_ps(_mm256_and_ps(overlapX, overlapY)));
+    }
+#endif
+
+#if defined(__SSE__)
+    __m128 x4 = _mm_set1_ps(x);
+    __m128 y4 = _mm_set1_ps(y);
+    __m128 right4 = _mm_set1_ps(right);
+    __m128 bottom4 = _mm_set1_ps(bottom);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 otherX = _mm_loadu_ps(xs + i);
+        __m128 otherY = _mm_loadu_ps(ys + i);
+        __m128 otherRight = _mm_add_ps(otherX, _mm_loadu_ps(ws + i));
+        __m128 otherBottom = _mm_add_ps(otherY, _mm_loadu_ps(hs + i));
+
+        __m128 overlapX = _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(x4, otherX), _mm_cmple_ps(x4, otherRight)),
+                                    _mm_and_ps(_mm_cmpge_ps(otherX, x4), _mm_cmple_ps(otherX, right4)));
+        __m128 overlapY = _mm_or_ps(_mm_and_ps(_mm_cmpge_ps(y4, otherY), _mm_cmple_ps(y4, otherBottom)),
+                                    _mm_and_ps(_mm_cmpge_ps(otherY, y4), _mm_cmple_ps(otherY, bottom4)));
+        push(i, _mm_movemask_ps(_mm_and_ps(overlapX, overlapY)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        bool overlapX = (x >= xs[i] && x <= xs[i] + ws[i]) || (xs[i] >= x && xs[i] <= right);
+        bool overlapY = (y >= ys[i] && y <= ys[i] + hs[i]) || (ys[i] >= y && ys[i] <= bottom);
+        push(i, overlapX && overlapY);
+    }
+
+    return found;
+}
+
+// Number of candidates gathered for one Overlaps call by ForEachOverlap
+#ifndef BIECS_OVERLAP_BLOCK
+#define BIECS_OVERLAP_BLOCK 64
+#endif
+
+// Boxes stored as one float array per field, the layout read by Overlaps
+struct BoxArrays {
+    std::vector<float> x, y, w, h;
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void Clear() {
+        x.clear();
+        y.clear();
+        w.clear();
+        h.clear();
+    }
+
+    template <typename RectangleT>
+    void Push(const RectangleT &box) {
+        x.push_back(box.x);
+        y.push_back(box.y);
+        w.push_back(box.w);
+        h.push_back(box.h);
+    }
+};
+
+// Calls fn(candidate) for the candidates, indices in boxes, that overlap box, in order. The candidates are gathered
+// into packed blocks, so the broadphase candidates are tested several at once.
+template <typename RectangleT, typename FnT>
+void ForEachOverlap(const RectangleT &box, const BoxArrays &boxes, const unsigned int *candidates, size_t count, FnT &&fn) {
+    alignas(64) float x[BIECS_OVERLAP_BLOCK], y[BIECS_OVERLAP_BLOCK], w[BIECS_OVERLAP_BLOCK], h[BIECS_OVERLAP_BLOCK];
+    unsigned int found[BIECS_OVERLAP_BLOCK];
+
+    for (size_t first = 0; first < count; first += BIECS_OVERLAP_BLOCK) {
+        size_t size = std::min<size_t>(BIECS_OVERLAP_BLOCK, count - first);
+
+        for (size_t i = 0; i < size; i++) {
+            auto candidate = candidates[first + i];
+            x[i] = boxes.x[candidate];
+            y[i] = boxes.y[candidate];
+            w[i] = boxes.w[candidate];
+            h[i] = boxes.h[candidate];
+        }
+
+        size_t overlaps = Overlaps(box.x, box.y, box.w, box.h, x, y, w, h, size, found);
+
+        for (size_t i = 0; i < overlaps; i++) {
+            fn(candidates[first + found[i]]);
+        }
+    }
+}
+
+}
+}
@@ -1,59 +1,54 @@
 #pragma once
 
 #include "../../components/components.h"
-#include <unordered_set>
+#include "kernels.h"
+#include "../../../engine/contact_islands.h"
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace BIECS {
 
-StatelessSystem(PhysicsSystem, GameContext);
-
-void PhysicsSystem::Update() {
-    for (const auto &[entity, transform2D, velocity2D, rigidbody] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, Velocity2D, Rigidbody>()) {
-        float dt = *(ctx->dt);
-
-        NewTransform2D newTranform = transform2D;
-
-        newTranform += dt * velocity2D * rigidbody;
-        ctx->engine->AddComponent(entity, newTranform);
-    }
-}
-
-class PhysicsTransformUpdateSystem : public ECS::SystemInterface {
+template <typename ContextT>
+class PhysicsSystem : public ECS::SystemInterface {
   private:
-    GameContext *ctx;
+    ContextT *ctx;
 
   public:
-    PhysicsTransformUpdateSystem(GameContext *ctx):
+    PhysicsSystem(ContextT *ctx):
         ctx(ctx) {}
 
-    virtual void Update() override {
-        std::vector<ECS::Entity> entities;
+    virtual void Update() override;
+};
 
-        for (const auto &[entity, transform2D, newTransform] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, NewTransform2D>(ECS::Unused<Rigidbody>())) {
-            transform2D = newTransform;
-            entities.push_back(entity);
-        }
+template <typename ContextT>
+void PhysicsSystem<ContextT>::Update() {
+    float dt = *(ctx->dt);
 
-        for (auto ent : entities) {
-            ctx->engine->DeleteComponents<NewTransform2D>(ent);
-        }
-    }
-};
+    // Transform2D is buffered, the batch writes the next transforms that are swapped in at the end of the frame
+    ctx->engine->template ParallelEachBatch<Transform2D, const Velocity2D, const Rigidbody>([dt](auto &, auto &batch) {
+        float *next = batch.template Write<0>();
+
+        Kernels::MultiplyAdd(next, batch.template Read<1>(), batch.template Read<2>(), dt, next, 2 * batch.size());
+    });
+}
 
 struct CollidingEntity {
-    Rigidbody *rigidbody;
-    Transform2D *oldTransform2D;
+    ECS::Entity entity;
+    const Rigidbody *rigidbody;
+    const Transform2D *oldTransform2D;
     Velocity2D *velocity;
-    Transform2D *transform2D;
-    Collider *collider;
-    Scaling *scaling;
-    ReflectCollider *reflectCollider;
+    const Transform2D *transform2D;
+    const Collider *collider;
+    const Scaling *scaling;
+    const ReflectCollider *reflectCollider;
     float invMass = 1;
     float restitution = 1;
 };
 
-static void ResolveCollision(CollidingEntity A, CollidingEntity B) {
+// Returns the normal, pointing from B to A
+static glm::vec2 ResolveCollision(CollidingEntity A, CollidingEntity B) {
     // Calculate relative velocity
     glm::vec2 rv = (*A.velocity) - (*B.velocity);
     // Calculate relative velocity in terms of the normal direction
@@ -75,7 +70,7 @@ static void ResolveCollision(CollidingEntity A, CollidingEntity B) {
 
     // Do not resolve if velocities are separating
     if (velAlongNormal > 0) {
-        return;
+        return normal;
     }
 
     // Calculate restitution
@@ -89,19 +84,21 @@ static void ResolveCollision(CollidingEntity A, CollidingEntity B) {
 
     if (glm::abs(A.rigidbody->x) < 1 && glm::abs(A.rigidbody->y) < 1) {
         (*B.velocity) -= 2.0f * impulse * B.invMass;
-        return;
+        return normal;
     }
 
     if (glm::abs(B.rigidbody->x) < 1 && glm::abs(B.rigidbody->y) < 1) {
         (*A.velocity) += 2.0f * impulse * A.invMass;
-        return;
+        return normal;
     }
 
     (*A.velocity) += impulse * A.invMass;
     (*B.velocity) -= impulse * B.invMass;
+    return normal;
 }
 
-static void ResolveCollision2(CollidingEntity A, CollidingEntity B) {
+// Returns the normal, pointing from B to A
+static glm::vec2 ResolveCollision2(CollidingEntity A, CollidingEntity B) {
     auto centerA = (*A.transform2D) + glm::vec2(A.collider->w / 2, A.collider->h / 2);
     auto centerB = (*B.transform2D) + glm::vec2(B.collider->w / 2, B.collider->h / 2);
     glm::vec2 normal = centerA - centerB;
@@ -115,105 +112,179 @@ static void ResolveCollision2(CollidingEntity A, CollidingEntity B) {
     normal = glm::normalize(normal);
 
     (*A.velocity) = ((*A.velocity) - 2 * glm::dot(*A.velocity, normal) * normal);
+    return normal;
 }
 
-StatelessSystem(CollisionResolutionSystem, GameContext);
-
-void CollisionResolutionSystem::Update() {
-    std::vector<ECS::Entity> entities;
-    std::unordered_set<ECS::Entity> newTransformRemove;
-
-    for (const auto &[entity, collision] : ctx->engine->GetGroupView<ECS::Entity, Collision>()) {
-        entities.push_back(entity);
+// Components of one side of a contact, only read
+struct ContactBody {
+    const Rigidbody *rigidbody;
+    const Velocity2D *velocity;
+    const Transform2D *transform2D;
+    const Collider *collider;
+    const ReflectCollider *reflectCollider;
+    const Scaling *scaling;
+};
 
-        CollidingEntity ent1, ent2;
+struct CachedContact {
+    // Points from the second entity of the key to the first one
+    glm::vec2 normal = glm::vec2(0, 0);
+    uint64_t frame = 0;
+    bool resolved = false;
+};
 
-        ent1.rigidbody = ctx->engine->GetComponent<Rigidbody>(collision.entities[0]);
-        ent2.rigidbody = ctx->engine->GetComponent<Rigidbody>(collision.entities[1]);
+// Keeps the contacts between frames keyed by the ordered entity pair. A contact is resolved when it begins and
+// afterwards only while its bodies approach each other along the cached normal. Only entities are kept between
+// frames, the bodies' components are looked up by entity every frame, so a structural change invalidates nothing.
+// Publishes a Contact event for every begin, stay and end.
+// The contacts are grouped into islands that share no moving body and the islands are solved on the job system,
+// each one serially in collision order, so the result does not depend on the threads count.
+template <typename ContextT>
+class CollisionResolutionSystem : public ECS::SystemInterface {
+  private:
+    typedef std::pair<ECS::Entity, ECS::Entity> ContactKey;
 
-        if (!ent1.rigidbody && !ent2.rigidbody) {
-            continue;
+    struct ContactKeyHash {
+        size_t operator()(const ContactKey &key) const {
+            return std::hash<ECS::Entity>()(key.first) * 31 + std::hash<ECS::Entity>()(key.second);
         }
+    };
+
+    // Contact touching this frame, everything the solver reads from the engine is fetched before solving
+    struct FrameContact {
+        ContactKey key;
+        CachedContact *contact;
+        // In the key's order
+        ContactBody bodies[2];
+        // Index in the key of the collision's first entity
+        int first;
+        bool begin;
+    };
+
+    ContextT *ctx;
+    std::unordered_map<ContactKey, CachedContact, ContactKeyHash> contacts;
+    uint64_t frame = 0;
+    std::vector<FrameContact> frameContacts;
+    Engine::ContactIslands islands;
+
+    ContactBody FetchBody(ECS::Entity entity);
+    CollidingEntity ToCollidingEntity(ECS::Entity entity, const ContactBody &body);
+    bool IsApproaching(const FrameContact &frameContact) const;
+    // Writes the next transforms of the moving bodies
+    void Resolve(FrameContact &frameContact);
+    void SolveIslands();
 
-        Rigidbody tempRigidbody(false, false);
+  public:
+    CollisionResolutionSystem(ContextT *ctx):
+        ctx(ctx) {}
 
-        if (!ent1.rigidbody) {
-            ent1.rigidbody = &tempRigidbody;
-        } else {
-            ent2.rigidbody = &tempRigidbody;
-        }
+    virtual void Update() override;
+};
 
-        ent1.velocity = ctx->engine->GetComponent<Velocity2D>(collision.entities[0]);
-        ent2.velocity = ctx->engine->GetComponent<Velocity2D>(collision.entities[1]);
+template <typename ContextT>
+ContactBody CollisionResolutionSystem<ContextT>::FetchBody(ECS::Entity entity) {
+    ContactBody body;
+    body.rigidbody = ctx->engine->template GetComponent<const Rigidbody>(entity);
+    body.velocity = ctx->engine->template GetComponent<const Velocity2D>(entity);
+    body.transform2D = ctx->engine->template GetComponent<const Transform2D>(entity);
+    body.collider = ctx->engine->template GetComponent<const Collider>(entity);
+    body.reflectCollider = ctx->engine->template GetComponent<const ReflectCollider>(entity);
+    body.scaling = ctx->engine->template GetComponent<const Scaling>(entity);
+    return body;
+}
 
-        ent1.transform2D = ctx->engine->GetComponent<NewTransform2D>(collision.entities[0]);
+// The transform of the next frame is used when the body moves this frame. The velocity is taken for writing,
+// so the resolved velocities count as changes.
+template <typename ContextT>
+CollidingEntity CollisionResolutionSystem<ContextT>::ToCollidingEntity(ECS::Entity entity, const ContactBody &body) {
+    CollidingEntity ent;
+    ent.entity = entity;
+    ent.rigidbody = body.rigidbody;
+    ent.velocity = body.velocity ? ctx->engine->template GetComponent<Velocity2D>(entity) : nullptr;
+    ent.oldTransform2D = body.transform2D;
+    ent.transform2D = ctx->engine->template GetLatestComponent<Transform2D>(entity);
+
+    ent.collider = body.collider;
+    ent.reflectCollider = body.reflectCollider;
+    ent.scaling = body.scaling;
+    return ent;
+}
 
-        if (ent1.transform2D == nullptr) {
-            ent1.transform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[0]);
-        }
+template <typename ContextT>
+bool CollisionResolutionSystem<ContextT>::IsApproaching(const FrameContact &frameContact) const {
+    glm::vec2 rv(0, 0);
 
-        ent1.oldTransform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[0]);
-        ent2.oldTransform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[1]);
+    if (frameContact.bodies[0].velocity) {
+        rv += *frameContact.bodies[0].velocity;
+    }
 
-        ent2.transform2D = ctx->engine->GetComponent<NewTransform2D>(collision.entities[1]);
+    if (frameContact.bodies[1].velocity) {
+        rv -= *frameContact.bodies[1].velocity;
+    }
 
-        if (ent2.transform2D == nullptr) {
-            ent2.transform2D = ctx->engine->GetComponent<Transform2D>(collision.entities[1]);
-        }
+    return glm::dot(rv, frameContact.contact->normal) < 0;
+}
 
-        ent1.collider = ctx->engine->GetComponent<Collider>(collision.entities[0]);
-        ent2.collider = ctx->engine->GetComponent<Collider>(collision.entities[1]);
+template <typename ContextT>
+void CollisionResolutionSystem<ContextT>::Resolve(FrameContact &frameContact) {
+    auto &key = frameContact.key;
+    auto &contact = *frameContact.contact;
+    int first = frameContact.first;
+    auto ent1 = ToCollidingEntity(first == 0 ? key.first : key.second, frameContact.bodies[first]);
+    auto ent2 = ToCollidingEntity(first == 0 ? key.second : key.first, frameContact.bodies[1 - first]);
 
-        ent1.reflectCollider = ctx->engine->GetComponent<ReflectCollider>(collision.entities[0]);
-        ent2.reflectCollider = ctx->engine->GetComponent<ReflectCollider>(collision.entities[1]);
+    if (!ent1.rigidbody && !ent2.rigidbody) {
+        return;
+    }
 
-        ent1.scaling = ctx->engine->GetComponent<Scaling>(collision.entities[0]);
-        ent2.scaling = ctx->engine->GetComponent<Scaling>(collision.entities[1]);
+    Rigidbody tempRigidbody(false, false);
 
-        if (ent1.velocity == nullptr && ent2.velocity == nullptr) {
-            //LOG_INFO("debug", "Collision ignored");
-            continue;
-        }
+    if (!ent1.rigidbody) {
+        ent1.rigidbody = &tempRigidbody;
+    } else {
+        ent2.rigidbody = &tempRigidbody;
+    }
 
-        auto collider1 = *ent1.collider;
-        auto collider2 = *ent2.collider;
+    if (ent1.velocity == nullptr && ent2.velocity == nullptr) {
+        //LOG_INFO("debug", "Collision ignored");
+        return;
+    }
 
-        if (ent1.scaling) {
-            collider1.w *= ent1.scaling->x;
-            collider1.h *= ent1.scaling->y;
-        }
+    auto collider1 = *ent1.collider;
+    auto collider2 = *ent2.collider;
 
-        if (ent2.scaling) {
-            collider2.w *= ent2.scaling->x;
-            collider2.h *= ent2.scaling->y;
-        }
+    if (ent1.scaling) {
+        collider1.w *= ent1.scaling->x;
+        collider1.h *= ent1.scaling->y;
+    }
 
-        collider1.x += ent1.transform2D->x;
-        collider1.y += ent1.transform2D->y;
+    if (ent2.scaling) {
+        collider2.w *= ent2.scaling->x;
+        collider2.h *= ent2.scaling->y;
+    }
 
-        collider2.x += ent2.transform2D->x;
-        collider2.y += ent2.transform2D->y;
+    collider1.x += ent1.transform2D->x;
+    collider1.y += ent1.transform2D->y;
 
-        ent1.collider = &collider1;
-        ent2.collider = &collider2;
+    collider2.x += ent2.transform2D->x;
+    collider2.y += ent2.transform2D->y;
 
-        if (ent1.transform2D->x > ent2.transform2D->x) {
-            std::swap(ent1, ent2);
-        }
+    ent1.collider = &collider1;
+    ent2.collider = &collider2;
 
-        if (ent1.velocity && ent2.velocity) {
-            ent1.restitution = 0.1;
-            ent2.restitution = 0.9;
-            ResolveCollision(ent1, ent2);
+    if (ent1.transform2D->x > ent2.transform2D->x) {
+        std::swap(ent1, ent2);
+    }
 
-            *(ent1.oldTransform2D) += *(ctx->dt) * (*ent1.velocity);
-            *(ent2.oldTransform2D) += *(ctx->dt) * (*ent2.velocity);
+    glm::vec2 normal;
 
-            newTransformRemove.insert(collision.entities[0]);
-            newTransformRemove.insert(collision.entities[1]);
-            continue;
-        }
+    if (ent1.velocity && ent2.velocity) {
+        ent1.restitution = 0.1;
+        ent2.restitution = 0.9;
+        normal = ResolveCollision(ent1, ent2);
 
+        *ctx->engine->template GetNextComponent<Transform2D>(ent1.entity) = *(ent1.oldTransform2D) + *(ctx->dt) * (*ent1.velocity);
+        *ctx->engine->template GetNextComponent<Transform2D>(ent2.entity) = *(ent2.oldTransform2D) + *(ctx->dt) * (*ent2.velocity);
+    } else {
         if (ent2.velocity) {
             std::swap(ent1, ent2);
         }
@@ -223,18 +294,120 @@ void CollisionResolutionSystem::Update() {
         Velocity2D vel(0, 0);
         ent2.velocity = &vel;
 
-        ResolveCollision2(ent1, ent2);
+        normal = ResolveCollision2(ent1, ent2);
+
+        *ctx->engine->template GetNextComponent<Transform2D>(ent1.entity) = *(ent1.oldTransform2D) + *(ctx->dt) * 2.0f * (*ent1.velocity);
+    }
+
+    contact.normal = ent1.entity == key.first ? normal : normal * -1.0f;
+    contact.resolved = true;
+}
+
+// Bodies without a Velocity2D are never written while solving, so they do not connect islands
+template <typename ContextT>
+void CollisionResolutionSystem<ContextT>::SolveIslands() {
+    std::unordered_map<ECS::Entity, unsigned int> movingBodies;
+    std::vector<std::pair<unsigned int, unsigned int>> contactBodies;
+
+    auto getBody = [&movingBodies](ECS::Entity entity, const ContactBody &body) {
+        if (!body.velocity) {
+            return Engine::ContactIslands::STATIC_BODY;
+        }
+
+        return movingBodies.try_emplace(entity, movingBodies.size()).first->second;
+    };
+
+    for (auto &frameContact : frameContacts) {
+        auto bodyA = getBody(frameContact.key.first, frameContact.bodies[0]);
+        auto bodyB = getBody(frameContact.key.second, frameContact.bodies[1]);
+        contactBodies.push_back({bodyA, bodyB});
+    }
+
+    islands.Clear(movingBodies.size());
+
+    for (auto [bodyA, bodyB] : contactBodies) {
+        islands.Add(bodyA, bodyB);
+    }
+
+    islands.Build();
+
+    auto &islandContacts = islands.GetContacts();
+    auto &offsets = islands.GetOffsets();
+    size_t islandsCount = islands.GetIslandsCount();
+
+    auto solve = [&](size_t firstIsland, size_t lastIsland) {
+        for (auto i = offsets[firstIsland]; i < offsets[lastIsland]; i++) {
+            auto &frameContact = frameContacts[islandContacts[i]];
 
-        *(ent1.oldTransform2D) += *(ctx->dt) * 2.0f * (*ent1.velocity);
+            // A contact that stays and already separates along its normal keeps the velocities of its last resolution
+            if (!frameContact.contact->resolved || IsApproaching(frameContact)) {
+                Resolve(frameContact);
+            }
+        }
+    };
+
+    auto jobs = ctx->engine->GetJobSystem();
+    size_t jobsCount = std::min<size_t>({islandsCount, jobs->GetThreadsCount() * 4, frameContacts.size() / ECS_PARALLEL_MIN_ROWS});
+
+    if (jobsCount <= 1) {
+        solve(0, islandsCount);
+        return;
+    }
+
+    jobs->Run(jobsCount, [&](size_t job, __attribute__((unused)) unsigned int thread) {
+        solve(islandsCount * job / jobsCount, islandsCount * (job + 1) / jobsCount);
+    });
+}
+
+template <typename ContextT>
+void CollisionResolutionSystem<ContextT>::Update() {
+    frame++;
+    frameContacts.clear();
+
+    for (const auto &collision : ctx->engine->template GetEvents<Collision>()) {
+        // Either side may have been deleted since the collision was recorded
+        if (!ctx->engine->IsAlive(collision.entities[0]) || !ctx->engine->IsAlive(collision.entities[1])) {
+            continue;
+        }
 
-        newTransformRemove.insert(collision.entities[0]);
-        newTransformRemove.insert(collision.entities[1]);
+        int first = collision.entities[1] < collision.entities[0] ? 1 : 0;
+        ContactKey key = first == 0 ? ContactKey(collision.entities[0], collision.entities[1]) : ContactKey(collision.entities[1], collision.entities[0]);
+        auto [it, inserted] = contacts.try_emplace(key);
+        auto &contact = it->second;
+
+        if (!inserted && contact.frame == frame) {
+            continue;
+        }
+
+        contact.frame = frame;
+
+        FrameContact frameContact;
+        frameContact.key = key;
+        frameContact.contact = &contact;
+        frameContact.bodies[0] = FetchBody(key.first);
+        frameContact.bodies[1] = FetchBody(key.second);
+        frameContact.first = first;
+        frameContact.begin = inserted;
+        frameContacts.push_back(frameContact);
     }
 
-    ctx->engine->DeleteEntities(entities);
+    SolveIslands();
+
+    auto &events = ctx->engine->template GetEvents<Contact>();
+
+    for (auto &frameContact : frameContacts) {
+        events.Emplace(frameContact.key.first, frameContact.key.second, frameContact.contact->normal,
+                       frameContact.begin ? ContactState::BEGIN : ContactState::STAY);
+    }
+
+    for (auto it = contacts.begin(); it != contacts.end();) {
+        if (it->second.frame == frame) {
+            it++;
+            continue;
+        }
 
-    for (auto ent : newTransformRemove) {
-        ctx->engine->DeleteComponents<NewTransform2D>(ent);
+        events.Emplace(it->first.first, it->first.second, it->second.normal, ContactState::END);
+        it = contacts.erase(it);
     }
 }
 
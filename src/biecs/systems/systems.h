@@ -3,72 +3,60 @@
 // Built-in templated systems
 
 #include "physics/physics.h"
+#include "../../engine/spatial_hash_grid.h"
+#include "../../engine/aabb_tree.h"
+#include <algorithm>
 
 namespace BIECS {
 
-StatelessSystem(VelocityMovementSystem, GameContext);
-
-void VelocityMovementSystem::Update() {
-    auto aux = window->GetPosition();
-    auto windowPos = Collider(aux.x, aux.y, aux.w, aux.h);
-    auto dt = *ctx->dt;
-
-    Collider collider;
-    Transform2D newTransform2D;
-
-    for (const auto &[transform2D, velocity2D, scaling, optCollider] :
-            ctx->engine->GetGroupView<Transform2D, Velocity2D, Scaling>(ECS::Optional<Collider>(), ECS::Unused<VelocityMoved>())) {
-        if (optCollider != nullptr) {
-            collider = *optCollider;
-        } else {
-            collider = Collider();
-        }
-
-        newTransform2D = transform2D + dt * velocity2D;
-
-        collider.x += newTransform2D.x;
-        collider.y += newTransform2D.y;
-
-        collider.w *= scaling.x;
-        collider.h *= scaling.y;
+template <typename ContextT>
+class VelocityMovementSystem : public ECS::SystemInterface {
+  private:
+    ContextT *ctx;
 
-        bool collidedX = false;
-        bool collidedY = false;
+  public:
+    // The moving entities are packed at the front of the three pools, so the update works on the pools' storage
+    VelocityMovementSystem(ContextT *ctx):
+        ctx(ctx) {
+        ctx->engine->template CreateOwnedGroup<Transform2D, Velocity2D, Scaling>();
+    }
 
-        if (collider.x + collider.w > windowPos.w) {
-            collidedX = true;
-        }
+    virtual void Update() override;
+};
 
-        if (collider.x < 0) {
-            collidedX = true;
-        }
+template <typename ContextT>
+void VelocityMovementSystem<ContextT>::Update() {
+    auto aux = ctx->window->GetPosition();
+    auto windowPos = Collider(aux.x, aux.y, aux.w, aux.h);
+    auto dt = *ctx->dt;
 
-        if (collider.y + collider.h > windowPos.h) {
-            collidedY = true;
-        }
+    // Missing colliders read as zeros, same as a default Collider
+    ctx->engine->template ParallelEachBatch<Transform2D, const Velocity2D, const Scaling>([windowPos, dt](auto &, auto &batch) {
+        Kernels::MoveInsideBounds(batch.template Write<0>(), batch.template Read<1>(), batch.template Read<3>(), batch.template Read<2>(),
+                                  windowPos.w, windowPos.h, dt, batch.size());
+    }, ECS::Optional<Collider>(), ECS::Unused<VelocityMoved>());
+}
 
-        if (collider.y < 0) {
-            collidedY = true;
-        }
+template <typename ContextT>
+class TextureRendererSystem : public ECS::SystemInterface {
+  private:
+    ContextT *ctx;
+    ECS::Query<std::tuple<const Transform2D>, std::tuple<const RenderRect, const Scaling, const SharedTexturePtr, const UniqueTexturePtr>> query;
 
-        if (!collidedX && !collidedY) {
-            transform2D = newTransform2D;
-        }
+  public:
+    TextureRendererSystem(ContextT *ctx):
+        ctx(ctx) {}
 
-        if (collidedX) {
-            transform2D.y = newTransform2D.y;
-        }
+    virtual void Update() override;
+};
 
-        if (collidedY) {
-            transform2D.x = newTransform2D.x;
-        }
+template <typename ContextT>
+void TextureRendererSystem<ContextT>::Update() {
+    if (!query.IsValid()) {
+        query = ctx->engine->template CreateQuery<const Transform2D>(ECS::Optional<const RenderRect, const Scaling, const SharedTexturePtr, const UniqueTexturePtr>());
     }
-}
-
-StatelessSystem(TextureRendererSystem, GameContext);
 
-void TextureRendererSystem::Update() {
-    for (const auto &[transform2D, optRenderRect, optScaling, optSharedTexturePtr, optUniqueTexturePtr] : ctx->engine->GetGroupView<Transform2D>(ECS::Optional<RenderRect, Scaling, SharedTexturePtr, UniqueTexturePtr>())) {
+    for (const auto &[transform2D, optRenderRect, optScaling, optSharedTexturePtr, optUniqueTexturePtr] : ctx->engine->GetGroupView(query)) {
         Engine::Texture *texture = nullptr;
 
         if (optSharedTexturePtr) {
@@ -97,93 +85,404 @@ void TextureRendererSystem::Update() {
     }
 }
 
-using CollisionFilter = std::function<void(ECS::Entity, const Collision&, GameContext *ctx)>;
+// Collisions rejected by any filter are not published
+template <typename ContextT>
+using CollisionFilter = std::function<bool(const Collision&, ContextT *ctx)>;
 
+template <typename ContextT>
 class CollisionDetectionSystem : public ECS::SystemInterface {
   private:
-    GameContext *ctx;
-    std::vector<CollisionFilter> filters;
+    ContextT *ctx;
+    std::vector<CollisionFilter<ContextT>> filters;
+    Engine::SpatialHashGrid grid;
+    Kernels::BoxArrays boxes;
+    ECS::Query<std::tuple<ECS::Entity, const Transform2D, const Collider>, std::tuple<const Scaling, const CollisionLayer>> query;
+
+    std::vector<std::pair<ECS::Entity, Collider>> staticColliders;
+    std::vector<CollisionLayer> staticLayers;
+    Engine::SpatialHashGrid staticGrid;
+    Kernels::BoxArrays staticBoxes;
+    ECS::Query<std::tuple<ECS::Entity, const Transform2D, const Collider>, std::tuple<const Scaling, const CollisionLayer>> staticQuery;
+    // Set by the observers when a static collider loses a component its world collider is built from
+    bool staticDirty = true;
+    std::vector<ECS::ObserverHandle> observers;
+
+    template <typename T>
+    void ObserveStaticRemoval();
+    bool StaticChanged();
+    void UpdateStaticLayer();
 
   public:
-    CollisionDetectionSystem(GameContext *ctx):
-        ctx(ctx) {}
-
-    CollisionDetectionSystem(GameContext *ctx, std::vector<CollisionFilter> &filters):
-        ctx(ctx), filters(filters) {}
+    CollisionDetectionSystem(ContextT *ctx);
+    CollisionDetectionSystem(ContextT *ctx, std::vector<CollisionFilter<ContextT>> &filters);
+    ~CollisionDetectionSystem();
 
-    void AddFilter(CollisionFilter filter) {
+    void AddFilter(CollisionFilter<ContextT> filter) {
         filters.push_back(filter);
     }
 
+    void SetCellSize(float cellSize) {
+        grid.SetCellSize(cellSize);
+        staticGrid.SetCellSize(cellSize);
+    }
+
     virtual void Update() override;
 };
 
-static bool CollidesX(Collider &a, Collider &b) {
-    return (a.x >= b.x && a.x <= b.x + b.w) ||
-           (b.x >= a.x && b.x <= a.x + a.w);
+static Collider ToWorld(const Collider &colliderOriginal, const Transform2D &transform2D, const Scaling *optScaling) {
+    Scaling scaling(1, 1);
+
+    if (optScaling) {
+        scaling = *optScaling;
+    }
+
+    Collider collider = colliderOriginal;
+
+    collider.x += transform2D.x;
+    collider.y += transform2D.y;
+
+    collider.w *= scaling.x;
+    collider.h *= scaling.y;
+    return collider;
 }
 
-static bool CollidesY(Collider &a, Collider &b) {
-    return (a.y >= b.y && a.y <= b.y + b.h) ||
-           (b.y >= a.y && b.y <= a.y + a.h);
+// Removals are seen by the observers, additions and changes by the change ticks of the static colliders
+template <typename ContextT>
+CollisionDetectionSystem<ContextT>::CollisionDetectionSystem(ContextT *ctx):
+    ctx(ctx) {
+    ObserveStaticRemoval<StaticCollider>();
+    ObserveStaticRemoval<Transform2D>();
+    ObserveStaticRemoval<Collider>();
+    ObserveStaticRemoval<Scaling>();
+    ObserveStaticRemoval<CollisionLayer>();
 }
 
-static bool Collides(Collider &a, Collider &b) {
-    return CollidesX(a, b) && CollidesY(b, a);
+template <typename ContextT>
+CollisionDetectionSystem<ContextT>::CollisionDetectionSystem(ContextT *ctx, std::vector<CollisionFilter<ContextT>> &filters):
+    CollisionDetectionSystem(ctx) {
+    this->filters = filters;
 }
 
-void CollisionDetectionSystem::Update() {
-    std::vector<std::pair<ECS::Entity, Collider>> entitiesColliders;
-    Scaling scaling(1, 1);
+template <typename ContextT>
+CollisionDetectionSystem<ContextT>::~CollisionDetectionSystem() {
+    for (auto &observer : observers) {
+        ctx->engine->Unobserve(observer);
+    }
+}
 
-    for (auto const &[entity, oldTransform, colliderOriginal, optNewTranform, optScaling] : ctx->engine->GetGroupView<ECS::Entity, Transform2D, Collider>(ECS::Optional<NewTransform2D, Scaling>())) {
-        if (optScaling) {
-            scaling = *optScaling;
-        } else {
-            scaling = Scaling(1, 1);
+template <typename ContextT>
+template <typename T>
+void CollisionDetectionSystem<ContextT>::ObserveStaticRemoval() {
+    observers.push_back(ctx->engine->template OnRemove<T>([this](ECS::Entity entity, T&) {
+        staticDirty = staticDirty || ctx->engine->template GetComponent<const StaticCollider>(entity);
+    }));
+}
+
+// Walks only the static colliders, each one is checked with a few tick lookups
+template <typename ContextT>
+bool CollisionDetectionSystem<ContextT>::StaticChanged() {
+    for (auto const &[entity, transform2D, colliderOriginal, optScaling, optLayer] : ctx->engine->GetGroupView(staticQuery)) {
+        if (ctx->engine->template IsAdded<StaticCollider>(entity) || ctx->engine->template IsChanged<Transform2D>(entity) ||
+                ctx->engine->template IsChanged<Collider>(entity) || ctx->engine->template IsChanged<Scaling>(entity) ||
+                ctx->engine->template IsChanged<CollisionLayer>(entity)) {
+            return true;
         }
+    }
 
-        Transform2D transform2D = oldTransform;
+    return false;
+}
 
-        if (optNewTranform) {
-            transform2D = *optNewTranform;
-        }
+// The static grid is only rebuilt when a static collider was added, removed, moved or resized
+template <typename ContextT>
+void CollisionDetectionSystem<ContextT>::UpdateStaticLayer() {
+    if (!staticQuery.IsValid()) {
+        staticQuery = ctx->engine->template CreateQuery<ECS::Entity, const Transform2D, const Collider>(ECS::Optional<const Scaling, const CollisionLayer>(), ECS::Unused<StaticCollider>());
+    }
+
+    if (!staticDirty && !StaticChanged()) {
+        return;
+    }
+
+    staticDirty = false;
+    staticColliders.clear();
+    staticLayers.clear();
+    staticGrid.Clear();
+    staticBoxes.Clear();
+
+    // A static collider moved earlier in the frame is already at its latest transform
+    for (auto const &[entity, transform2D, colliderOriginal, optScaling, optLayer] : ctx->engine->GetGroupView(staticQuery)) {
+        Collider collider = ToWorld(colliderOriginal, *ctx->engine->template GetLatestComponent<Transform2D>(entity), optScaling);
+        staticColliders.push_back({entity, collider});
+        staticLayers.push_back(optLayer ? *optLayer : CollisionLayer());
+        staticGrid.Insert(collider);
+        staticBoxes.Push(collider);
+    }
+
+    staticGrid.Build();
+}
 
-        Collider collider = colliderOriginal;
+template <typename ContextT>
+void CollisionDetectionSystem<ContextT>::Update() {
+    std::vector<std::pair<ECS::Entity, Collider>> entitiesColliders;
+    std::vector<CollisionLayer> layers;
+    grid.Clear();
+    boxes.Clear();
+    UpdateStaticLayer();
 
-        collider.x += transform2D.x;
-        collider.y += transform2D.y;
+    if (!query.IsValid()) {
+        query = ctx->engine->template CreateQuery<ECS::Entity, const Transform2D, const Collider>(ECS::Optional<const Scaling, const CollisionLayer>(), ECS::Exclude<StaticCollider>());
+    }
 
-        collider.w *= scaling.x;
-        collider.h *= scaling.y;
+    // The latest transforms include the moves written by the physics systems this frame
+    for (auto const &[entity, transform2D, colliderOriginal, optScaling, optLayer] : ctx->engine->GetGroupView(query)) {
+        Collider collider = ToWorld(colliderOriginal, *ctx->engine->template GetLatestComponent<Transform2D>(entity), optScaling);
         entitiesColliders.push_back({entity, collider});
+        layers.push_back(optLayer ? *optLayer : CollisionLayer());
+        grid.Insert(collider);
+        boxes.Push(collider);
+    }
+
+    auto &events = ctx->engine->template GetEvents<Collision>();
+    auto publish = [this, &events](const Collision &collision) {
+        for (auto &filter : filters) {
+            if (!filter(collision, ctx)) {
+                return;
+            }
+        }
+
+        events.Publish(collision);
+    };
+
+    auto &pairs = grid.FindPairs();
+    std::vector<unsigned int> candidates;
+
+    // The pairs are sorted, so the candidates of each collider are tested as one block
+    for (size_t first = 0; first < pairs.size();) {
+        unsigned int i = pairs[first].first;
+        candidates.clear();
+
+        for (; first < pairs.size() && pairs[first].first == i; first++) {
+            if (layers[i].CollidesWith(layers[pairs[first].second])) {
+                candidates.push_back(pairs[first].second);
+            }
+        }
+
+        Kernels::ForEachOverlap(entitiesColliders[i].second, boxes, candidates.data(), candidates.size(), [&](unsigned int j) {
+            publish(Collision(entitiesColliders[i].first, entitiesColliders[j].first, layers[i].category, layers[j].category));
+        });
     }
 
+    std::vector<unsigned int> staticCandidates;
+
+    // Static colliders are never tested against each other
     for (size_t i = 0; i < entitiesColliders.size(); i++) {
-        for (size_t j = i + 1; j < entitiesColliders.size(); j++) {
-            if (Collides(entitiesColliders[i].second, entitiesColliders[j].second)) {
-                auto collision = ctx->engine->CreateEntity();
-                auto collisionComponent = Collision(entitiesColliders[i].first, entitiesColliders[j].first);
-                ctx->engine->AddComponent(collision, collisionComponent);
-
-                for (auto &filter : filters) {
-                    filter(collision, collisionComponent, ctx);
-                }
+        auto entity = entitiesColliders[i].first;
+        auto &collider = entitiesColliders[i].second;
+        staticGrid.Query(collider, staticCandidates);
+        candidates.clear();
+
+        for (auto j : staticCandidates) {
+            if (layers[i].CollidesWith(staticLayers[j])) {
+                candidates.push_back(j);
+            }
+        }
+
+        Kernels::ForEachOverlap(collider, staticBoxes, candidates.data(), candidates.size(), [&](unsigned int j) {
+            auto staticEntity = staticColliders[j].first;
+
+            if (entity < staticEntity) {
+                publish(Collision(entity, staticEntity, layers[i].category, staticLayers[j].category));
+            } else {
+                publish(Collision(staticEntity, entity, staticLayers[j].category, layers[i].category));
             }
+        });
+    }
+}
+
+// Keeps the world colliders of the entities with a Transform2D and a Collider in a dynamic AABB tree, so gameplay
+// code can find the entities inside an area, under a point or along a ray without scanning every collider
+template <typename ContextT>
+class SpatialIndexSystem : public ECS::SystemInterface {
+  public:
+    struct RayHit {
+        ECS::Entity entity;
+        float distance;
+    };
+
+  private:
+    struct Indexed {
+        ECS::Entity entity;
+        int proxy = Engine::AABBTree::NULL_NODE;
+        // Position in indexedEntities
+        unsigned int position = 0;
+    };
+
+    ContextT *ctx;
+    Engine::AABBTree tree;
+    // Indexed by entity id, the id is also the data of the entity's proxy
+    std::vector<Indexed> indexed;
+    // Entities with a proxy, walked every update to find the ones that moved or were resized
+    std::vector<ECS::Entity> indexedEntities;
+    // Entities that gained a Transform2D or a Collider, or lost their Scaling, since the last update
+    std::vector<ECS::Entity> pending;
+    std::vector<ECS::ObserverHandle> observers;
+
+    bool IsIndexed(ECS::Entity entity) const {
+        return entity.GetId() < indexed.size() && indexed[entity.GetId()].proxy != Engine::AABBTree::NULL_NODE &&
+               indexed[entity.GetId()].entity == entity;
+    }
+
+    void Refit(ECS::Entity entity);
+    void Unindex(ECS::Entity entity);
+
+  public:
+    // Colliders moving less than margin stay in their leaf and only their box is updated
+    SpatialIndexSystem(ContextT *ctx, float margin = 4.0f);
+    ~SpatialIndexSystem();
+
+    virtual void Update() override;
+
+    // Entities whose collider overlaps the area, colliders touching its edge included
+    void QueryAABB(const Collider &area, std::vector<ECS::Entity> &result) const;
+    // Entities whose collider contains the point
+    void QueryPoint(glm::vec2 point, std::vector<ECS::Entity> &result) const;
+    // Entities whose collider is hit by the ray within maxDistance, the nearest first
+    void Raycast(glm::vec2 origin, glm::vec2 direction, float maxDistance, std::vector<RayHit> &result) const;
+};
+
+// The entities that already have a collider are indexed by the first update
+template <typename ContextT>
+SpatialIndexSystem<ContextT>::SpatialIndexSystem(ContextT *ctx, float margin):
+    ctx(ctx), tree(margin) {
+    for (auto [entity] : ctx->engine->template GetGroupView<ECS::Entity>(ECS::Unused<Transform2D, Collider>())) {
+        pending.push_back(entity);
+    }
+
+    observers.push_back(ctx->engine->template OnAdd<Transform2D>([this](ECS::Entity entity, Transform2D&) {
+        pending.push_back(entity);
+    }));
+    observers.push_back(ctx->engine->template OnAdd<Collider>([this](ECS::Entity entity, Collider&) {
+        pending.push_back(entity);
+    }));
+    observers.push_back(ctx->engine->template OnRemove<Scaling>([this](ECS::Entity entity, Scaling&) {
+        if (IsIndexed(entity)) {
+            pending.push_back(entity);
         }
+    }));
+
+    // Deleted entities and entities losing their collider leave the tree right away
+    observers.push_back(ctx->engine->template OnRemove<Transform2D>([this](ECS::Entity entity, Transform2D&) {
+        Unindex(entity);
+    }));
+    observers.push_back(ctx->engine->template OnRemove<Collider>([this](ECS::Entity entity, Collider&) {
+        Unindex(entity);
+    }));
+}
+
+template <typename ContextT>
+SpatialIndexSystem<ContextT>::~SpatialIndexSystem() {
+    for (auto &observer : observers) {
+        ctx->engine->Unobserve(observer);
+    }
+}
+
+// The latest transform includes the moves written earlier in the frame
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::Refit(ECS::Entity entity) {
+    auto colliderOriginal = ctx->engine->template GetComponent<const Collider>(entity);
+    auto transform2D = ctx->engine->template GetLatestComponent<Transform2D>(entity);
+
+    if (colliderOriginal == nullptr || transform2D == nullptr) {
+        return;
+    }
+
+    Collider collider = ToWorld(*colliderOriginal, *transform2D, ctx->engine->template GetComponent<const Scaling>(entity));
+    ECS::ID id = entity.GetId();
+
+    if (id >= indexed.size()) {
+        indexed.resize(id + 1);
+    }
+
+    auto &entry = indexed[id];
+
+    if (entry.proxy == Engine::AABBTree::NULL_NODE) {
+        entry.proxy = tree.CreateProxy(collider, id);
+        entry.position = indexedEntities.size();
+        indexedEntities.push_back(entity);
+    } else {
+        tree.MoveProxy(entry.proxy, collider);
+    }
+
+    entry.entity = entity;
+}
+
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::Unindex(ECS::Entity entity) {
+    if (!IsIndexed(entity)) {
+        return;
     }
+
+    auto &entry = indexed[entity.GetId()];
+    tree.DestroyProxy(entry.proxy);
+    entry.proxy = Engine::AABBTree::NULL_NODE;
+
+    auto last = indexedEntities.back();
+    indexedEntities[entry.position] = last;
+    indexed[last.GetId()].position = entry.position;
+    indexedEntities.pop_back();
+}
+
+// Only the indexed colliders are walked, each one is refitted if its Transform2D, Collider or Scaling was changed
+// since the system last ran
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::Update() {
+    for (auto entity : indexedEntities) {
+        if (ctx->engine->template IsChanged<Transform2D>(entity) || ctx->engine->template IsChanged<Collider>(entity) ||
+                ctx->engine->template IsChanged<Scaling>(entity)) {
+            Refit(entity);
+        }
+    }
+
+    for (auto entity : pending) {
+        if (ctx->engine->IsAlive(entity)) {
+            Refit(entity);
+        }
+    }
+
+    pending.clear();
 }
 
-StatelessSystem(CollisionClearSystem, GameContext);
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::QueryAABB(const Collider &area, std::vector<ECS::Entity> &result) const {
+    std::vector<uint32_t> ids;
+    tree.QueryAABB(area, ids);
+    result.clear();
+
+    for (auto id : ids) {
+        result.push_back(indexed[id].entity);
+    }
+}
 
-void CollisionClearSystem::Update() {
-    std::vector<ECS::Entity> entitiesToRemove;
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::QueryPoint(glm::vec2 point, std::vector<ECS::Entity> &result) const {
+    std::vector<uint32_t> ids;
+    tree.QueryPoint(point.x, point.y, ids);
+    result.clear();
 
-    for (auto [entity, collision] : ctx->engine->GetGroupView<ECS::Entity, Collision>()) {
-        entitiesToRemove.push_back(entity);
+    for (auto id : ids) {
+        result.push_back(indexed[id].entity);
     }
+}
 
-    ctx->engine->DeleteEntities(entitiesToRemove);
+template <typename ContextT>
+void SpatialIndexSystem<ContextT>::Raycast(glm::vec2 origin, glm::vec2 direction, float maxDistance, std::vector<RayHit> &result) const {
+    std::vector<Engine::AABBTree::RayHit> hits;
+    tree.Raycast(origin.x, origin.y, direction.x, direction.y, maxDistance, hits);
+    result.clear();
+
+    for (auto &hit : hits) {
+        result.push_back({indexed[hit.data].entity, hit.distance});
+    }
 }
 
 }
@@ -5,7 +5,7 @@
 
 /*EVAL(CREATE_WRAPPER(Engine,
                     (AddComponent, (ComponentT), (void), (unsigned int, entity), (ComponentT, component)),
-                    (GetGroupView, (Transform2D, RenderRect, Scaling, PlayerMovement), (ECS::ComponentGroupView<std::tuple<Transform2D, RenderRect, Scaling>, std::tuple<>>), (ECS::Unused<PlayerMovement>, unused)),
+                    (GetGroupView, (Transform2D, RenderRect, Scaling, PlayerMovement), (ECS::ComponentJoinView<std::tuple<Transform2D, RenderRect, Scaling>, std::tuple<>, std::tuple<PlayerMovement>>), (ECS::Unused<PlayerMovement>, unused)),
                     (CreateEntity, (), (unsigned int), (void,))))
 
 EVAL(CREATE_WRAPPER(ResourceManager,
@@ -0,0 +1,549 @@
+#include "archetype_engine_core.h"
+
+#include <algorithm>
+
+namespace ECS {
+
+static size_t AlignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+Archetype::Archetype(std::vector<ComponentTypeInfo> types) : types(std::move(types)) {
+    size_t rowBytes = sizeof(Entity);
+
+    for (unsigned int i = 0; i < this->types.size(); i++) {
+        mask.insert(this->types[i].id);
+        rowBytes += this->types[i].size;
+
+        if (this->types[i].buffered) {
+            rowBytes += this->types[i].size + sizeof(uint8_t);
+            buffered = true;
+        }
+
+        if (this->types[i].id >= columnsByTypeId.size()) {
+            columnsByTypeId.resize(this->types[i].id + 1, -1);
+        }
+
+        columnsByTypeId[this->types[i].id] = i;
+    }
+
+    chunkCapacity = std::max<size_t>(1, ECS_ARCHETYPE_CHUNK_SIZE / rowBytes);
+
+    size_t offset = chunkCapacity * sizeof(Entity);
+
+    for (auto &type : this->types) {
+        offset = AlignUp(offset, type.alignment);
+        columnOffsets.push_back(offset);
+        offset += chunkCapacity * type.size;
+    }
+
+    for (auto &type : this->types) {
+        nextOffsets.push_back(0);
+        writtenOffsets.push_back(0);
+
+        if (type.buffered) {
+            offset = AlignUp(offset, type.alignment);
+            nextOffsets.back() = offset;
+            offset += chunkCapacity * type.size;
+            writtenOffsets.back() = offset;
+            offset += chunkCapacity * sizeof(uint8_t);
+        }
+    }
+
+    chunkBytes = offset;
+}
+
+Archetype::~Archetype() {
+    for (auto &chunk : chunks) {
+        for (unsigned int column = 0; column < types.size(); column++) {
+            for (unsigned int row = 0; row < chunk->count; row++) {
+                types[column].destroy(chunk->columns[column] + row * types[column].size);
+                DiscardNext(chunk.get(), row, column);
+            }
+        }
+
+        FreeChunk(chunk.get());
+    }
+}
+
+ArchetypeChunk *Archetype::AllocateChunk() {
+    auto chunk = std::make_unique<ArchetypeChunk>();
+    chunk->data = static_cast<std::byte*>(::operator new(chunkBytes, std::align_val_t(ECS_ARCHETYPE_CHUNK_ALIGNMENT)));
+    chunk->entities = reinterpret_cast<Entity*>(chunk->data);
+
+    for (unsigned int column = 0; column < types.size(); column++) {
+        chunk->columns.push_back(chunk->data + columnOffsets[column]);
+        chunk->nextColumns.push_back(types[column].buffered ? chunk->data + nextOffsets[column] : nullptr);
+        chunk->written.push_back(types[column].buffered ? reinterpret_cast<uint8_t*>(chunk->data + writtenOffsets[column]) : nullptr);
+    }
+
+    chunks.push_back(std::move(chunk));
+    return chunks.back().get();
+}
+
+void Archetype::FreeChunk(ArchetypeChunk *chunk) {
+    ::operator delete(chunk->data, std::align_val_t(ECS_ARCHETYPE_CHUNK_ALIGNMENT));
+    chunk->data = nullptr;
+}
+
+std::pair<unsigned int, unsigned int> Archetype::AllocateRow(Entity entity) {
+    if (chunks.empty() || chunks.back()->count == chunkCapacity) {
+        AllocateChunk();
+    }
+
+    auto chunk = chunks.back().get();
+    unsigned int row = chunk->count++;
+    new (chunk->entities + row) Entity(entity);
+
+    for (auto written : chunk->written) {
+        if (written != nullptr) {
+            written[row] = 0;
+        }
+    }
+
+    return {chunks.size() - 1, row};
+}
+
+Entity Archetype::RemoveRow(unsigned int chunkIndex, unsigned int row) {
+    auto chunk = chunks[chunkIndex].get();
+    auto last = chunks.back().get();
+    unsigned int lastRow = last->count - 1;
+    Entity moved;
+
+    for (unsigned int column = 0; column < types.size(); column++) {
+        types[column].destroy(chunk->columns[column] + row * types[column].size);
+        DiscardNext(chunk, row, column);
+    }
+
+    if (chunk != last || row != lastRow) {
+        for (unsigned int column = 0; column < types.size(); column++) {
+            auto src = last->columns[column] + lastRow * types[column].size;
+            types[column].moveConstruct(chunk->columns[column] + row * types[column].size, src);
+            types[column].destroy(src);
+
+            TakeNext(chunk, row, column, last, lastRow, column);
+            DiscardNext(last, lastRow, column);
+        }
+
+        chunk->entities[row] = last->entities[lastRow];
+        moved = chunk->entities[row];
+    }
+
+    last->count--;
+
+    if (last->count == 0) {
+        FreeChunk(last);
+        chunks.pop_back();
+    }
+
+    return moved;
+}
+
+void *Archetype::GetNextRows(unsigned int chunk, unsigned int row, unsigned int column, unsigned int count) {
+    auto data = chunks[chunk].get();
+    auto size = types[column].size;
+
+    if (data->written[column] == nullptr) {
+        return data->columns[column] + row * size;
+    }
+
+    for (unsigned int i = row; i < row + count; i++) {
+        if (!data->written[column][i]) {
+            types[column].copyConstruct(data->nextColumns[column] + i * size, data->columns[column] + i * size);
+            data->written[column][i] = 1;
+        }
+    }
+
+    return data->nextColumns[column] + row * size;
+}
+
+const void *Archetype::GetLatestComponent(unsigned int chunk, unsigned int row, unsigned int column) const {
+    auto data = chunks[chunk].get();
+    bool written = data->written[column] != nullptr && data->written[column][row];
+    return (written ? data->nextColumns[column] : data->columns[column]) + row * types[column].size;
+}
+
+void Archetype::DiscardNext(unsigned int chunk, unsigned int row, unsigned int column) {
+    DiscardNext(chunks[chunk].get(), row, column);
+}
+
+void Archetype::DiscardNext(ArchetypeChunk *chunk, unsigned int row, unsigned int column) {
+    if (chunk->written[column] != nullptr && chunk->written[column][row]) {
+        types[column].destroy(chunk->nextColumns[column] + row * types[column].size);
+        chunk->written[column][row] = 0;
+    }
+}
+
+void Archetype::MoveNext(unsigned int chunk, unsigned int row, unsigned int column,
+                         Archetype *destination, unsigned int destinationChunk, unsigned int destinationRow, unsigned int destinationColumn) {
+    destination->TakeNext(destination->chunks[destinationChunk].get(), destinationRow, destinationColumn,
+                          chunks[chunk].get(), row, column);
+}
+
+void Archetype::TakeNext(ArchetypeChunk *chunk, unsigned int row, unsigned int column,
+                         ArchetypeChunk *source, unsigned int sourceRow, unsigned int sourceColumn) {
+    if (source->written[sourceColumn] == nullptr || !source->written[sourceColumn][sourceRow]) {
+        return;
+    }
+
+    auto size = types[column].size;
+    types[column].moveConstruct(chunk->nextColumns[column] + row * size, source->nextColumns[sourceColumn] + sourceRow * size);
+    chunk->written[column][row] = 1;
+}
+
+void Archetype::SwapBuffers() {
+    for (unsigned int column = 0; column < types.size(); column++) {
+        if (!types[column].buffered) {
+            continue;
+        }
+
+        auto size = types[column].size;
+
+        for (auto &chunk : chunks) {
+            for (unsigned int row = 0; row < chunk->count; row++) {
+                if (chunk->written[column][row]) {
+                    types[column].moveAssign(chunk->columns[column] + row * size, chunk->nextColumns[column] + row * size);
+                    DiscardNext(chunk.get(), row, column);
+                }
+            }
+        }
+    }
+}
+
+Archetype *ArchetypeEngineCore::GetArchetype(std::vector<ComponentTypeInfo> types) {
+    if (types.empty()) {
+        return nullptr;
+    }
+
+    std::sort(types.begin(), types.end(), [](const ComponentTypeInfo & a, const ComponentTypeInfo & b) {
+        return a.id < b.id;
+    });
+
+    ComponentMask mask;
+
+    for (auto &type : types) {
+        mask.insert(type.id);
+    }
+
+    auto it = archetypesByMask.find(mask);
+
+    if (it != archetypesByMask.end()) {
+        return it->second;
+    }
+
+    LOG_INFO("debug", "Added archetype with %u components", (unsigned int) types.size());
+    archetypes.push_back(std::make_unique<Archetype>(std::move(types)));
+    archetypesByMask[mask] = archetypes.back().get();
+
+    if (archetypes.back()->IsBuffered()) {
+        bufferedArchetypes.push_back(archetypes.back().get());
+    }
+
+    for (auto &query : queries) {
+        if (query->Matches(mask)) {
+            query->archetypes.push_back(archetypes.back().get());
+        }
+    }
+
+    return archetypes.back().get();
+}
+
+Archetype *ArchetypeEngineCore::GetArchetypeAdding(Archetype *source, const ComponentTypeInfo &type) {
+    auto &edges = source == nullptr ? rootEdges : source->addEdges;
+    auto it = edges.find(type.id);
+
+    if (it != edges.end()) {
+        return it->second;
+    }
+
+    std::vector<ComponentTypeInfo> types;
+
+    if (source != nullptr) {
+        types = source->types;
+    }
+
+    types.push_back(type);
+
+    auto destination = GetArchetype(types);
+    edges[type.id] = destination;
+
+    return destination;
+}
+
+Archetype *ArchetypeEngineCore::GetArchetypeRemoving(Archetype *source, ID id) {
+    auto it = source->removeEdges.find(id);
+
+    if (it != source->removeEdges.end()) {
+        return it->second;
+    }
+
+    std::vector<ComponentTypeInfo> types;
+
+    for (auto &type : source->types) {
+        if (type.id != id) {
+            types.push_back(type);
+        }
+    }
+
+    auto destination = GetArchetype(types);
+    source->removeEdges[id] = destination;
+
+    return destination;
+}
+
+void ArchetypeEngineCore::MoveEntity(Entity entity, Archetype *destination) {
+    auto &location = locations[entity.GetId()];
+    auto source = location.archetype;
+    unsigned int chunk = 0;
+    unsigned int row = 0;
+
+    if (destination != nullptr) {
+        std::tie(chunk, row) = destination->AllocateRow(entity);
+
+        if (source != nullptr) {
+            for (unsigned int column = 0; column < source->types.size(); column++) {
+                int destinationColumn = destination->GetColumn(source->types[column].id);
+
+                if (destinationColumn >= 0) {
+                    source->types[column].moveConstruct(destination->GetComponent(chunk, row, destinationColumn),
+                                                        source->GetComponent(location.chunk, location.row, column));
+                    source->MoveNext(location.chunk, location.row, column, destination, chunk, row, destinationColumn);
+                }
+            }
+        }
+    }
+
+    if (source != nullptr) {
+        RemoveRow(source, location.chunk, location.row);
+    }
+
+    location.archetype = destination;
+    location.chunk = chunk;
+    location.row = row;
+}
+
+void ArchetypeEngineCore::RemoveRow(Archetype *archetype, unsigned int chunk, unsigned int row) {
+    Entity moved = archetype->RemoveRow(chunk, row);
+    structuralVersion++;
+
+    if (moved != Entity()) {
+        locations[moved.GetId()].chunk = chunk;
+        locations[moved.GetId()].row = row;
+    }
+}
+
+std::vector<Archetype*> ArchetypeEngineCore::GetArchetypes(const ComponentMask &mask) {
+    std::vector<Archetype*> matching;
+
+    for (auto &archetype : archetypes) {
+        if (archetype->mask.Contains(mask)) {
+            matching.push_back(archetype.get());
+        }
+    }
+
+    return matching;
+}
+
+ArchetypeQuery *ArchetypeEngineCore::GetQuery(const ComponentMask &mask, const ComponentMask &excluded) {
+    for (auto &query : queries) {
+        if (query->GetMask() == mask && query->GetExcluded() == excluded) {
+            return query.get();
+        }
+    }
+
+    queries.push_back(std::make_unique<ArchetypeQuery>(mask, excluded, std::vector<Archetype*>()));
+    auto query = queries.back().get();
+
+    for (auto &archetype : archetypes) {
+        if (query->Matches(archetype->mask)) {
+            query->archetypes.push_back(archetype.get());
+        }
+    }
+
+    return query;
+}
+
+void ArchetypeChangeTicks::Stamp(ID type, Entity entity, bool added) {
+    auto &typeTicks = byType[type];
+
+    if (entity.GetId() >= typeTicks.size()) {
+        typeTicks.resize(std::max<size_t>(entity.GetId() + 1, typeTicks.size() * 2));
+    }
+
+    auto &entityTicks = typeTicks[entity.GetId()];
+
+    if (added) {
+        entityTicks.added = *changeTick;
+    }
+
+    entityTicks.changed = *changeTick;
+}
+
+ArchetypeEngineCore::ArchetypeEngineCore() {
+    changeTicks.changeTick = systemManager.GetChangeTick();
+}
+
+Entity ArchetypeEngineCore::CreateEntity() {
+    ID id = entityIdManager.GetId();
+    auto entity = Entity(id, entityIdManager.GetGeneration(id));
+    AddComponent(entity, entity);
+    return entity;
+}
+
+std::vector<Entity> ArchetypeEngineCore::AllocateEntities(size_t count) {
+    std::vector<Entity> entities;
+    entities.reserve(count);
+
+    for (size_t i = 0; i < count; i++) {
+        ID id = entityIdManager.GetId();
+        entities.emplace_back(id, entityIdManager.GetGeneration(id));
+    }
+
+    return entities;
+}
+
+void ArchetypeEngineCore::DeleteEntity(Entity entity) {
+    if (commandQueue.IsLocked()) {
+        commandQueue.Push([this, entity]() {
+            DeleteEntity(entity);
+        });
+        return;
+    }
+
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    auto &location = GetLocation(entity);
+    commandQueue.SignalViewStarted();
+
+    // Observers see the components before they are removed
+    if (location.archetype != nullptr) {
+        NotifyRow(location.archetype, location.chunk, location.row, ComponentEvent::REMOVE);
+        RemoveRow(location.archetype, location.chunk, location.row);
+    }
+
+    location = EntityLocation();
+    entityIdManager.FreeId(entity.GetId());
+    commandQueue.SignalViewFinished();
+}
+
+void ArchetypeEngineCore::DeleteEntities(const std::vector<Entity> &entities) {
+    for (auto &entity : entities) {
+        DeleteEntity(entity);
+    }
+}
+
+std::vector<Entity> ArchetypeEngineCore::GetEntities(ComponentMask mask) {
+    std::vector<Entity> matchingEntities;
+
+    for (auto archetype : GetArchetypes(mask)) {
+        for (auto &chunk : archetype->chunks) {
+            matchingEntities.insert(matchingEntities.end(), chunk->entities, chunk->entities + chunk->count);
+        }
+    }
+
+    std::sort(matchingEntities.begin(), matchingEntities.end());
+    return matchingEntities;
+}
+
+void ArchetypeEngineCore::EntitiesCallFor(ComponentMask mask,
+        std::function<void (std::vector<Entity>, Engine<ArchetypeEngineCore> *engine)> fn, Engine<ArchetypeEngineCore> *engine) {
+    auto entities = GetEntities(mask);
+    fn(entities, engine);
+}
+
+JobSystem *ArchetypeEngineCore::GetJobSystem() {
+    if (jobSystem == nullptr) {
+        jobSystem = std::make_unique<JobSystem>();
+    }
+
+    return jobSystem.get();
+}
+
+void ArchetypeEngineCore::Register(System system) {
+    systemManager.Register(system);
+}
+
+void ArchetypeEngineCore::Register(SystemInterface *sysInt) {
+    systemManager.Register(sysInt);
+}
+
+void ArchetypeEngineCore::Unregister(ID id) {
+    systemManager.Unregister(id);
+}
+
+void ArchetypeEngineCore::Notify(ID type, ComponentEvent event, Entity entity, void *component) {
+    if (!IsObserved(type, event)) {
+        return;
+    }
+
+    auto &typeObservers = observers[type];
+
+    if (!typeObservers.batchObservers[(size_t) event].empty()) {
+        typeObservers.batches[(size_t) event].push_back(entity);
+    }
+
+    for (auto &observer : typeObservers.observers[(size_t) event]) {
+        observer.second(entity, component);
+    }
+}
+
+void ArchetypeEngineCore::NotifyRow(Archetype *archetype, unsigned int chunk, unsigned int row, ComponentEvent event) {
+    Entity entity = archetype->GetChunk(chunk)->entities[row];
+
+    for (unsigned int column = 0; column < archetype->GetTypes().size(); column++) {
+        Notify(archetype->GetTypes()[column].id, event, entity, archetype->GetComponent(chunk, row, column));
+    }
+}
+
+void ArchetypeEngineCore::FlushObservers() {
+    std::vector<Entity> flushing;
+
+    for (auto &typeObservers : observers) {
+        for (size_t event = 0; event < ArchetypeObservers::EVENTS; event++) {
+            if (typeObservers.batches[event].empty()) {
+                continue;
+            }
+
+            std::swap(typeObservers.batches[event], flushing);
+
+            for (auto &observer : typeObservers.batchObservers[event]) {
+                observer.second(flushing);
+            }
+
+            flushing.clear();
+        }
+    }
+}
+
+void ArchetypeEngineCore::Unobserve(const ObserverHandle &handle) {
+    if (!handle.IsValid() || handle.type >= observers.size()) {
+        return;
+    }
+
+    auto remove = [&handle](auto &list) {
+        list.erase(std::remove_if(list.begin(), list.end(), [&handle](const auto &observer) {
+            return observer.first == handle.id;
+        }), list.end());
+    };
+
+    if (handle.batched) {
+        remove(observers[handle.type].batchObservers[(size_t) handle.event]);
+    } else {
+        remove(observers[handle.type].observers[(size_t) handle.event]);
+    }
+}
+
+void ArchetypeEngineCore::CallAll() {
+    FlushObservers();
+    systemManager.CallAll();
+
+    for (auto archetype : bufferedArchetypes) {
+        archetype->SwapBuffers();
+    }
+
+    events.ClearAll();
+}
+
+}
@@ -0,0 +1,965 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "engine.h"
+
+namespace ECS {
+
+// Size in bytes targeted by a single archetype chunk
+#ifndef ECS_ARCHETYPE_CHUNK_SIZE
+#define ECS_ARCHETYPE_CHUNK_SIZE (16 * 1024)
+#endif
+
+#define ECS_ARCHETYPE_CHUNK_ALIGNMENT 64
+
+// Type erased operations needed to move rows between archetypes, buffered types also copy their current value
+// into the next one and move the next value back at the swap
+struct ComponentTypeInfo {
+    ID id;
+    size_t size;
+    size_t alignment;
+    void (*moveConstruct)(void *dst, void *src);
+    void (*destroy)(void *ptr);
+    bool buffered = false;
+    void (*copyConstruct)(void *dst, const void *src) = nullptr;
+    void (*moveAssign)(void *dst, void *src) = nullptr;
+
+    template <typename T>
+    static ComponentTypeInfo Create() {
+        ComponentTypeInfo info{
+            Component<T>::GetTypeId(),
+            sizeof(T),
+            alignof(T),
+            [](void *dst, void *src) {
+                new (dst) T(std::move(*static_cast<T*>(src)));
+            },
+            [](void *ptr) {
+                static_cast<T*>(ptr)->~T();
+            }
+        };
+
+        if constexpr (ComponentStorageTraits<T>::buffered) {
+            info.buffered = true;
+            info.copyConstruct = [](void *dst, const void *src) {
+                new (dst) T(*static_cast<const T*>(src));
+            };
+            info.moveAssign = [](void *dst, void *src) {
+                *static_cast<T*>(dst) = std::move(*static_cast<T*>(src));
+            };
+        }
+
+        return info;
+    }
+};
+
+// A buffered column also has a next column and one written flag per row, a next value is only constructed
+// while its flag is set
+struct ArchetypeChunk {
+    std::byte *data;
+    Entity *entities;
+    std::vector<std::byte*> columns;
+    // Null for the columns that are not buffered
+    std::vector<std::byte*> nextColumns;
+    std::vector<uint8_t*> written;
+    unsigned int count = 0;
+};
+
+// All entities with exactly the same component set, stored in fixed-size chunks with one column per component
+class Archetype {
+  private:
+    friend class ArchetypeEngineCore;
+
+    ComponentMask mask;
+    std::vector<ComponentTypeInfo> types;
+    std::vector<size_t> columnOffsets;
+    // Offsets of the next columns and written flags of the buffered types, 0 for the others
+    std::vector<size_t> nextOffsets;
+    std::vector<size_t> writtenOffsets;
+    std::vector<int> columnsByTypeId;
+    std::vector<std::unique_ptr<ArchetypeChunk>> chunks;
+    unsigned int chunkCapacity;
+    size_t chunkBytes;
+    bool buffered = false;
+
+    // Cached transitions to the archetype with one more / one less component
+    std::unordered_map<ID, Archetype*> addEdges;
+    std::unordered_map<ID, Archetype*> removeEdges;
+
+    ArchetypeChunk *AllocateChunk();
+    void FreeChunk(ArchetypeChunk *chunk);
+
+    void DiscardNext(ArchetypeChunk *chunk, unsigned int row, unsigned int column);
+    // Moves the source row's written next value into the row, the source value is left to be destroyed
+    void TakeNext(ArchetypeChunk *chunk, unsigned int row, unsigned int column,
+                  ArchetypeChunk *source, unsigned int sourceRow, unsigned int sourceColumn);
+
+  public:
+    Archetype(std::vector<ComponentTypeInfo> types);
+    ~Archetype();
+
+    Archetype(const Archetype &other) = delete;
+    Archetype &operator=(const Archetype &other) = delete;
+
+    const ComponentMask &GetMask() const {
+        return mask;
+    }
+
+    const std::vector<ComponentTypeInfo> &GetTypes() const {
+        return types;
+    }
+
+    int GetColumn(ID id) const {
+        return id < columnsByTypeId.size() ? columnsByTypeId[id] : -1;
+    }
+
+    size_t GetChunksCount() const {
+        return chunks.size();
+    }
+
+    ArchetypeChunk *GetChunk(size_t index) const {
+        return chunks[index].get();
+    }
+
+    void *GetComponent(unsigned int chunk, unsigned int row, unsigned int column) const {
+        return chunks[chunk]->columns[column] + row * types[column].size;
+    }
+
+    bool IsBuffered() const {
+        return buffered;
+    }
+
+    // Next values of count rows from row on, a row's first write copies its current value. Columns that are not
+    // buffered return the current values, they are written in place.
+    void *GetNextRows(unsigned int chunk, unsigned int row, unsigned int column, unsigned int count);
+
+    // The next value if it was written this frame, otherwise the current one
+    const void *GetLatestComponent(unsigned int chunk, unsigned int row, unsigned int column) const;
+
+    // The written next value is dropped, the current one is kept at the end of the frame
+    void DiscardNext(unsigned int chunk, unsigned int row, unsigned int column);
+
+    // Moves a written next value to the same type's column of another archetype's row
+    void MoveNext(unsigned int chunk, unsigned int row, unsigned int column,
+                  Archetype *destination, unsigned int destinationChunk, unsigned int destinationRow, unsigned int destinationColumn);
+
+    // The written next values become current, the rows stay where they are so pointers to them stay valid
+    void SwapBuffers();
+
+    // Returns (chunk, row) of a new row whose components are left unconstructed
+    std::pair<unsigned int, unsigned int> AllocateRow(Entity entity);
+
+    // Destroys the row and fills the hole with the last row, returns the moved entity or Entity() if none was moved
+    Entity RemoveRow(unsigned int chunk, unsigned int row);
+};
+
+// Structural changes made while a view is alive are recorded here and run when the last view is finished
+class ArchetypeCommandQueue {
+  private:
+    unsigned int viewsInUse = 0;
+    std::vector<std::function<void(void)>> operations;
+
+  public:
+    bool IsLocked() const {
+        return viewsInUse > 0;
+    }
+
+    void Push(std::function<void(void)> operation) {
+        operations.push_back(std::move(operation));
+    }
+
+    void SignalViewStarted() {
+        viewsInUse++;
+    }
+
+    void SignalViewFinished() {
+        viewsInUse--;
+
+        if (viewsInUse == 0) {
+            auto pending = std::move(operations);
+            operations.clear();
+
+            for (auto &operation : pending) {
+                operation();
+            }
+        }
+    }
+};
+
+// Change ticks of every component type by entity id, kept apart from the chunks so they do not move with the rows
+struct ArchetypeChangeTicks {
+    std::array<std::vector<ChangeTicks>, ECS_MAX_COMPONENT_TYPES> byType;
+    // Owned by the core's system manager
+    const uint64_t *changeTick = nullptr;
+
+    void Stamp(ID type, Entity entity, bool added);
+};
+
+// Observers of one component type, indexed by ComponentEvent. Each observer is kept with its id and gets the component
+// type erased.
+struct ArchetypeObservers {
+    static constexpr size_t EVENTS = 3;
+
+    std::array<std::vector<std::pair<uint64_t, std::function<void(Entity, void*)>>>, EVENTS> observers;
+    std::array<std::vector<std::pair<uint64_t, std::function<void(const std::vector<Entity>&)>>>, EVENTS> batchObservers;
+    // Entities gathered for the batched observers since the last flush
+    std::array<std::vector<Entity>, EVENTS> batches;
+
+    bool IsObserved(ComponentEvent event) const {
+        return !observers[(size_t) event].empty() || !batchObservers[(size_t) event].empty();
+    }
+};
+
+template <typename ComponentsT, typename OptionalComponentsT = std::tuple<>>
+class ArchetypeGroupView {
+};
+
+// Handing out a non-const component stamps its changed tick, entities and empty components carry nothing to write.
+// Buffered types hand out their next values to the writable elements and their current values to the const ones.
+// A change filter keeps only the rows whose filter type was changed, or added, after filterTick.
+template <typename... T, typename... OptionalsT>
+class ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalsT...>> {
+  private:
+    static constexpr size_t ELEMENTS = sizeof...(T) + sizeof...(OptionalsT);
+
+    struct ArchetypeMatch {
+        Archetype *archetype;
+        std::array<int, ELEMENTS> columns;
+    };
+
+    typedef std::tuple<T*..., OptionalsT*...> ColumnsT;
+
+    template <typename U>
+    static constexpr bool IsWritable = !std::is_const_v<U> && !std::is_same_v<U, Entity> && !std::is_empty_v<U>;
+
+    template <typename U>
+    static constexpr bool IsNext = IsWritable<U> && ComponentStorageTraits<U>::buffered;
+
+    ArchetypeCommandQueue *commandQueue;
+    std::vector<ArchetypeMatch> matches;
+    const uint64_t *changeTick;
+    // Ticks of the writable elements, null for the others
+    std::array<std::vector<ChangeTicks>*, ELEMENTS> writtenTicks;
+    const std::vector<ChangeTicks> *filterTicks;
+    uint64_t filterTick;
+    bool filterAdded;
+
+    bool Passes(Entity entity) const {
+        if (filterTicks == nullptr) {
+            return true;
+        }
+
+        auto &entityTicks = (*filterTicks)[entity.GetId()];
+        return (filterAdded ? entityTicks.added : entityTicks.changed) > filterTick;
+    }
+
+    // Stamps count rows from first on, for the writable elements present in the match, and readies their next values
+    void Stamp(const ArchetypeMatch &match, size_t chunkIndex, unsigned int first, unsigned int count) const {
+        static constexpr std::array<bool, ELEMENTS> NEXT{IsNext<T>..., IsNext<OptionalsT>...};
+        auto entities = match.archetype->GetChunk(chunkIndex)->entities;
+
+        for (size_t i = 0; i < ELEMENTS; i++) {
+            if (writtenTicks[i] == nullptr || match.columns[i] < 0) {
+                continue;
+            }
+
+            for (unsigned int row = first; row < first + count; row++) {
+                (*writtenTicks[i])[entities[row].GetId()].changed = *changeTick;
+            }
+
+            if (NEXT[i]) {
+                match.archetype->GetNextRows(chunkIndex, first, match.columns[i], count);
+            }
+        }
+    }
+
+    template <size_t I>
+    static std::tuple_element_t<I, ColumnsT> LoadColumn(const ArchetypeMatch &match, ArchetypeChunk *chunk) {
+        using ColumnT = std::tuple_element_t<I, ColumnsT>;
+
+        if (match.columns[I] < 0) {
+            return nullptr;
+        }
+
+        auto &columns = IsNext<std::remove_pointer_t<ColumnT>> ? chunk->nextColumns : chunk->columns;
+        return reinterpret_cast<ColumnT>(columns[match.columns[I]]);
+    }
+
+    // Columns of the chunk, null for a missing optional column
+    template <size_t... I>
+    static ColumnsT LoadColumns(const ArchetypeMatch &match, ArchetypeChunk *chunk, std::index_sequence<I...>) {
+        return ColumnsT(LoadColumn<I>(match, chunk)...);
+    }
+
+  public:
+    ArchetypeGroupView(const std::vector<Archetype*> &archetypes, ArchetypeCommandQueue *commandQueue, ArchetypeChangeTicks *ticks,
+                       const std::vector<ChangeTicks> *filterTicks = nullptr, uint64_t filterTick = 0, bool filterAdded = false) :
+        commandQueue(commandQueue), changeTick(ticks->changeTick),
+        writtenTicks{(IsWritable<T> ? &ticks->byType[Component<T>::GetTypeId()] : nullptr)...,
+                     (IsWritable<OptionalsT> ? &ticks->byType[Component<OptionalsT>::GetTypeId()] : nullptr)...},
+        filterTicks(filterTicks), filterTick(filterTick), filterAdded(filterAdded) {
+        for (auto archetype : archetypes) {
+            matches.push_back({archetype, {archetype->GetColumn(Component<T>::GetTypeId())..., archetype->GetColumn(Component<OptionalsT>::GetTypeId())...}});
+        }
+
+        commandQueue->SignalViewStarted();
+    }
+
+    ~ArchetypeGroupView() {
+        commandQueue->SignalViewFinished();
+    }
+
+    ArchetypeGroupView(const ArchetypeGroupView &other) = delete;
+    ArchetypeGroupView &operator=(const ArchetypeGroupView &other) = delete;
+
+    // ITERATOR
+    class ArchetypeGroupIterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = std::tuple<T..., OptionalsT*...>;
+        using pointer           = std::tuple<T*..., OptionalsT*...>;
+        using reference         = std::tuple<T&..., OptionalsT*...>;
+
+      private:
+        const ArchetypeGroupView *view;
+        size_t archetypeIndex;
+        size_t chunkIndex;
+        unsigned int row = 0;
+        unsigned int count = 0;
+        const Entity *entities = nullptr;
+        pointer columns;
+
+        // Moves to the first row of the next non empty chunk, starting with the current one
+        void LoadChunk() {
+            row = 0;
+
+            while (archetypeIndex < view->matches.size()) {
+                const auto &match = view->matches[archetypeIndex];
+
+                if (chunkIndex < match.archetype->GetChunksCount()) {
+                    auto chunk = match.archetype->GetChunk(chunkIndex);
+                    count = chunk->count;
+                    entities = chunk->entities;
+                    columns = view->LoadColumns(match, chunk, std::index_sequence_for<T..., OptionalsT...>());
+                    return;
+                }
+
+                archetypeIndex++;
+                chunkIndex = 0;
+            }
+
+            count = 0;
+        }
+
+        // Moves to the first row passing the filter, starting with the current one
+        void Seek() {
+            while (count > 0) {
+                for (; row < count; row++) {
+                    if (view->Passes(entities[row])) {
+                        return;
+                    }
+                }
+
+                chunkIndex++;
+                LoadChunk();
+            }
+        }
+
+        template <typename U>
+        U *OptionalAt(U *column) const {
+            return column == nullptr ? nullptr : column + row;
+        }
+
+        template <size_t... I, size_t... J>
+        reference Dereference(std::index_sequence<I...>, std::index_sequence<J...>) const {
+            return reference(std::get<I>(columns)[row]..., OptionalAt(std::get<sizeof...(T) + J>(columns))...);
+        }
+
+      public:
+        ArchetypeGroupIterator(const ArchetypeGroupView *view, size_t archetypeIndex, size_t chunkIndex = 0) :
+            view(view), archetypeIndex(archetypeIndex), chunkIndex(chunkIndex) {
+            LoadChunk();
+            Seek();
+        }
+
+        bool IsInChunk(size_t archetypeIndex, size_t chunkIndex) const {
+            return this->archetypeIndex == archetypeIndex && this->chunkIndex == chunkIndex;
+        }
+
+        reference operator*() const {
+            view->Stamp(view->matches[archetypeIndex], chunkIndex, row, 1);
+            return Dereference(std::index_sequence_for<T...>(), std::index_sequence_for<OptionalsT...>());
+        }
+
+        // Prefix increment
+        ArchetypeGroupIterator &operator++() {
+            row++;
+
+            if (row == count) {
+                chunkIndex++;
+                LoadChunk();
+            }
+
+            Seek();
+            return *this;
+        }
+
+        // Postfix increment
+        ArchetypeGroupIterator operator++(int) {
+            ArchetypeGroupIterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const ArchetypeGroupIterator& a, const ArchetypeGroupIterator& b) {
+            return a.archetypeIndex == b.archetypeIndex && a.chunkIndex == b.chunkIndex && a.row == b.row;
+        };
+
+        friend bool operator!=(const ArchetypeGroupIterator& a, const ArchetypeGroupIterator& b) {
+            return !(a == b);
+        };
+    };
+
+    ArchetypeGroupIterator begin() const {
+        return ArchetypeGroupIterator(this, 0);
+    }
+
+    ArchetypeGroupIterator end() const {
+        return ArchetypeGroupIterator(this, matches.size());
+    }
+
+    // (archetype, chunk) pairs of every non empty chunk in the view
+    std::vector<std::pair<size_t, size_t>> GetChunks() const {
+        std::vector<std::pair<size_t, size_t>> chunks;
+
+        for (size_t i = 0; i < matches.size(); i++) {
+            for (size_t j = 0; j < matches[i].archetype->GetChunksCount(); j++) {
+                chunks.emplace_back(i, j);
+            }
+        }
+
+        return chunks;
+    }
+
+    // Calls fn for every row of one chunk, different chunks can be walked by different threads
+    template <typename FnT>
+    void ForEachInChunk(size_t archetypeIndex, size_t chunkIndex, FnT &&fn) const {
+        for (ArchetypeGroupIterator it(this, archetypeIndex, chunkIndex); it.IsInChunk(archetypeIndex, chunkIndex); ++it) {
+            fn(*it);
+        }
+    }
+
+    // Calls runFn(columns, count) for every run of consecutive rows of one chunk that pass the filter, columns points
+    // to the run's first row. Without a filter the whole chunk is one run.
+    template <typename RunFnT>
+    void ForEachRunInChunk(size_t archetypeIndex, size_t chunkIndex, RunFnT &&runFn) const {
+        auto &match = matches[archetypeIndex];
+        auto chunk = match.archetype->GetChunk(chunkIndex);
+        auto columns = LoadColumns(match, chunk, std::index_sequence_for<T..., OptionalsT...>());
+
+        for (unsigned int first = 0; first < chunk->count;) {
+            if (!Passes(chunk->entities[first])) {
+                first++;
+                continue;
+            }
+
+            unsigned int last = first + 1;
+
+            while (last < chunk->count && Passes(chunk->entities[last])) {
+                last++;
+            }
+
+            Stamp(match, chunkIndex, first, last - first);
+            runFn(std::apply([first](auto ...column) {
+                return ColumnsT((column == nullptr ? nullptr : column + first)...);
+            }, columns), (size_t) (last - first));
+            first = last;
+        }
+    }
+};
+
+// Archetypes matching the mask, new archetypes are added as they are created
+class ArchetypeQuery : public QueryBase {
+  private:
+    friend class ArchetypeEngineCore;
+    std::vector<Archetype*> archetypes;
+
+  public:
+    ArchetypeQuery(const ComponentMask &mask, const ComponentMask &excluded, std::vector<Archetype*> archetypes) :
+        QueryBase(mask, excluded), archetypes(std::move(archetypes)) {}
+
+    const std::vector<Archetype*> &GetArchetypes() const {
+        return archetypes;
+    }
+};
+
+class ArchetypeEngineCore {
+  private:
+    struct EntityLocation {
+        Archetype *archetype = nullptr;
+        unsigned int chunk = 0;
+        unsigned int row = 0;
+    };
+
+    SystemManager systemManager;
+    UniqueIdsManager<ArchetypeEngineCore> entityIdManager;
+    std::vector<EntityLocation> locations;
+    std::vector<std::unique_ptr<Archetype>> archetypes;
+    std::unordered_map<ComponentMask, Archetype*> archetypesByMask;
+    std::unordered_map<ID, Archetype*> rootEdges;
+    // Archetypes with a buffered type, swapped at the end of CallAll
+    std::vector<Archetype*> bufferedArchetypes;
+    ArchetypeCommandQueue commandQueue;
+    std::vector<std::unique_ptr<ArchetypeQuery>> queries;
+    std::unique_ptr<JobSystem> jobSystem;
+    EventChannels events;
+    ArchetypeChangeTicks changeTicks;
+    // Indexed by component type id
+    std::vector<ArchetypeObservers> observers;
+    uint64_t lastObserverId = 0;
+    // Incremented whenever a row is removed, which moves the entity and the last row of its archetype
+    uint64_t structuralVersion = 0;
+
+    EntityLocation &GetLocation(Entity entity) {
+        if (entity.GetId() >= locations.size()) {
+            locations.resize(std::max<size_t>(entity.GetId() + 1, locations.size() * 2));
+        }
+
+        return locations[entity.GetId()];
+    }
+
+    Archetype *GetArchetype(std::vector<ComponentTypeInfo> types);
+    Archetype *GetArchetypeAdding(Archetype *source, const ComponentTypeInfo &type);
+    Archetype *GetArchetypeRemoving(Archetype *source, ID id);
+
+    // Moves the entity's row to the destination archetype, leaving components missing from the source unconstructed
+    void MoveEntity(Entity entity, Archetype *destination);
+    void RemoveRow(Archetype *archetype, unsigned int chunk, unsigned int row);
+
+    bool IsObserved(ID type, ComponentEvent event) const {
+        return type < observers.size() && observers[type].IsObserved(event);
+    }
+
+    // Structural changes the observers make are queued, the caller runs them with SignalViewFinished once its own
+    // change is done
+    void Notify(ID type, ComponentEvent event, Entity entity, void *component);
+    // Notifies the observers of every component of the row
+    void NotifyRow(Archetype *archetype, unsigned int chunk, unsigned int row, ComponentEvent event);
+    void FlushObservers();
+
+    std::vector<Archetype*> GetArchetypes(const ComponentMask &mask);
+    ArchetypeQuery *GetQuery(const ComponentMask &mask, const ComponentMask &excluded = ComponentMask());
+
+    std::vector<Entity> AllocateEntities(size_t count);
+
+    template <typename... ComponentsT, size_t... I, typename ValuesT>
+    static void ConstructRow(Archetype *archetype, unsigned int chunk, unsigned int row, const std::array<int, sizeof...(ComponentsT)> &columns,
+                             const ValuesT &values, std::index_sequence<I...>) {
+        (new (archetype->GetComponent(chunk, row, columns[I])) ComponentsT(std::get<I>(values)), ...);
+    }
+
+    // Appends the entities straight to the archetype of Entity plus ComponentsT, get(i) returns the component values of entity i
+    template <typename... ComponentsT, typename GetT>
+    void PlaceEntities(const std::vector<Entity> &entities, GetT get) {
+        auto archetype = GetArchetype({ComponentTypeInfo::Create<Entity>(), ComponentTypeInfo::Create<ComponentsT>()...});
+        int entityColumn = archetype->GetColumn(Component<Entity>::GetTypeId());
+        std::array<int, sizeof...(ComponentsT)> columns{archetype->GetColumn(Component<ComponentsT>::GetTypeId())...};
+
+        commandQueue.SignalViewStarted();
+
+        for (size_t i = 0; i < entities.size(); i++) {
+            auto [chunk, row] = archetype->AllocateRow(entities[i]);
+            GetLocation(entities[i]) = EntityLocation{archetype, chunk, row};
+
+            new (archetype->GetComponent(chunk, row, entityColumn)) Entity(entities[i]);
+            ConstructRow<ComponentsT...>(archetype, chunk, row, columns, get(i), std::index_sequence_for<ComponentsT...>());
+            (changeTicks.Stamp(Component<ComponentsT>::GetTypeId(), entities[i], true), ...);
+            NotifyRow(archetype, chunk, row, ComponentEvent::ADD);
+        }
+
+        commandQueue.SignalViewFinished();
+    }
+
+    template <typename T>
+    T *FindComponent(Entity entity) {
+        if (!IsAlive(entity) || entity.GetId() >= locations.size()) {
+            return nullptr;
+        }
+
+        auto &location = locations[entity.GetId()];
+
+        if (location.archetype == nullptr) {
+            return nullptr;
+        }
+
+        int column = location.archetype->GetColumn(Component<T>::GetTypeId());
+
+        if (column < 0) {
+            return nullptr;
+        }
+
+        return static_cast<T*>(location.archetype->GetComponent(location.chunk, location.row, column));
+    }
+
+  public:
+    ArchetypeEngineCore();
+
+    Entity CreateEntity();
+    void DeleteEntity(Entity entity);
+    void DeleteEntities(const std::vector<Entity> &entities);
+
+    // Creates count entities with a copy of every component, the rows are appended to one archetype
+    template <typename... ComponentsT>
+    std::vector<Entity> CreateEntities(size_t count, const ComponentsT &... components) {
+        auto entities = AllocateEntities(count);
+        auto place = [this, entities, components...]() {
+            PlaceEntities<ComponentsT...>(entities, [&](size_t) {
+                return std::forward_as_tuple(components...);
+            });
+        };
+
+        if (commandQueue.IsLocked()) {
+            commandQueue.Push(place);
+        } else {
+            place();
+        }
+
+        return entities;
+    }
+
+    // Creates one entity per element, all the vectors must have the same size
+    template <typename ComponentT1, typename... ComponentsT>
+    std::vector<Entity> CreateEntities(const std::vector<ComponentT1> &components1, const std::vector<ComponentsT> &... components) {
+        if (((components.size() != components1.size()) || ...)) {
+            LOG_ERROR("debug", "CreateEntities called with component vectors of different sizes");
+            return {};
+        }
+
+        auto entities = AllocateEntities(components1.size());
+        auto place = [this, entities, components1, components...]() {
+            PlaceEntities<ComponentT1, ComponentsT...>(entities, [&](size_t i) {
+                return std::forward_as_tuple(components1[i], components[i]...);
+            });
+        };
+
+        if (commandQueue.IsLocked()) {
+            commandQueue.Push(place);
+        } else {
+            place();
+        }
+
+        return entities;
+    }
+
+    // False for deleted entities and for handles to an index that was reused since
+    bool IsAlive(Entity entity) const {
+        return entityIdManager.IsAlive(entity.GetId(), entity.GetGeneration());
+    }
+
+    template <typename T>
+    void DeleteComponent(Entity entity) {
+        if (commandQueue.IsLocked()) {
+            commandQueue.Push([this, entity]() {
+                DeleteComponent<T>(entity);
+            });
+            return;
+        }
+
+        if (!IsAlive(entity)) {
+            return;
+        }
+
+        auto &location = GetLocation(entity);
+
+        int column = location.archetype == nullptr ? -1 : location.archetype->GetColumn(Component<T>::GetTypeId());
+
+        if (column < 0) {
+            return;
+        }
+
+        // Observers see the component before it is removed
+        commandQueue.SignalViewStarted();
+        Notify(Component<T>::GetTypeId(), ComponentEvent::REMOVE, entity, location.archetype->GetComponent(location.chunk, location.row, column));
+        MoveEntity(entity, GetArchetypeRemoving(location.archetype, Component<T>::GetTypeId()));
+        commandQueue.SignalViewFinished();
+    }
+
+    template <typename... ComponentsT>
+    void DeleteComponents(Entity entity) {
+        (DeleteComponent<ComponentsT>(entity), ...);
+    }
+
+    // Every row moves to another archetype on its own, so the batched versions just loop
+    template <typename T>
+    void DeleteComponent(const std::vector<Entity> &entities) {
+        for (auto &entity : entities) {
+            DeleteComponent<T>(entity);
+        }
+    }
+
+    template <typename T>
+    void AddComponents(std::vector<std::pair<Entity, T>> rows) {
+        for (auto &row : rows) {
+            AddComponent(row.first, row.second);
+        }
+    }
+
+    template <typename T>
+    void AddComponent(const Entity &entity, const T &data) {
+        if (commandQueue.IsLocked()) {
+            commandQueue.Push([this, entity, data]() {
+                AddComponent(entity, data);
+            });
+            return;
+        }
+
+        if (!IsAlive(entity)) {
+            LOG_INFO("debug", "Component not added, entity %u is not alive", (unsigned int) entity.GetId());
+            return;
+        }
+
+        auto &location = GetLocation(entity);
+
+        if (location.archetype != nullptr) {
+            int column = location.archetype->GetColumn(Component<T>::GetTypeId());
+
+            if (column >= 0) {
+                auto component = static_cast<T*>(location.archetype->GetComponent(location.chunk, location.row, column));
+                *component = T(data);
+                location.archetype->DiscardNext(location.chunk, location.row, column);
+                changeTicks.Stamp(Component<T>::GetTypeId(), entity, false);
+
+                commandQueue.SignalViewStarted();
+                Notify(Component<T>::GetTypeId(), ComponentEvent::REPLACE, entity, component);
+                commandQueue.SignalViewFinished();
+                return;
+            }
+        }
+
+        auto destination = GetArchetypeAdding(location.archetype, ComponentTypeInfo::Create<T>());
+        MoveEntity(entity, destination);
+
+        auto &movedLocation = locations[entity.GetId()];
+        auto component = new (destination->GetComponent(movedLocation.chunk, movedLocation.row, destination->GetColumn(Component<T>::GetTypeId()))) T(data);
+        changeTicks.Stamp(Component<T>::GetTypeId(), entity, true);
+
+        commandQueue.SignalViewStarted();
+        Notify(Component<T>::GetTypeId(), ComponentEvent::ADD, entity, component);
+        commandQueue.SignalViewFinished();
+    }
+
+    // Taking a non-const pointer marks the component as changed, a buffered type is only written through its
+    // next value
+    template <typename T>
+    T *GetComponent(Entity entity) {
+        auto component = FindComponent<T>(entity);
+
+        if constexpr (!std::is_const_v<T>) {
+            if (component != nullptr) {
+                auto &location = locations[entity.GetId()];
+                changeTicks.Stamp(Component<T>::GetTypeId(), entity, false);
+                return static_cast<T*>(location.archetype->GetNextRows(location.chunk, location.row,
+                                       location.archetype->GetColumn(Component<T>::GetTypeId()), 1));
+            }
+        }
+
+        return component;
+    }
+
+    // Same as GetComponent, named for the call sites that write the next value of a buffered type
+    template <typename T>
+    T *GetNextComponent(Entity entity) {
+        return GetComponent<T>(entity);
+    }
+
+    // The next value if it was written this frame, otherwise the current one
+    template <typename T>
+    const T *GetLatestComponent(Entity entity) {
+        if (FindComponent<T>(entity) == nullptr) {
+            return nullptr;
+        }
+
+        auto &location = locations[entity.GetId()];
+        return static_cast<const T*>(location.archetype->GetLatestComponent(location.chunk, location.row,
+                                     location.archetype->GetColumn(Component<T>::GetTypeId())));
+    }
+
+    // True if the entity has a T changed, or added, since the running system last ran
+    template <typename T>
+    bool IsChanged(Entity entity, bool added) {
+        if (FindComponent<T>(entity) == nullptr) {
+            return false;
+        }
+
+        auto &entityTicks = changeTicks.byType[Component<T>::GetTypeId()][entity.GetId()];
+        return (added ? entityTicks.added : entityTicks.changed) > systemManager.GetLastRunTick();
+    }
+
+    // Rows only move when a row is removed, so every type shares one version
+    template <typename T>
+    uint64_t GetComponentVersion() const {
+        return structuralVersion;
+    }
+
+    template <typename T, typename FnT>
+    ObserverHandle Observe(ComponentEvent event, FnT fn) {
+        ID type = Component<T>::GetTypeId();
+
+        if (type >= observers.size()) {
+            observers.resize(type + 1);
+        }
+
+        observers[type].observers[(size_t) event].emplace_back(++lastObserverId, [fn](Entity entity, void *component) {
+            fn(entity, *static_cast<T*>(component));
+        });
+        return ObserverHandle{type, event, false, lastObserverId};
+    }
+
+    template <typename T, typename FnT>
+    ObserverHandle Observe(ComponentEvent event, FnT fn, __attribute__((unused)) Batched batched) {
+        ID type = Component<T>::GetTypeId();
+
+        if (type >= observers.size()) {
+            observers.resize(type + 1);
+        }
+
+        observers[type].batchObservers[(size_t) event].emplace_back(++lastObserverId, fn);
+        return ObserverHandle{type, event, true, lastObserverId};
+    }
+
+    void Unobserve(const ObserverHandle &handle);
+
+    // The components of an archetype are already stored in lockstep, chunk by chunk, so there is nothing to pack
+    template <typename... T>
+    void CreateOwnedGroup() {
+    }
+
+    std::vector<Entity> GetEntities(ComponentMask mask);
+
+    void EntitiesCallFor(ComponentMask mask, std::function<void (std::vector<Entity>, Engine<ArchetypeEngineCore>*)> fn, Engine<ArchetypeEngineCore> *engine);
+
+    template <typename... T>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<>> GetGroupView() {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<>>(GetArchetypes(CreateMask<T...>()), &commandQueue, &changeTicks);
+    }
+
+    template <typename... T, typename UnusedT1, typename... UnusedT>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<>> GetGroupView(__attribute__((unused)) Unused<UnusedT1, UnusedT...> unused) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<>>(GetArchetypes(CreateMask<T..., UnusedT1, UnusedT...>()), &commandQueue, &changeTicks);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(GetArchetypes(CreateMask<T...>()), &commandQueue, &changeTicks);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt, __attribute__((unused)) Unused<UnusedT...> unused) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(GetArchetypes(CreateMask<T..., UnusedT...>()), &commandQueue, &changeTicks);
+    }
+
+    template <typename... T>
+    Query<std::tuple<T...>> CreateQuery() {
+        return GetQuery(CreateMask<T...>());
+    }
+
+    template <typename... T, typename UnusedT1, typename... UnusedT>
+    Query<std::tuple<T...>> CreateQuery(__attribute__((unused)) Unused<UnusedT1, UnusedT...> unused) {
+        return GetQuery(CreateMask<T..., UnusedT1, UnusedT...>());
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt) {
+        return GetQuery(CreateMask<T...>());
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt, __attribute__((unused)) Unused<UnusedT...> unused) {
+        return GetQuery(CreateMask<T..., UnusedT...>());
+    }
+
+    template <typename... T, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>> CreateQuery(__attribute__((unused)) Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return GetQuery(CreateMask<T...>(), CreateMask<ExcludedT1, ExcludedT...>());
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt,
+            __attribute__((unused)) Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return GetQuery(CreateMask<T...>(), CreateMask<ExcludedT1, ExcludedT...>());
+    }
+
+    template <typename... T, typename... OptionalT>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT...>> GetGroupView(const Query<std::tuple<T...>, std::tuple<OptionalT...>> &query) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT...>>(static_cast<ArchetypeQuery*>(query.Get())->GetArchetypes(), &commandQueue, &changeTicks);
+    }
+
+    // Only the rows whose FilterT was changed, or added, since the running system last ran
+    template <typename... T, typename FilterT, bool ADDED>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<>> GetGroupView(__attribute__((unused)) ChangeFilter<FilterT, ADDED> filter) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<>>(GetArchetypes(CreateMask<T..., FilterT>()), &commandQueue, &changeTicks,
+                &changeTicks.byType[Component<FilterT>::GetTypeId()], systemManager.GetLastRunTick(), ADDED);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename FilterT, bool ADDED>
+    ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt,
+            __attribute__((unused)) ChangeFilter<FilterT, ADDED> filter) {
+        return ArchetypeGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(GetArchetypes(CreateMask<T..., FilterT>()), &commandQueue,
+                &changeTicks, &changeTicks.byType[Component<FilterT>::GetTypeId()], systemManager.GetLastRunTick(), ADDED);
+    }
+
+    // Per frame events, cleared at the end of CallAll
+    template <typename T>
+    EventChannel<T> &GetEvents() {
+        return events.template Get<T>();
+    }
+
+    JobSystem *GetJobSystem();
+
+    // Calls job(commands, forEachRow, forEachRun) once per chunk of the group view, forEachRow(rowFn) walks the
+    // rows of the chunk and forEachRun(runFn) hands the whole chunk to runFn. The jobs must not change the engine directly, structural changes go through commands and are
+    // committed in thread order after the iteration.
+    template <typename... T, typename JobT, typename... ArgsT>
+    void RunParallel(JobT job, ArgsT... args) {
+        auto jobs = GetJobSystem();
+        std::vector<CommandBuffer<ArchetypeEngineCore>> commands;
+
+        for (unsigned int i = 0; i < jobs->GetThreadsCount(); i++) {
+            commands.emplace_back(this);
+        }
+
+        {
+            auto view = GetGroupView<T...>(args...);
+            auto chunks = view.GetChunks();
+
+            jobs->Run(chunks.size(), [&](size_t chunk, unsigned int thread) {
+                job(commands[thread], [&](auto &&rowFn) {
+                    view.ForEachInChunk(chunks[chunk].first, chunks[chunk].second, rowFn);
+                }, [&](auto &&runFn) {
+                    view.ForEachRunInChunk(chunks[chunk].first, chunks[chunk].second, runFn);
+                });
+            });
+        }
+
+        for (auto &buffer : commands) {
+            buffer.Commit();
+        }
+    }
+
+    void Register(System system);
+    void Register(SystemInterface *sysInt);
+    void Unregister(ID id);
+    void CallAll();
+};
+
+}
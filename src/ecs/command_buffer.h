@@ -0,0 +1,108 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "component.h"
+#include "component_manager.h"
+#include "entity.h"
+
+namespace ECS {
+
+// Structural changes recorded by one thread while the engine is being iterated in parallel. The changes are
+// kept per component type with the payloads stored contiguously and Commit applies every type as one batch.
+template <typename EngineCoreT>
+class CommandBuffer {
+  private:
+    struct TypedCommandsBase {
+        virtual ~TypedCommandsBase() {}
+        virtual bool empty() const = 0;
+        virtual void Commit(EngineCoreT *core) = 0;
+    };
+
+    template <typename T>
+    struct TypedCommands : public TypedCommandsBase {
+        DeferredComponentCommands<T> commands;
+
+        virtual bool empty() const override {
+            return commands.empty();
+        }
+
+        virtual void Commit(EngineCoreT *core) override {
+            std::vector<Entity> removed;
+            std::vector<std::pair<Entity, T>> added;
+            commands.Resolve(removed, added);
+
+            if (!removed.empty()) {
+                core->template DeleteComponent<T>(removed);
+            }
+
+            if (!added.empty()) {
+                core->AddComponents(std::move(added));
+            }
+        }
+    };
+
+    EngineCoreT *core;
+    // Indexed by Component<T>::GetTypeId(), null for types without commands
+    std::vector<std::unique_ptr<TypedCommandsBase>> commandsByTypeId;
+    std::vector<Entity> deletedEntities;
+
+    template <typename T>
+    DeferredComponentCommands<T> &GetCommands() {
+        ID id = Component<T>::GetTypeId();
+
+        if (id >= commandsByTypeId.size()) {
+            commandsByTypeId.resize(id + 1);
+        }
+
+        if (commandsByTypeId[id] == nullptr) {
+            commandsByTypeId[id] = std::make_unique<TypedCommands<T>>();
+        }
+
+        return static_cast<TypedCommands<T>*>(commandsByTypeId[id].get())->commands;
+    }
+
+  public:
+    CommandBuffer(EngineCoreT *core) : core(core) {}
+
+    template <typename T>
+    void AddComponent(const Entity &entity, const T &data) {
+        GetCommands<T>().Add(entity, data);
+    }
+
+    template <typename... ComponentsT>
+    void DeleteComponents(Entity entity) {
+        (GetCommands<ComponentsT>().Remove(entity), ...);
+    }
+
+    void DeleteEntity(Entity entity) {
+        deletedEntities.push_back(entity);
+    }
+
+    bool empty() const {
+        for (auto &commands : commandsByTypeId) {
+            if (commands != nullptr && !commands->empty()) {
+                return false;
+            }
+        }
+
+        return deletedEntities.empty();
+    }
+
+    // Component changes are applied first, type by type, then the entities are deleted
+    void Commit() {
+        for (auto &commands : commandsByTypeId) {
+            if (commands != nullptr && !commands->empty()) {
+                commands->Commit(core);
+            }
+        }
+
+        if (!deletedEntities.empty()) {
+            auto deleted = std::move(deletedEntities);
+            deletedEntities.clear();
+            core->DeleteEntities(deleted);
+        }
+    }
+};
+
+}
@@ -1,7 +1,35 @@
 #include "component.h"
 
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include "../logging/logging.h"
+
 namespace ECS {
 
+ID ComponentTypeRegistry::GetTypeId(const std::type_index &type) {
+    static std::mutex mutex;
+    static std::unordered_map<std::type_index, ID> ids;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(type);
+
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    ID id = ids.size();
+
+    // A larger id would be silently dropped by every ComponentMask, so queries would match the wrong entities
+    if (id >= ECS_MAX_COMPONENT_TYPES) {
+        LOG_ERROR("debug", "Component type %s exceeds ECS_MAX_COMPONENT_TYPES (%u)", type.name(), ECS_MAX_COMPONENT_TYPES);
+        std::abort();
+    }
+
+    ids[type] = id;
+    return id;
+}
+
 ComponentMask CreateMask(std::initializer_list<ID> ids) {
     ComponentMask mask;
 
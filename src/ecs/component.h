@@ -1,8 +1,13 @@
 #pragma once
 
-#include <set>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
 #include <typeinfo>
 #include <typeindex>
+#include <type_traits>
 #include "common.h"
 
 namespace ECS {
@@ -15,6 +20,13 @@ namespace ECS {
     }
 };*/
 
+// Hands out a small dense index per component type. The registry lives in a single translation unit so
+// every module asks the same table and a type keeps its index across dynamically loaded scripts.
+class ComponentTypeRegistry {
+  public:
+    static ID GetTypeId(const std::type_index &type);
+};
+
 template <typename T>
 class Component {
   public:
@@ -24,12 +36,197 @@ class Component {
         GetTypeId();
     }
 
+    // const T shares the id of T, views read const elements from the same pool
     static ID GetTypeId() {
-        return std::type_index(typeid(Component<T>)).hash_code();
+        static ID id = ComponentTypeRegistry::GetTypeId(std::type_index(typeid(Component<std::remove_const_t<T>>)));
+        return id;
     }
 };
 
-typedef std::set<ID> ComponentMask;
+#ifndef ECS_MAX_COMPONENT_TYPES
+#define ECS_MAX_COMPONENT_TYPES 256
+#endif
+
+// Fixed-size bitset indexed by component type id, with a set-like interface
+class ComponentMask {
+  private:
+    typedef uint64_t Word;
+    static constexpr size_t WORD_BITS = 64;
+    static constexpr size_t WORDS = (ECS_MAX_COMPONENT_TYPES + WORD_BITS - 1) / WORD_BITS;
+
+    std::array<Word, WORDS> words{};
+
+  public:
+    ComponentMask() {}
+
+    // Ids are checked when the type is registered
+    void insert(ID id) {
+        assert(id < WORDS * WORD_BITS);
+        words[id / WORD_BITS] |= Word(1) << (id % WORD_BITS);
+    }
+
+    template <typename IteratorT>
+    void insert(IteratorT first, IteratorT last) {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    void insert(const ComponentMask &other) {
+        for (size_t i = 0; i < WORDS; i++) {
+            words[i] |= other.words[i];
+        }
+    }
+
+    size_t erase(ID id) {
+        size_t found = count(id);
+
+        if (found) {
+            words[id / WORD_BITS] &= ~(Word(1) << (id % WORD_BITS));
+        }
+
+        return found;
+    }
+
+    size_t count(ID id) const {
+        if (id >= WORDS * WORD_BITS) {
+            return 0;
+        }
+
+        return (words[id / WORD_BITS] >> (id % WORD_BITS)) & 1;
+    }
+
+    size_t size() const {
+        size_t bits = 0;
+
+        for (auto word : words) {
+            bits += __builtin_popcountll(word);
+        }
+
+        return bits;
+    }
+
+    bool empty() const {
+        for (auto word : words) {
+            if (word) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void clear() {
+        words.fill(0);
+    }
+
+    // True if every component in other is also in this mask
+    bool Contains(const ComponentMask &other) const {
+        for (size_t i = 0; i < WORDS; i++) {
+            if ((words[i] & other.words[i]) != other.words[i]) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool Intersects(const ComponentMask &other) const {
+        for (size_t i = 0; i < WORDS; i++) {
+            if (words[i] & other.words[i]) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    size_t Hash() const {
+        size_t hash = 0;
+
+        for (auto word : words) {
+            hash ^= std::hash<Word>()(word) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+        }
+
+        return hash;
+    }
+
+    bool operator==(const ComponentMask &other) const {
+        return words == other.words;
+    }
+
+    bool operator!=(const ComponentMask &other) const {
+        return words != other.words;
+    }
+
+    bool operator<(const ComponentMask &other) const {
+        return words < other.words;
+    }
+
+    // Iterates the ids of the components in the mask in ascending order
+    class Iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = ID;
+        using pointer           = const ID*;
+        using reference         = ID;
+
+      private:
+        const ComponentMask *mask;
+        ID id;
+
+        void Seek() {
+            while (id < WORDS * WORD_BITS) {
+                Word word = mask->words[id / WORD_BITS] >> (id % WORD_BITS);
+
+                if (word) {
+                    id += __builtin_ctzll(word);
+                    return;
+                }
+
+                id = (id / WORD_BITS + 1) * WORD_BITS;
+            }
+        }
+
+      public:
+        Iterator(const ComponentMask *mask, ID id) : mask(mask), id(id) {
+            Seek();
+        }
+
+        ID operator*() const {
+            return id;
+        }
+
+        Iterator &operator++() {
+            id++;
+            Seek();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const Iterator& a, const Iterator& b) {
+            return a.id == b.id;
+        };
+
+        friend bool operator!=(const Iterator& a, const Iterator& b) {
+            return a.id != b.id;
+        };
+    };
+
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(this, WORDS * WORD_BITS);
+    }
+};
 
 ComponentMask CreateMask(std::initializer_list<ID> ids);
 
@@ -44,13 +241,7 @@ namespace std {
 template <>
 struct hash<ECS::ComponentMask> {
     size_t operator()(const ECS::ComponentMask &p) const {
-        std::string acc;
-
-        for (auto id : p) {
-            acc += std::to_string(id);
-        }
-
-        return std::hash<string>()(acc);
+        return p.Hash();
     }
 };
 }
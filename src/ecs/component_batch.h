@@ -0,0 +1,234 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ECS {
+
+// Number of rows of a ComponentBatch handed to the callback at once
+#ifndef ECS_BATCH_SIZE
+#define ECS_BATCH_SIZE 64
+#endif
+
+enum class ComponentLayout {
+    STRUCT,
+    FLOAT_ARRAYS
+};
+
+template <typename T>
+struct ComponentLayoutTraits {
+    static constexpr ComponentLayout layout = ComponentLayout::STRUCT;
+    static constexpr size_t floats = 0;
+};
+
+// Declares the component as exactly FloatsCount packed floats, so a run of them in the component pool is one packed
+// float array that batches hand to kernels as is. Must be used in the global namespace
+#define FloatArraysComponent(ComponentT, FloatsCount) \
+template <> \
+struct ECS::ComponentLayoutTraits<ComponentT> { \
+    static_assert(sizeof(ComponentT) == (FloatsCount) * sizeof(float) && std::is_standard_layout<ComponentT>::value, \
+                  "Float array components must be standard layout and hold exactly FloatsCount floats"); \
+    static constexpr ECS::ComponentLayout layout = ECS::ComponentLayout::FLOAT_ARRAYS; \
+    static constexpr size_t floats = FloatsCount; \
+}
+
+template <typename RowT>
+class ComponentBatch {
+};
+
+// Up to ECS_BATCH_SIZE rows of a group view. The float array components of an element are read as one packed array,
+// ComponentLayoutTraits<T>::floats floats per row, in the component's field order. When the rows of the batch are
+// consecutive in the element's pool, e.g. the prefix of an owned group or an archetype chunk, the array is the pool's
+// own storage and kernels work on it in place. Otherwise Read and Write copy the components into the batch and Flush
+// copies the written ones back. Missing optional components read as zeros.
+template <typename... ElementsT>
+class ComponentBatch<std::tuple<ElementsT...>> {
+  public:
+    static constexpr size_t SIZE = ECS_BATCH_SIZE;
+
+  private:
+    static constexpr size_t ELEMENTS = sizeof...(ElementsT);
+
+    template <typename E>
+    using ComponentOf = std::remove_pointer_t<std::remove_reference_t<E>>;
+
+    template <typename E>
+    static constexpr size_t FloatsOf = ComponentLayoutTraits<std::remove_const_t<ComponentOf<E>>>::floats;
+
+    template <size_t I>
+    using ElementAt = std::tuple_element_t<I, std::tuple<ElementsT...>>;
+
+    struct alignas(32) Copies {
+        float data[SIZE];
+    };
+
+    std::tuple<std::array<Copies, FloatsOf<ElementsT>>...> copies;
+    std::array<std::tuple<ComponentOf<ElementsT>*...>, SIZE> rows;
+    // Set by PushRun, the components of row i are first + i
+    std::tuple<ComponentOf<ElementsT>*...> first;
+    bool run = false;
+    std::array<bool, ELEMENTS> copied{};
+    std::array<bool, ELEMENTS> written{};
+    size_t count = 0;
+
+    template <typename E>
+    static ComponentOf<E> *ToPointer(E &&element) {
+        if constexpr (std::is_pointer_v<std::remove_reference_t<E>>) {
+            return element;
+        } else {
+            return &element;
+        }
+    }
+
+    template <size_t I>
+    float *Copy() {
+        constexpr size_t floats = FloatsOf<ElementAt<I>>;
+        float *data = std::get<I>(copies)[0].data;
+
+        if (!copied[I]) {
+            for (size_t row = 0; row < count; row++) {
+                auto component = Get<I>(row);
+
+                if (component == nullptr) {
+                    std::memset(data + row * floats, 0, floats * sizeof(float));
+                } else {
+                    std::memcpy(data + row * floats, component, floats * sizeof(float));
+                }
+            }
+
+            copied[I] = true;
+        }
+
+        return data;
+    }
+
+    template <size_t I>
+    void CopyBack() {
+        if constexpr (FloatsOf<ElementAt<I>> > 0 && !std::is_const_v<ComponentOf<ElementAt<I>>>) {
+            constexpr size_t floats = FloatsOf<ElementAt<I>>;
+            const float *data = std::get<I>(copies)[0].data;
+
+            if (!written[I]) {
+                return;
+            }
+
+            for (size_t row = 0; row < count; row++) {
+                std::memcpy(Get<I>(row), data + row * floats, floats * sizeof(float));
+            }
+        }
+    }
+
+    // A null optional component is missing in every row of the run
+    static std::tuple<ComponentOf<ElementsT>*...> Advance(const std::tuple<ComponentOf<ElementsT>*...> &runFirst, size_t row) {
+        return std::apply([row](auto ...component) {
+            return std::make_tuple((component == nullptr ? nullptr : component + row)...);
+        }, runFirst);
+    }
+
+    template <typename RowT, size_t... I>
+    void PushRow(RowT &&row, std::index_sequence<I...>) {
+        rows[count] = std::make_tuple(ToPointer(std::get<I>(row))...);
+        count++;
+    }
+
+    template <size_t... I>
+    void CopyBackAll(std::index_sequence<I...>) {
+        (CopyBack<I>(), ...);
+    }
+
+  public:
+    size_t size() const {
+        return count;
+    }
+
+    bool full() const {
+        return count == SIZE;
+    }
+
+    template <typename RowT>
+    void Push(RowT &&row) {
+        PushRow(std::forward<RowT>(row), std::index_sequence_for<ElementsT...>());
+    }
+
+    // Pushes a row of a run, the components of the run's rows follow the ones of runFirst in their pools
+    void Push(const std::tuple<ComponentOf<ElementsT>*...> &runFirst, size_t row) {
+        rows[count] = Advance(runFirst, row);
+        count++;
+    }
+
+    // Fills the empty batch with rows [firstRow, firstRow + rowsCount) of a run, the rows are not copied
+    void PushRun(const std::tuple<ComponentOf<ElementsT>*...> &runFirst, size_t firstRow, size_t rowsCount) {
+        first = Advance(runFirst, firstRow);
+        run = true;
+        count = rowsCount;
+    }
+
+    // Component I of the row, null for a missing optional component
+    template <size_t I>
+    auto *Get(size_t row) const {
+        if (run) {
+            auto component = std::get<I>(first);
+            return component == nullptr ? nullptr : component + row;
+        }
+
+        return std::get<I>(rows[row]);
+    }
+
+    // The rows' components of element I are consecutive in their pool, Read and Write return the pool's storage
+    template <size_t I>
+    bool IsPacked() const {
+        auto component = Get<I>(0);
+
+        if (run || component == nullptr) {
+            return component != nullptr;
+        }
+
+        for (size_t row = 1; row < count; row++) {
+            if (std::get<I>(rows[row]) != component + row) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // size() * floats floats, the fields of each row in order
+    template <size_t I>
+    const float *Read() {
+        static_assert(FloatsOf<ElementAt<I>> > 0, "Only float array components can be read as arrays");
+
+        if (!copied[I] && IsPacked<I>()) {
+            return reinterpret_cast<const float*>(Get<I>(0));
+        }
+
+        return Copy<I>();
+    }
+
+    template <size_t I>
+    float *Write() {
+        static_assert(std::is_reference_v<ElementAt<I>> && !std::is_const_v<ComponentOf<ElementAt<I>>>, "Only required components can be written");
+        static_assert(FloatsOf<ElementAt<I>> > 0, "Only float array components can be written as arrays");
+
+        if (!copied[I] && IsPacked<I>()) {
+            return reinterpret_cast<float*>(Get<I>(0));
+        }
+
+        written[I] = true;
+        return Copy<I>();
+    }
+
+    // Copies the written arrays back to the components and empties the batch
+    void Flush() {
+        CopyBackAll(std::index_sequence_for<ElementsT...>());
+        copied.fill(false);
+        written.fill(false);
+        run = false;
+        count = 0;
+    }
+};
+
+}
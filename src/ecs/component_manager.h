@@ -2,540 +2,1138 @@
 
 #include "component_usage_types.h"
 #include "entity.h"
+#include "owned_group.h"
 
 #include "../logging/logging.h"
 
 #include <typeinfo>
 #include <iterator>
 #include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <type_traits>
 
 namespace ECS {
 
+enum class ComponentStorage {
+    // Components sorted by entity id, O(log n) lookup, O(n log n) add/remove
+    SORTED_VECTOR,
+    // Dense rows indexed through a sparse entity table, O(1) add/remove/lookup
+    SPARSE_SET,
+    // No rows, one membership bit per entity id, O(1) add/remove/lookup. Used by empty types.
+    TAG
+};
+
+// A buffered pool keeps a second value per row: systems read the current values and write the next ones, and the
+// written next values become current at the end of the frame
+template <typename ComponentT>
+struct ComponentStorageTraits {
+    static constexpr ComponentStorage storage = std::is_empty_v<ComponentT> ? ComponentStorage::TAG : ComponentStorage::SORTED_VECTOR;
+    static constexpr bool buffered = false;
+};
+
+template <>
+struct ComponentStorageTraits<Entity> {
+    static constexpr ComponentStorage storage = ComponentStorage::SPARSE_SET;
+    static constexpr bool buffered = false;
+};
+
+// Must be used in the global namespace
+#define SparseSetComponent(ComponentT) \
+template <> \
+struct ECS::ComponentStorageTraits<ComponentT> { \
+    static constexpr ECS::ComponentStorage storage = ECS::ComponentStorage::SPARSE_SET; \
+    static constexpr bool buffered = false; \
+}
+
+// Must be used in the global namespace
+#define BufferedSparseSetComponent(ComponentT) \
+template <> \
+struct ECS::ComponentStorageTraits<ComponentT> { \
+    static constexpr ECS::ComponentStorage storage = ECS::ComponentStorage::SPARSE_SET; \
+    static constexpr bool buffered = true; \
+}
+
 class ComponentIteratorStrategyBase {
 
 };
 
+enum class ComponentEvent {
+    ADD,
+    REMOVE,
+    REPLACE
+};
+
+// Selects observers that get the entities of a whole frame at once
+struct Batched {};
+
+// Returned when an observer is added, Unobserve removes the observer it names
+struct ObserverHandle {
+    ID type = 0;
+    ComponentEvent event = ComponentEvent::ADD;
+    bool batched = false;
+    // Unique in the observed pool, 0 for a handle that names no observer
+    uint64_t id = 0;
+
+    bool IsValid() const {
+        return id != 0;
+    }
+};
+
+// Ticks of the system run that last added and changed a component
+struct ChangeTicks {
+    uint64_t added = 0;
+    uint64_t changed = 0;
+};
+
 class ComponentManagerBase {
+  protected:
+    static constexpr uint64_t DEFAULT_CHANGE_TICK = 1;
+    // Stamped on the rows added or changed, owned by the engine's system manager
+    const uint64_t *changeTick = &DEFAULT_CHANGE_TICK;
+
   public:
     virtual ~ComponentManagerBase() {};
+
+    void SetChangeTick(const uint64_t *changeTick) {
+        this->changeTick = changeTick;
+    }
+
     virtual void RemoveComponent(Entity entity) = 0;
+    // entities must be unique
+    virtual void RemoveComponents(const std::vector<Entity> &entities) = 0;
+    // Called at the end of every frame, only buffered pools do anything
+    virtual void SwapBuffers() {}
+    // Hands the entities gathered since the last call to the batched observers
+    virtual void FlushObservers() {}
+    virtual void RemoveObserver(const ObserverHandle &handle) = 0;
 };
 
+// Additions and removals of one component type recorded for later, the payloads are stored contiguously
 template <typename ComponentT>
-class ComponentManager;
-
-template <typename ComponentT>
-class ComponentManagerView {
+class DeferredComponentCommands {
   private:
-    std::vector<Entity> entities;
-    ComponentManager<ComponentT> *componentManager = nullptr;
-    typedef std::tuple<ComponentT*, unsigned int> (ComponentManager<ComponentT>::*GetComponentFnT)(Entity entity, const unsigned int pos);
+    static constexpr unsigned int NO_PAYLOAD = ~0u;
+
+    // (entity, index in payloads), NO_PAYLOAD for a removal
+    std::vector<std::pair<Entity, unsigned int>> commands;
+    std::vector<ComponentT> payloads;
 
   public:
-    ComponentManagerView() {}
+    bool empty() const {
+        return commands.empty();
+    }
 
-    ComponentManagerView(const std::vector<Entity> &entities, ComponentManager<ComponentT> *componentManager) :
-        entities(entities), componentManager(componentManager) {}
+    void Add(Entity entity, const ComponentT &component) {
+        commands.emplace_back(entity, payloads.size());
+        payloads.push_back(ComponentT(component));
+    }
 
-    ~ComponentManagerView() {
-        if (componentManager) {
-            componentManager->SignalViewFinished();
-        }
+    void Remove(Entity entity) {
+        commands.emplace_back(entity, NO_PAYLOAD);
     }
 
-    // ITERATOR
-    class ComponentIterator {
-        friend class ComponentManagerView<ComponentT>;
-      public:
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = ComponentT;
-        using pointer           = ComponentT*;
-        using reference         = ComponentT&;
+    // Only the last command recorded for an entity matters, so an add followed by a remove cancels out. Both
+    // outputs are sorted by entity and the recorded commands are cleared.
+    void Resolve(std::vector<Entity> &removed, std::vector<std::pair<Entity, ComponentT>> &added) {
+        std::stable_sort(commands.begin(), commands.end(), [](const std::pair<Entity, unsigned int> &a, const std::pair<Entity, unsigned int> &b) {
+            return a.first < b.first;
+        });
 
-      private:
-        std::vector<Entity> *entities;
-        unsigned int entityPos;
-        ComponentManager<ComponentT> *componentManager;
-        pointer m_ptr = nullptr;
-        unsigned int componentPos = 0;
-        GetComponentFnT getComponentFn;
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (i + 1 < commands.size() && commands[i + 1].first == commands[i].first) {
+                continue;
+            }
 
-      public:
-        ComponentIterator& operator=(const ComponentIterator& other) {
-            entities = other.entities;
-            entityPos = other.entityPos;
-            componentManager = other.componentManager;
-            m_ptr = other.m_ptr;
-            componentPos = other.componentPos;
-            getComponentFn = other.getComponentFn;
-            return *this;
+            if (commands[i].second == NO_PAYLOAD) {
+                removed.push_back(commands[i].first);
+            } else {
+                added.emplace_back(commands[i].first, std::move(payloads[commands[i].second]));
+            }
         }
 
-        ComponentIterator() {}
+        commands.clear();
+        payloads.clear();
+    }
+};
+
+template <typename ComponentT>
+class ComponentManager : public ComponentManagerBase {
+    template <typename... T>
+    friend class OwnedGroup;
+  private:
+    static constexpr unsigned int INVALID_POS = ~0u;
+
+    // Row i holds the component of entities[i]. The components are kept apart from the entities, so the pool's
+    // components are one packed array that kernels can work on in place, see ComponentBatch.
+    std::vector<Entity> entities;
+    std::vector<ComponentT> components;
+    // Only used by buffered pools, in the same order as the components: the next values and whether each one was
+    // written this frame. A next value starts as a copy of the current one when it is first written.
+    std::vector<ComponentT> nextComponents;
+    std::vector<uint8_t> nextWritten;
+    // Entity id -> row, only used by SPARSE_SET storage
+    std::vector<unsigned int> sparse;
+    // Changes made while a view is alive
+    DeferredComponentCommands<ComponentT> deferred;
+    unsigned int ownViewsInUse = 0;
+    // Points to the counter of the owning group while the pool is owned
+    unsigned int *viewsInUse = &ownViewsInUse;
+    OwnedGroupBase *group = nullptr;
+    // Incremented whenever rows are added or removed, i.e. whenever component pointers may have moved
+    uint64_t version = 0;
+
+    // Indexed by entity id, so the ticks do not move with the rows
+    std::vector<ChangeTicks> ticks;
+
+    // Only used by TAG storage: the membership bits and the generation of the tagged entity, by entity id
+    std::vector<uint64_t> tagBits;
+    std::vector<uint32_t> tagGenerations;
+    size_t tagsCount = 0;
+    // Sorted tagged entities for joins walking the tag, rebuilt from the bits after they changed
+    mutable std::vector<Entity> tagged;
+    mutable bool taggedDirty = false;
+    // Lists replaced while other views may still walk them, freed when the last view finishes
+    mutable std::vector<std::vector<Entity>> retiredTagged;
 
-        ComponentIterator(std::vector<Entity> *entities, ComponentManager<ComponentT> *componentManager, GetComponentFnT getComponentFn) :
-            componentManager(componentManager), getComponentFn(getComponentFn) {
-            this->entities = (entities);
-            entityPos = 0;
+  public:
+    typedef std::function<void(Entity, ComponentT&)> ObserverFnT;
+    typedef std::function<void(const std::vector<Entity>&)> BatchObserverFnT;
 
-            if (entities->size() == 0) {
-                return;
-            }
+  private:
+    static constexpr size_t EVENTS = 3;
 
-            unsigned int newPos;
-            std::tie(m_ptr, newPos) = (componentManager->*getComponentFn)((*entities)[entityPos], 0);
+    // Indexed by ComponentEvent, each observer is kept with its id
+    std::array<std::vector<std::pair<uint64_t, ObserverFnT>>, EVENTS> observers;
+    std::array<std::vector<std::pair<uint64_t, BatchObserverFnT>>, EVENTS> batchObservers;
+    uint64_t lastObserverId = 0;
+    std::array<std::vector<Entity>, EVENTS> batches;
+    std::vector<Entity> flushing;
 
-            if (m_ptr == nullptr) {
-                componentPos--;
-            } else {
-                componentPos = newPos;
-            }
+    bool IsObserved(ComponentEvent event) const {
+        return !observers[(size_t) event].empty() || !batchObservers[(size_t) event].empty();
+    }
+
+    // Changes the observers make to this type are deferred, the caller commits them once the change is done
+    void Notify(ComponentEvent event, Entity entity, ComponentT &component) {
+        if (!batchObservers[(size_t) event].empty()) {
+            batches[(size_t) event].push_back(entity);
         }
 
-        ComponentIterator(const ComponentIterator &other) {
-            entities = other.entities;
-            entityPos = other.entityPos;
-            componentManager = other.componentManager;
-            m_ptr = other.m_ptr;
-            componentPos = other.componentPos;
-            getComponentFn = other.getComponentFn;
+        (*viewsInUse)++;
+
+        for (auto &observer : observers[(size_t) event]) {
+            observer.second(entity, component);
         }
 
-        reference operator*() const {
-            return *m_ptr;
+        (*viewsInUse)--;
+    }
+
+    // Every tagged entity gets the same instance, empty types have no state
+    static ComponentT *GetTagInstance() {
+        static ComponentT instance;
+        return &instance;
+    }
+
+    bool HasTag(const Entity entity) const {
+        auto id = entity.GetId();
+        return id < tagGenerations.size() && (tagBits[id / 64] >> (id % 64) & 1) && tagGenerations[id] == entity.GetGeneration();
+    }
+
+    // Returns true when the membership of the entity changed
+    bool SetTag(const Entity entity, bool value) {
+        if (HasTag(entity) == value) {
+            return false;
         }
 
+        auto id = entity.GetId();
 
-        reference get() const {
-            return *m_ptr;
+        if (id >= tagGenerations.size()) {
+            tagGenerations.resize(std::max<size_t>(id + 1, tagGenerations.size() * 2));
+            tagBits.resize(tagGenerations.size() / 64 + 1);
         }
 
-        pointer operator->() const {
-            return m_ptr;
+        uint64_t bit = uint64_t(1) << (id % 64);
+
+        if (value) {
+            // A bit left by an older generation is taken over
+            tagsCount += (tagBits[id / 64] & bit) == 0;
+            tagBits[id / 64] |= bit;
+            tagGenerations[id] = entity.GetGeneration();
+        } else {
+            tagsCount--;
+            tagBits[id / 64] &= ~bit;
         }
 
-        // Prefix increment
-        ComponentIterator &operator++() {
-            entityPos++;
-            componentPos++;
+        taggedDirty = true;
+        version++;
+        return true;
+    }
 
-            //printf("\n%d\n", entityPos);
-            if (entityPos >= entities->size()) {
-                m_ptr = nullptr;
-                return *this;
+    template <typename FnT>
+    void ForEachTagged(FnT fn) const {
+        for (size_t word = 0; word < tagBits.size(); word++) {
+            for (uint64_t bits = tagBits[word]; bits != 0; bits &= bits - 1) {
+                ID id = word * 64 + __builtin_ctzll(bits);
+                fn(Entity(id, tagGenerations[id]));
             }
+        }
+    }
 
-            unsigned int newPos;
-            std::tie(m_ptr, newPos) = (componentManager->*getComponentFn)((*entities)[entityPos], componentPos);
+    void Stamp(const Entity entity, bool added) {
+        if (entity.GetId() >= ticks.size()) {
+            ticks.resize(entity.GetId() + 1);
+        }
 
-            if (m_ptr == nullptr) {
-                componentPos--;
-            } else {
-                componentPos = newPos;
-            }
+        auto &entityTicks = ticks[entity.GetId()];
 
-            return *this;
+        if (added) {
+            entityTicks.added = *changeTick;
         }
 
-        // Postfix increment
-        ComponentIterator operator++(int) {
-            ComponentIterator tmp = *this;
-            ++(*this);
-            return tmp;
+        entityTicks.changed = *changeTick;
+    }
+
+    void Commit() {
+        if (deferred.empty()) {
+            return;
         }
 
-        friend bool operator==(const ComponentIterator& a, const ComponentIterator& b) {
-            return a.m_ptr == b.m_ptr;
-        };
+        std::vector<Entity> removed;
+        std::vector<std::pair<Entity, ComponentT>> added;
+        deferred.Resolve(removed, added);
 
-        friend bool operator!=(const ComponentIterator& a, const ComponentIterator& b) {
-            return a.m_ptr != b.m_ptr;
-        };
+        if (!removed.empty()) {
+            RemoveComponents(removed);
+        }
 
-        bool finished() {
-            return entityPos >= entities->size();
+        if (!added.empty()) {
+            AddComponents(std::move(added));
         }
-    };
+    }
 
-    ComponentIterator begin() {
-        if (entities.size() < componentManager->size() / 30) {
-            return ComponentIterator(&entities, componentManager, &ComponentManager<ComponentT>::GetComponentBinarySearch);
+    // The pools of an owned group commit together, a change deferred in one of them may be waiting on another
+    void CommitAll() {
+        if (group) {
+            group->Commit();
         } else {
-            return ComponentIterator(&entities, componentManager, &ComponentManager<ComponentT>::GetComponentLinearSearch);
+            Commit();
         }
     }
 
-    ComponentIterator end() {
-        if (entities.size() == 0) {
-            return begin();
+    unsigned int GetSparsePos(const Entity entity) const {
+        auto id = entity.GetId();
+
+        if (id >= sparse.size() || sparse[id] == INVALID_POS || entities[sparse[id]] != entity) {
+            return INVALID_POS;
         }
 
-        ComponentIterator it;
+        return sparse[id];
+    }
 
-        if (entities.size() < componentManager->size() / 30) {
-            it = ComponentIterator(&entities, componentManager, &ComponentManager<ComponentT>::GetComponentBinarySearch);
-        } else {
-            it = ComponentIterator(&entities, componentManager, &ComponentManager<ComponentT>::GetComponentLinearSearch);
+    void SetSparsePos(const Entity entity, const unsigned int pos) {
+        auto id = entity.GetId();
+
+        if (id >= sparse.size()) {
+            sparse.resize(std::max<size_t>(id + 1, sparse.size() * 2), INVALID_POS);
         }
 
-        it.entityPos = it.entities->size() - 1;
-        it++;
-        it.componentPos = it.componentManager->size();
-        return it;
+        sparse[id] = pos;
     }
-};
 
+    // Only used by owned groups on SPARSE_SET pools
+    void SwapRows(const unsigned int a, const unsigned int b) {
+        if (a == b) {
+            return;
+        }
 
-template <typename ComponentT>
-class ComponentManager : public ComponentManagerBase {
-    friend class BaseComponentGroupView;
-  private:
-    struct Operation {
-        virtual ~Operation() {}
-        virtual void Process() = 0;
-    };
+        std::swap(entities[a], entities[b]);
+        std::swap(components[a], components[b]);
 
-    struct AddOperation : public Operation {
-      private:
-        ComponentManager<ComponentT> *componentManager;
-        Entity entity;
-        ComponentT component;
+        if constexpr (IsBuffered()) {
+            std::swap(nextComponents[a], nextComponents[b]);
+            std::swap(nextWritten[a], nextWritten[b]);
+        }
 
-      public:
-        AddOperation(ComponentManager<ComponentT> *componentManager, Entity entity, const ComponentT &component) :
-            componentManager(componentManager), entity(entity), component(component) {}
+        SetSparsePos(entities[a], a);
+        SetSparsePos(entities[b], b);
+        version++;
+    }
+
+    void SetOwningGroup(OwnedGroupBase *group) {
+        this->group = group;
+        viewsInUse = group->GetViewsInUse();
+    }
 
-        virtual void Process() override {
-            componentManager->AddComponent(entity, component);
+    // The row helpers keep the next values of buffered pools in the same order as the components
+    void InsertRow(unsigned int row, const Entity entity, ComponentT component) {
+        if constexpr (IsBuffered()) {
+            nextComponents.insert(nextComponents.begin() + row, component);
+            nextWritten.insert(nextWritten.begin() + row, 0);
         }
-    };
 
-    struct RemoveOperation : public Operation {
-      private:
-        ComponentManager<ComponentT> *componentManager;
-        Entity entity;
+        entities.insert(entities.begin() + row, entity);
+        components.insert(components.begin() + row, std::move(component));
+    }
 
-      public:
-        RemoveOperation(ComponentManager<ComponentT> *componentManager, Entity entity) :
-            componentManager(componentManager), entity(entity) {}
+    void AppendRow(const Entity entity, ComponentT component) {
+        InsertRow(entities.size(), entity, std::move(component));
+    }
 
-        virtual void Process() override {
-            componentManager->RemoveComponent(entity);
+    void MoveRow(unsigned int from, unsigned int to) {
+        if constexpr (IsBuffered()) {
+            nextComponents[to] = std::move(nextComponents[from]);
+            nextWritten[to] = nextWritten[from];
         }
-    };
 
-  private:
-    std::vector<std::pair<Entity, ComponentT>> components;
-    std::vector<std::unique_ptr<Operation>> uncommitedOperations;
-    unsigned int viewsInUse = 0;
-    const bool optimization = true;
+        entities[to] = entities[from];
+        components[to] = std::move(components[from]);
+    }
 
-    void Commit() {
-        if (uncommitedOperations.empty()) {
-            return;
+    void EraseRows(unsigned int first, unsigned int last) {
+        if constexpr (IsBuffered()) {
+            nextComponents.erase(nextComponents.begin() + first, nextComponents.begin() + last);
+            nextWritten.erase(nextWritten.begin() + first, nextWritten.begin() + last);
         }
 
-        for (auto &operation : uncommitedOperations) {
-            operation->Process();
-        }
+        entities.erase(entities.begin() + first, entities.begin() + last);
+        components.erase(components.begin() + first, components.begin() + last);
+    }
 
-        uncommitedOperations.clear();
-        Optimize();
+    // Row of the entity in SORTED_VECTOR storage, searching [first, last)
+    unsigned int SearchRow(const Entity entity, unsigned int first, unsigned int last) const {
+        auto it = std::lower_bound(entities.begin() + first, entities.begin() + last, entity);
+        return it == entities.begin() + last || *it != entity ? INVALID_POS : it - entities.begin();
     }
 
-    void Optimize() {
-        if (!optimization) {
-            return;
+    unsigned int FindRow(const Entity entity) const {
+        return IsSparseSet() ? GetSparsePos(entity) : SearchRow(entity, 0, entities.size());
+    }
+
+    // Merges the rows appended after the first sortedSize rows into the sorted rows
+    void MergeAppended(size_t sortedSize) {
+        std::vector<unsigned int> appended(entities.size() - sortedSize);
+
+        for (size_t i = 0; i < appended.size(); i++) {
+            appended[i] = sortedSize + i;
         }
 
-        std::sort(components.begin(), components.end(),
-        [](const std::pair<Entity, ComponentT> &c1, const std::pair<Entity, ComponentT> &c2) {
-            return c1.first < c2.first;
+        std::sort(appended.begin(), appended.end(), [this](unsigned int a, unsigned int b) {
+            return entities[a] < entities[b];
         });
 
+        std::vector<Entity> mergedEntities;
+        std::vector<ComponentT> mergedComponents;
+        std::vector<ComponentT> mergedNextComponents;
+        std::vector<uint8_t> mergedNextWritten;
+        mergedEntities.reserve(entities.size());
+        mergedComponents.reserve(entities.size());
+
+        auto next = appended.begin();
+
+        for (size_t row = 0; row < sortedSize || next != appended.end();) {
+            size_t taken = next == appended.end() || (row < sortedSize && entities[row] < entities[*next]) ? row++ : *next++;
+            mergedEntities.push_back(entities[taken]);
+            mergedComponents.push_back(std::move(components[taken]));
+
+            if constexpr (IsBuffered()) {
+                mergedNextComponents.push_back(std::move(nextComponents[taken]));
+                mergedNextWritten.push_back(nextWritten[taken]);
+            }
+        }
+
+        std::swap(entities, mergedEntities);
+        std::swap(components, mergedComponents);
+        std::swap(nextComponents, mergedNextComponents);
+        std::swap(nextWritten, mergedNextWritten);
+    }
+
+    void Shrink() {
         if (components.size() >= components.capacity() / 2) {
             return;
         }
 
+        entities.shrink_to_fit();
         components.shrink_to_fit();
+        nextComponents.shrink_to_fit();
+        nextWritten.shrink_to_fit();
     }
 
-  protected:
-    ComponentManagerView<ComponentT> *GetViewInternal(std::vector<Entity> &entities) {
-        viewsInUse++;
-        auto p = new ComponentManagerView<ComponentT>(entities, this);
-        return p;
+  public:
+    void SignalViewStarted() {
+        (*viewsInUse)++;
     }
 
-  public:
     void SignalViewFinished() {
-        viewsInUse--;
+        (*viewsInUse)--;
 
-        if (viewsInUse == 0) {
-            Commit();
+        if (*viewsInUse == 0) {
+            retiredTagged.clear();
+            CommitAll();
         }
     }
 
+    static constexpr bool IsSparseSet() {
+        return ComponentStorageTraits<ComponentT>::storage == ComponentStorage::SPARSE_SET;
+    }
+
+    static constexpr bool IsTag() {
+        return ComponentStorageTraits<ComponentT>::storage == ComponentStorage::TAG;
+    }
+
+    static constexpr bool IsBuffered() {
+        return ComponentStorageTraits<ComponentT>::buffered;
+    }
+
+    bool IsInUse() const {
+        return *viewsInUse > 0;
+    }
+
+    // The group whose entities are packed at the front of the pool, if any
+    OwnedGroupBase *GetOwningGroup() const {
+        return group;
+    }
+
     size_t size() {
-        return components.size();
+        return IsTag() ? tagsCount : components.size();
     }
 
-    ComponentManagerView<ComponentT> GetView(std::vector<Entity> &entities) {
-        viewsInUse++;
-        return ComponentManagerView<ComponentT>(entities, this);
+    // Pointers returned by GetComponent stay valid while the version does not change. Tags change it whenever
+    // an entity is tagged or untagged.
+    uint64_t GetVersion() const {
+        return version;
     }
 
     void AddComponent(const Entity entity, const ComponentT &component) {
-        if (viewsInUse) {
-            uncommitedOperations.emplace_back(std::make_unique<AddOperation>(this, entity, component));
+        // Nothing moves when a bit is flipped, so tags are not deferred while a view is alive
+        if constexpr (IsTag()) {
+            bool added = SetTag(entity, true);
+            Stamp(entity, added);
+            auto event = added ? ComponentEvent::ADD : ComponentEvent::REPLACE;
+
+            if (IsObserved(event)) {
+                Notify(event, entity, *GetTagInstance());
+            }
+
             return;
         }
 
-        components.push_back(std::make_pair(entity, ComponentT(component)));
-        Optimize();
-    }
+        auto row = FindRow(entity);
+        Stamp(entity, row == INVALID_POS);
 
-    auto find(const Entity entity, unsigned int pos = 0) {
-        auto it = std::lower_bound(components.begin() + pos, components.end(), entity,
-        [](const std::pair<Entity, ComponentT> &elem, const Entity & key) {
-            return elem.first < key;
-        });
+        if (*viewsInUse) {
+            deferred.Add(entity, component);
+            return;
+        }
+
+        if (row != INVALID_POS) {
+            components[row] = ComponentT(component);
+            DiscardNext(row);
+
+            if (IsObserved(ComponentEvent::REPLACE)) {
+                Notify(ComponentEvent::REPLACE, entity, components[row]);
+                CommitAll();
+            }
+
+            return;
+        }
+
+        if (IsSparseSet()) {
+            SetSparsePos(entity, entities.size());
+            AppendRow(entity, component);
+        } else {
+            row = std::lower_bound(entities.begin(), entities.end(), entity) - entities.begin();
+            InsertRow(row, entity, component);
+        }
+
+        version++;
 
-        if (it == components.end() || it->first != entity) {
-            return components.end();
+        if (group) {
+            group->OnAdded(entity);
         }
 
-        return it;
+        if (IsObserved(ComponentEvent::ADD)) {
+            Notify(ComponentEvent::ADD, entity, components[FindRow(entity)]);
+            CommitAll();
+        }
     }
 
     virtual void RemoveComponent(Entity entity) override {
-        if (viewsInUse) {
-            uncommitedOperations.emplace_back(std::make_unique<RemoveOperation>(this, entity));
+        if constexpr (IsTag()) {
+            if (HasTag(entity) && IsObserved(ComponentEvent::REMOVE)) {
+                Notify(ComponentEvent::REMOVE, entity, *GetTagInstance());
+            }
+
+            SetTag(entity, false);
             return;
         }
 
-        auto it = find(entity);
+        if (*viewsInUse) {
+            deferred.Remove(entity);
+            return;
+        }
+
+        auto row = FindRow(entity);
 
-        if (it == components.end()) {
+        if (row == INVALID_POS) {
             return;
         }
 
-        int pos = it - components.begin();
-        int last = components.size() - 1;
+        // Observers see the component before it is removed
+        bool observed = IsObserved(ComponentEvent::REMOVE);
 
-        std::swap(components[pos], components[last]);
-        components.pop_back();
+        if (observed) {
+            Notify(ComponentEvent::REMOVE, entity, components[row]);
+        }
 
-        Optimize();
-    }
+        // Leaving the group swaps the row out of the prefix first, the last row is then moved into its place
+        if (group) {
+            group->OnRemoving(entity);
+            row = FindRow(entity);
+        }
 
-    ComponentT *GetComponent(int pos) {
-        if (pos >= components.size()) {
-            return nullptr;
+        if (IsSparseSet()) {
+            unsigned int last = entities.size() - 1;
+            MoveRow(last, row);
+            SetSparsePos(entities[row], row);
+            SetSparsePos(entity, INVALID_POS);
+            EraseRows(last, last + 1);
+        } else {
+            EraseRows(row, row + 1);
         }
 
-        return &(components[pos].second);
+        version++;
+        Shrink();
+
+        if (observed) {
+            CommitAll();
+        }
     }
 
-    ComponentT *GetComponent(Entity entity) {
-        auto it = find(entity, 0);
+    // Adds or overwrites all rows, new rows are appended and merged into the sorted rows once.
+    // The entities must be unique.
+    void AddComponents(std::vector<std::pair<Entity, ComponentT>> rows) {
+        if (*viewsInUse || IsTag()) {
+            for (auto &row : rows) {
+                AddComponent(row.first, row.second);
+            }
 
-        if (it == components.end()) {
-            return nullptr;
+            return;
+        }
+
+        size_t sortedSize = entities.size();
+        std::vector<std::pair<Entity, ComponentEvent>> notifications;
+
+        for (auto &row : rows) {
+            auto existing = IsSparseSet() ? GetSparsePos(row.first) : SearchRow(row.first, 0, sortedSize);
+            Stamp(row.first, existing == INVALID_POS);
+            auto event = existing == INVALID_POS ? ComponentEvent::ADD : ComponentEvent::REPLACE;
+
+            if (IsObserved(event)) {
+                notifications.push_back({row.first, event});
+            }
+
+            if (existing != INVALID_POS) {
+                components[existing] = std::move(row.second);
+                DiscardNext(existing);
+                continue;
+            }
+
+            if (IsSparseSet()) {
+                SetSparsePos(row.first, entities.size());
+            }
+
+            AppendRow(row.first, std::move(row.second));
+        }
+
+        if (entities.size() != sortedSize) {
+            version++;
+        }
+
+        if (!IsSparseSet()) {
+            MergeAppended(sortedSize);
+        } else if (group && entities.size() != sortedSize) {
+            // The appended entities are copied first, joining the group swaps them out of the appended rows
+            std::vector<Entity> added(entities.begin() + sortedSize, entities.end());
+
+            for (auto entity : added) {
+                group->OnAdded(entity);
+            }
+        }
+
+        // Notified once all the rows are in place
+        for (auto [entity, event] : notifications) {
+            Notify(event, entity, components[FindRow(entity)]);
         }
 
-        return &(it->second);
+        if (!notifications.empty()) {
+            CommitAll();
+        }
     }
 
-    std::tuple<ComponentT*, unsigned int> GetComponent(Entity entity, const unsigned int pos) {
-        auto it = find(entity, pos);
+    void AddComponents(const std::vector<Entity> &entities, const ComponentT &component) {
+        std::vector<std::pair<Entity, ComponentT>> rows;
+        rows.reserve(entities.size());
 
-        if (it == components.end()) {
-            return std::make_tuple(nullptr, components.size());
+        for (auto entity : entities) {
+            rows.emplace_back(entity, ComponentT(component));
         }
 
-        return std::make_tuple(&(it->second), it - components.begin());
+        AddComponents(std::move(rows));
     }
 
-    std::tuple<ComponentT*, unsigned int> GetComponentBinarySearch(Entity entity, const unsigned int pos) {
-        auto it = find(entity, pos);
+    // Removes all the rows in one pass over the pool instead of one search and sort per entity
+    virtual void RemoveComponents(const std::vector<Entity> &removed) override {
+        if (*viewsInUse || IsSparseSet() || IsTag()) {
+            for (auto entity : removed) {
+                RemoveComponent(entity);
+            }
+
+            return;
+        }
+
+        // Owned pools are sparse sets, the group never sees this path
+        assert(!group);
+
+        auto sorted = removed;
+        std::sort(sorted.begin(), sorted.end());
+        bool observed = IsObserved(ComponentEvent::REMOVE);
+
+        if (observed) {
+            for (auto entity : sorted) {
+                auto row = FindRow(entity);
 
-        if (it == components.end()) {
-            return std::make_tuple(nullptr, components.size());
+                if (row != INVALID_POS) {
+                    Notify(ComponentEvent::REMOVE, entity, components[row]);
+                }
+            }
         }
 
-        return std::make_tuple(&(it->second), it - components.begin());
+        size_t next = 0;
+        size_t write = 0;
+
+        for (size_t read = 0; read < entities.size(); read++) {
+            while (next < sorted.size() && sorted[next] < entities[read]) {
+                next++;
+            }
+
+            if (next < sorted.size() && sorted[next] == entities[read]) {
+                continue;
+            }
+
+            if (write != read) {
+                MoveRow(read, write);
+            }
+
+            write++;
+        }
+
+        if (write != entities.size()) {
+            version++;
+        }
+
+        EraseRows(write, entities.size());
+        Shrink();
+
+        if (observed) {
+            CommitAll();
+        }
+    }
+
+    // Returns the id of the observer
+    uint64_t AddObserver(ComponentEvent event, ObserverFnT fn) {
+        observers[(size_t) event].emplace_back(++lastObserverId, fn);
+        return lastObserverId;
     }
 
-    std::tuple<ComponentT*, unsigned int> GetComponentLinearSearch(Entity entity, const unsigned int pos) {
-        auto it = components.begin();
+    uint64_t AddBatchObserver(ComponentEvent event, BatchObserverFnT fn) {
+        batchObservers[(size_t) event].emplace_back(++lastObserverId, fn);
+        return lastObserverId;
+    }
 
-        if (it == components.end() || pos > components.size()) {
-            return std::make_tuple(nullptr, components.size());
+    virtual void RemoveObserver(const ObserverHandle &handle) override {
+        auto remove = [&handle](auto &list) {
+            list.erase(std::remove_if(list.begin(), list.end(), [&handle](const auto &observer) {
+                return observer.first == handle.id;
+            }), list.end());
+        };
+
+        if (handle.batched) {
+            remove(batchObservers[(size_t) handle.event]);
+        } else {
+            remove(observers[(size_t) handle.event]);
         }
+    }
 
-        it += pos;
+    virtual void FlushObservers() override {
+        for (size_t event = 0; event < EVENTS; event++) {
+            if (batches[event].empty()) {
+                continue;
+            }
+
+            std::swap(batches[event], flushing);
 
-        while (it != components.end() && it->first != entity) {
-            it++;
+            for (auto &observer : batchObservers[event]) {
+                observer.second(flushing);
+            }
+
+            flushing.clear();
+        }
+    }
+
+    // The written next values become current, the rows stay where they are so pointers to them stay valid
+    virtual void SwapBuffers() override {
+        if constexpr (IsBuffered()) {
+            for (size_t row = 0; row < nextWritten.size(); row++) {
+                if (nextWritten[row]) {
+                    std::swap(components[row], nextComponents[row]);
+                    nextWritten[row] = 0;
+                }
+            }
         }
+    }
+
+    // Next values of count rows from row on, a row's first write copies its current value. Other pools return
+    // the current values, they are written in place.
+    ComponentT *GetNextRows(unsigned int row, unsigned int count) {
+        if constexpr (IsBuffered()) {
+            for (unsigned int i = row; i < row + count; i++) {
+                if (!nextWritten[i]) {
+                    nextComponents[i] = components[i];
+                    nextWritten[i] = 1;
+                }
+            }
 
-        if (it == components.end()) {
-            return std::make_tuple(nullptr, 0);
+            return &nextComponents[row];
         }
 
-        return std::make_tuple(&(it->second), it - components.begin());
+        return &components[row];
     }
 
-    const std::vector<std::pair<Entity, ComponentT>> *GetComponentEntityVector() {
-        return &components;
+    // Rows handed out for writing by the views, their changed tick is stamped
+    ComponentT *GetWrittenRows(unsigned int row, unsigned int count) {
+        for (unsigned int i = row; i < row + count; i++) {
+            ticks[entities[i].GetId()].changed = *changeTick;
+        }
+
+        return GetNextRows(row, count);
     }
-};
 
-class BaseComponentGroupView {
-  public:
-    template <typename T>
-    ComponentManagerView<T> *GetViewInternal(ComponentManager<T>* cm, std::vector<Entity> &entities) {
-        return cm->GetViewInternal(entities);
+    // Row of a component returned by GetComponent or SeekComponent
+    unsigned int GetRow(const ComponentT *component) const {
+        return component - components.data();
     }
-};
 
-template <typename... T>
-class ComponentGroupView : public BaseComponentGroupView {
-};
+    // The written next value is dropped, the current one is kept at the end of the frame
+    void DiscardNext(unsigned int row) {
+        if constexpr (IsBuffered()) {
+            nextWritten[row] = 0;
+        }
+    }
 
-template <typename... T>
-class ComponentGroupView<std::tuple<T...>> : public BaseComponentGroupView {
-  private:
-    std::tuple<ComponentManagerView<T>*...> views;
+    ComponentT *GetComponent(int pos) {
+        if (pos >= components.size()) {
+            return nullptr;
+        }
 
-  public:
-    ~ComponentGroupView() {
-        std::apply([](auto const & ...x) {
-            (delete x, ...);
-        }, views);
+        return &components[pos];
     }
 
-    ComponentGroupView(int) {}
+    // Taking the pointer marks the component as changed
+    ComponentT *GetComponent(Entity entity) {
+        if constexpr (IsTag()) {
+            if (!HasTag(entity)) {
+                return nullptr;
+            }
+
+            ticks[entity.GetId()].changed = *changeTick;
+            return GetTagInstance();
+        }
+
+        auto row = FindRow(entity);
 
-    ComponentGroupView(ComponentManagerView<T>*... views) {
-        this->views = std::make_tuple(views...);
+        if (row == INVALID_POS) {
+            return nullptr;
+        }
+
+        // A buffered pool is only written through its next values, a write to the current one would be lost at the swap
+        ticks[entity.GetId()].changed = *changeTick;
+        return GetNextRows(row, 1);
     }
 
-    ComponentGroupView(std::vector<Entity> entities, ComponentManager<T>*... componentManagers) {
-        this->views = std::make_tuple(GetViewInternal(componentManagers, entities)...);
+    // Reading the current value is not a change
+    const ComponentT *FindComponent(Entity entity) const {
+        if constexpr (IsTag()) {
+            return HasTag(entity) ? GetTagInstance() : nullptr;
+        }
+
+        auto row = FindRow(entity);
+        return row == INVALID_POS ? nullptr : &components[row];
     }
 
-    const auto GetViews() {
-        return views;
+    // Same as GetComponent, named for the call sites that write the next value of a buffered pool
+    ComponentT *GetNextComponent(Entity entity) {
+        return GetComponent(entity);
     }
 
-    // ITERATOR
-    class ComponentGroupIterator {
-        //friend class ComponentGroupView<T...>;
-      public:
-        using iterator_category = std::forward_iterator_tag;
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = std::tuple<T...>;
-        using pointer           = std::tuple<T*...>;
-        using reference         = std::tuple<T&...>;
+    // The next value if it was written this frame, otherwise the current one
+    const ComponentT *GetLatestComponent(Entity entity) const {
+        if constexpr (IsTag()) {
+            return HasTag(entity) ? GetTagInstance() : nullptr;
+        }
 
-      private:
-        std::tuple<typename ComponentManagerView<T>::ComponentIterator...> tupleIter;
-      public:
-        ComponentGroupIterator(typename ComponentManagerView<T>::ComponentIterator... it) {
-            tupleIter = std::make_tuple(it...);
+        auto row = FindRow(entity);
+
+        if (row == INVALID_POS) {
+            return nullptr;
         }
 
-        ComponentGroupIterator(const ComponentGroupIterator &other) {
-            tupleIter = other.tupleIter;
+        if constexpr (IsBuffered()) {
+            if (nextWritten[row]) {
+                return &nextComponents[row];
+            }
         }
 
-        reference operator*() const {
-            return std::apply([](auto const & ...x) {
-                return std::tie((x.get())...);
-            }, tupleIter);
-            ;
+        return &components[row];
+    }
+
+    // True if the entity has the component and it was changed, or added, after tick
+    bool IsChangedSince(Entity entity, uint64_t tick, bool added) const {
+        if (FindComponent(entity) == nullptr) {
+            return false;
+        }
+
+        auto &entityTicks = ticks[entity.GetId()];
+        return (added ? entityTicks.added : entityTicks.changed) > tick;
+    }
+
+    // Sorted entities whose component was changed, or added, after tick
+    void CollectChanged(uint64_t tick, bool added, std::vector<Entity> &result) const {
+        result.clear();
+
+        if (IsTag()) {
+            ForEachTagged([this, tick, added, &result](Entity entity) {
+                auto &entityTicks = ticks[entity.GetId()];
+
+                if ((added ? entityTicks.added : entityTicks.changed) > tick) {
+                    result.push_back(entity);
+                }
+            });
+
+            return;
         }
 
-        pointer operator->() const {
-            return
-            std::apply([](auto const & ...x) {
-                return std::make_tuple(x.operator->()...);
-            }, tupleIter);
+        for (auto entity : entities) {
+            auto &entityTicks = ticks[entity.GetId()];
+
+            if ((added ? entityTicks.added : entityTicks.changed) > tick) {
+                result.push_back(entity);
+            }
         }
 
-        // Prefix increment
-        ComponentGroupIterator &operator++() {
-            tupleIter = std::apply([](auto ...x) {
-                return std::make_tuple(++x...);
-            }, tupleIter);
-            return *this;
+        if (IsSparseSet()) {
+            std::sort(result.begin(), result.end());
         }
+    }
 
-        // Postfix increment
-        ComponentGroupIterator operator++(int) {
-            ComponentGroupIterator tmp = *this;
-            ++(*this);
-            return tmp;
+    // pos is a cursor left after the last component found. Entities looked up in ascending order are found
+    // by galloping forward from it, so a whole join costs amortised linear time. Looking up an entity before
+    // the cursor searches [0, pos).
+    ComponentT *SeekComponent(const Entity entity, unsigned int &pos) {
+        if constexpr (IsTag()) {
+            return HasTag(entity) ? GetTagInstance() : nullptr;
         }
 
-        friend bool operator==(const ComponentGroupIterator& a, const ComponentGroupIterator& b) {
-            return (a.tupleIter == b.tupleIter);
-        };
+        if (IsSparseSet()) {
+            auto sparsePos = GetSparsePos(entity);
+            return sparsePos == INVALID_POS ? nullptr : &components[sparsePos];
+        }
 
-        friend bool operator!=(const ComponentGroupIterator& a, const ComponentGroupIterator& b) {
-            return (a.tupleIter != b.tupleIter);
-        };
-    };
+        unsigned int size = entities.size();
+
+        if (pos < size && entities[pos] == entity) {
+            return &components[pos++];
+        }
+
+        unsigned int lo = 0;
+        unsigned int hi = std::min(pos, size);
+
+        if (hi == 0 || entities[hi - 1] < entity) {
+            lo = hi;
 
-    ComponentGroupIterator begin() {
-        return std::make_from_tuple<ComponentGroupIterator>(std::apply([](auto ...x) {
-            return std::make_tuple(x->begin()...);
-        }, views));
+            for (unsigned int step = 1; hi < size && entities[hi] < entity; step *= 2) {
+                lo = hi + 1;
+                hi += step;
+            }
+
+            hi = std::min(hi, size);
+        }
+
+        pos = std::lower_bound(entities.begin() + lo, entities.begin() + hi, entity) - entities.begin();
+
+        if (pos < size && entities[pos] == entity) {
+            return &components[pos++];
+        }
+
+        return nullptr;
+    }
+
+    // Entities of the rows, in row order. Tags build the list from the bits.
+    const Entity *GetEntityData() const {
+        if (IsTag()) {
+            if (taggedDirty) {
+                // The calling view is counted, any other view may still walk the old list
+                if (*viewsInUse > 1) {
+                    retiredTagged.push_back(std::move(tagged));
+                }
+
+                tagged.clear();
+
+                ForEachTagged([this](Entity entity) {
+                    tagged.push_back(entity);
+                });
+
+                taggedDirty = false;
+            }
+
+            return tagged.data();
+        }
+
+        return entities.data();
     }
 
-    ComponentGroupIterator end() {
-        return std::make_from_tuple<ComponentGroupIterator>(std::apply([](auto ...x) {
-            return std::make_tuple(x->end()...);
-        }, views));
+    // Tags have no rows
+    const std::vector<Entity> *GetEntityVector() const {
+        return &entities;
     }
+
+    // Components in the same order as GetEntityVector
+    const std::vector<ComponentT> *GetComponentVector() const {
+        return &components;
+    }
+};
+
+// Pool of a view element, const elements are read from the pool of the component type
+template <typename T>
+using ComponentManagerOf = ComponentManager<std::remove_const_t<T>>;
+
+// Sorted intersection of component pools. Walks the entity list if one is given, otherwise the smallest
+// required pool, and finds the entity in the other pools with SeekComponent in the same pass. When all the
+// pools of an owned group are required, only the group's prefix is walked and the owned pools are read by row.
+// Buffered pools hand out their current values to const elements and their next values to the other ones.
+template <typename ComponentsT, typename OptionalComponentsT = std::tuple<>, typename UnusedComponentsT = std::tuple<>>
+class ComponentJoinView {
 };
 
-template <typename... T, typename... OptionalsT>
-class ComponentGroupView<std::tuple<T...>, std::tuple<OptionalsT...>> : public BaseComponentGroupView {
+template <typename... T, typename... OptionalsT, typename... UnusedT>
+class ComponentJoinView<std::tuple<T...>, std::tuple<OptionalsT...>, std::tuple<UnusedT...>> {
   private:
-    std::tuple<ComponentManagerView<T>*..., ComponentManagerView<OptionalsT>*...> views;
+    static constexpr size_t COMPONENTS = sizeof...(T);
+    static constexpr size_t OPTIONALS = sizeof...(OptionalsT);
+    static constexpr size_t POOLS = sizeof...(T) + sizeof...(OptionalsT) + sizeof...(UnusedT);
+
+    std::tuple<ComponentManagerOf<T>*..., ComponentManagerOf<OptionalsT>*..., ComponentManagerOf<UnusedT>*...> managers;
+    std::shared_ptr<const std::vector<Entity>> entities;
+
+    const Entity *driverData = nullptr;
+    size_t driverSize = 0;
+    // Required pools owned by the walked group, their rows are in lockstep with the driver
+    std::array<bool, COMPONENTS> lockstep{};
+    // Every driver row matches and is read by row in every pool
+    bool dense = false;
+
+    template <size_t... I>
+    bool SelectGroup(std::index_sequence<I...>) {
+        OwnedGroupBase *group = nullptr;
+        ((group = group ? group : std::get<I>(managers)->GetOwningGroup()), ...);
+
+        if (group == nullptr || ((size_t) (std::get<I>(managers)->GetOwningGroup() == group) + ... + 0) != group->GetOwnedCount()) {
+            return false;
+        }
 
-  public:
-    ~ComponentGroupView() {
-        std::apply([](auto const & ...x) {
-            (delete x, ...);
-        }, views);
+        auto select = [this, group](auto manager, bool &owned) {
+            owned = manager->GetOwningGroup() == group;
+
+            if (owned && driverData == nullptr) {
+                driverData = manager->GetEntityData();
+            }
+        };
+
+        (select(std::get<I>(managers), lockstep[I]), ...);
+        driverSize = group->size();
+        dense = POOLS == COMPONENTS && (lockstep[I] && ...);
+        return true;
+    }
+
+    // Any required or unused pool can drive the join, the smallest one does the fewest lookups
+    template <size_t... I, size_t... K>
+    void SelectDriver(std::index_sequence<I...>, std::index_sequence<K...>) {
+        size_t smallest = ~size_t(0);
+
+        auto select = [this, &smallest](auto manager) {
+            if (manager->size() < smallest) {
+                smallest = manager->size();
+                driverData = manager->GetEntityData();
+                driverSize = manager->size();
+            }
+        };
+
+        (select(std::get<I>(managers)), ...);
+        (select(std::get<COMPONENTS + OPTIONALS + K>(managers)), ...);
     }
 
-    ComponentGroupView(int) {}
+    // Writable elements stamp the changed tick of count rows from component's row on, buffered pools hand out
+    // their next values. Entities and tags carry nothing to write.
+    template <typename U>
+    static U *ForAccess(ComponentManagerOf<U> *manager, U *component, unsigned int count = 1) {
+        if constexpr (!std::is_const_v<U> && !std::is_same_v<U, Entity> && !ComponentManagerOf<U>::IsTag()) {
+            return component == nullptr ? nullptr : manager->GetWrittenRows(manager->GetRow(component), count);
+        }
+
+        return component;
+    }
 
-    ComponentGroupView(ComponentManagerView<T>*... views, ComponentManagerView<OptionalsT>*... optViews) {
-        this->views = std::tuple_cat(
-                          std::make_tuple(views...),
-                          std::make_tuple(optViews...));
+    // The components are the ones after the run's last row, a missing optional component extends a run of them
+    template <typename PointerT, size_t... I>
+    static bool Follows(const PointerT &components, const PointerT &runFirst, size_t runCount, std::index_sequence<I...>) {
+        return ((std::get<I>(components) == (std::get<I>(runFirst) == nullptr ? nullptr : std::get<I>(runFirst) + runCount)) && ...);
     }
 
-    ComponentGroupView(std::vector<Entity> entities, ComponentManager<T>*... componentManagers, ComponentManager<OptionalsT>*... optComponentManagers) {
-        this->views = std::tuple_cat(
-                          std::make_tuple(GetViewInternal(componentManagers, entities)...),
-                          std::make_tuple(GetViewInternal(optComponentManagers, entities)...));
+  public:
+    ComponentJoinView(std::shared_ptr<const std::vector<Entity>> entities, ComponentManagerOf<T>*... componentManagers,
+                      ComponentManagerOf<OptionalsT>*... optComponentManagers, ComponentManagerOf<UnusedT>*... unusedComponentManagers) :
+        managers(componentManagers..., optComponentManagers..., unusedComponentManagers...), entities(std::move(entities)) {
+        std::apply([](auto ...manager) {
+            (manager->SignalViewStarted(), ...);
+        }, managers);
+
+        if (this->entities) {
+            driverData = this->entities->data();
+            driverSize = this->entities->size();
+        } else if (!SelectGroup(std::index_sequence_for<T...>())) {
+            SelectDriver(std::index_sequence_for<T...>(), std::index_sequence_for<UnusedT...>());
+        }
     }
 
-    const auto GetViews() {
-        return views;
+    ComponentJoinView(ComponentManagerOf<T>*... componentManagers, ComponentManagerOf<OptionalsT>*... optComponentManagers,
+                      ComponentManagerOf<UnusedT>*... unusedComponentManagers) :
+        ComponentJoinView(nullptr, componentManagers..., optComponentManagers..., unusedComponentManagers...) {}
+
+    ~ComponentJoinView() {
+        std::apply([](auto ...manager) {
+            (manager->SignalViewFinished(), ...);
+        }, managers);
     }
 
+    ComponentJoinView(const ComponentJoinView &other) = delete;
+    ComponentJoinView &operator=(const ComponentJoinView &other) = delete;
+
     // ITERATOR
-    class ComponentGroupIterator {
-        //friend class ComponentGroupView<T...>;
+    class ComponentJoinIterator {
       public:
         using iterator_category = std::forward_iterator_tag;
         using difference_type   = std::ptrdiff_t;
@@ -544,79 +1142,147 @@ class ComponentGroupView<std::tuple<T...>, std::tuple<OptionalsT...>> : public B
         using reference         = std::tuple<T&..., OptionalsT*...>;
 
       private:
-        std::tuple<typename ComponentManagerView<T>::ComponentIterator...> tupleIter;
-        std::tuple<typename ComponentManagerView<OptionalsT>::ComponentIterator...> optTupleIter;
-      public:
-        ComponentGroupIterator(typename ComponentManagerView<T>::ComponentIterator... it, typename ComponentManagerView<OptionalsT>::ComponentIterator... itOpt) {
-            tupleIter = std::make_tuple(it...);
-            optTupleIter = std::make_tuple(itOpt...);
+        const ComponentJoinView *view;
+        size_t row;
+        size_t last;
+        std::array<unsigned int, POOLS> positions{};
+        pointer current;
+
+        template <size_t... I, size_t... J, size_t... K>
+        bool Match(const Entity entity, std::index_sequence<I...>, std::index_sequence<J...>, std::index_sequence<K...>) {
+            bool found = ((std::get<I>(current) = view->lockstep[I] ? std::get<I>(view->managers)->GetComponent((int) row) :
+                           std::get<I>(view->managers)->SeekComponent(entity, positions[I])) && ...);
+
+            if (!found) {
+                return false;
+            }
+
+            found = ((std::get<COMPONENTS + OPTIONALS + K>(view->managers)->SeekComponent(entity, positions[COMPONENTS + OPTIONALS + K]) != nullptr) && ...);
+
+            if (!found) {
+                return false;
+            }
+
+            ((std::get<COMPONENTS + J>(current) = std::get<COMPONENTS + J>(view->managers)->SeekComponent(entity, positions[COMPONENTS + J])), ...);
+            ((std::get<I>(current) = ForAccess(std::get<I>(view->managers), std::get<I>(current))), ...);
+            ((std::get<COMPONENTS + J>(current) = ForAccess(std::get<COMPONENTS + J>(view->managers), std::get<COMPONENTS + J>(current))), ...);
+            return true;
         }
 
-        ComponentGroupIterator(const ComponentGroupIterator &other) {
-            tupleIter = other.tupleIter;
-            optTupleIter = other.optTupleIter;
+        // Moves to the first matching row starting with the current one, stops at last
+        void Seek() {
+            for (; row < last; row++) {
+                auto entity = view->driverData[row];
+
+                if (Match(entity, std::index_sequence_for<T...>(), std::index_sequence_for<OptionalsT...>(), std::index_sequence_for<UnusedT...>())) {
+                    return;
+                }
+            }
         }
 
-        reference operator*() const {
-            return std::tuple_cat(std::apply([](auto const & ...x) {
-                return std::tie((x.get())...);
-            }, tupleIter),
+        template <size_t... I, size_t... J>
+        reference Dereference(std::index_sequence<I...>, std::index_sequence<J...>) const {
+            return reference(*std::get<I>(current)..., std::get<COMPONENTS + J>(current)...);
+        }
 
-            std::apply([](auto const & ...x) {
-                return std::make_tuple((x.operator->())...);
-            }, optTupleIter))
-            ;
+      public:
+        ComponentJoinIterator(const ComponentJoinView *view, size_t row, size_t last) : view(view), row(row), last(last) {
+            Seek();
         }
 
-        pointer operator->() const {
-            return std::tuple_cat(
-            std::apply([](auto const & ...x) {
-                return std::make_tuple(x.operator->()...);
-            }, tupleIter),
+        size_t GetRow() const {
+            return row;
+        }
 
-            std::apply([](auto const & ...x) {
-                return std::make_tuple((x.operator->())...);
-            }, optTupleIter));
+        const pointer &GetPointers() const {
+            return current;
+        }
+
+        reference operator*() const {
+            return Dereference(std::index_sequence_for<T...>(), std::index_sequence_for<OptionalsT...>());
         }
 
         // Prefix increment
-        ComponentGroupIterator &operator++() {
-            tupleIter = std::apply([](auto ...x) {
-                return std::make_tuple(++x...);
-            }, tupleIter);
-
-            optTupleIter = std::apply([](auto ...x) {
-                return std::make_tuple(++x...);
-            }, optTupleIter);
+        ComponentJoinIterator &operator++() {
+            row++;
+            Seek();
             return *this;
         }
 
         // Postfix increment
-        ComponentGroupIterator operator++(int) {
-            ComponentGroupIterator tmp = *this;
+        ComponentJoinIterator operator++(int) {
+            ComponentJoinIterator tmp = *this;
             ++(*this);
             return tmp;
         }
 
-        friend bool operator==(const ComponentGroupIterator& a, const ComponentGroupIterator& b) {
-            return (a.tupleIter == b.tupleIter && a.optTupleIter == b.optTupleIter);
+        friend bool operator==(const ComponentJoinIterator& a, const ComponentJoinIterator& b) {
+            return a.row == b.row;
         };
 
-        friend bool operator!=(const ComponentGroupIterator& a, const ComponentGroupIterator& b) {
-            return (a.tupleIter != b.tupleIter || a.optTupleIter != b.optTupleIter);
+        friend bool operator!=(const ComponentJoinIterator& a, const ComponentJoinIterator& b) {
+            return a.row != b.row;
         };
     };
 
-    ComponentGroupIterator begin() {
-        return std::make_from_tuple<ComponentGroupIterator>(std::apply([](auto ...x) {
-            return std::make_tuple(x->begin()...);
-        }, views));
+    ComponentJoinIterator begin() const {
+        return ComponentJoinIterator(this, 0, driverSize);
+    }
+
+    ComponentJoinIterator end() const {
+        return ComponentJoinIterator(this, driverSize, driverSize);
+    }
+
+    // Number of driver rows, not all of them have to match
+    size_t GetRowsCount() const {
+        return driverSize;
+    }
+
+    // Calls fn for the matching rows in [first, last), ranges that don't overlap can be walked by different threads
+    template <typename FnT>
+    void ForEachInRange(size_t first, size_t last, FnT &&fn) const {
+        for (ComponentJoinIterator it(this, first, last); it.GetRow() < last; ++it) {
+            fn(*it);
+        }
     }
 
-    ComponentGroupIterator end() {
-        return std::make_from_tuple<ComponentGroupIterator>(std::apply([](auto ...x) {
-            return std::make_tuple(x->end()...);
-        }, views));
+    // Calls runFn(components, count) for runs of matching rows in [first, last), components points to the first
+    // row's components and the next rows' ones follow them in every pool. The prefix of an owned group whose pools
+    // are all the view's pools is a single run, otherwise the matching rows are walked and joined into runs.
+    template <typename RunFnT>
+    void ForEachRunInRange(size_t first, size_t last, RunFnT &&runFn) const {
+        if constexpr (POOLS == COMPONENTS) {
+            if (dense) {
+                if (first < last) {
+                    runFn(std::apply([first, last](auto ...manager) {
+                        return typename ComponentJoinIterator::pointer(ForAccess<T>(manager, manager->GetComponent((int) first), last - first)...);
+                    }, managers), last - first);
+                }
+
+                return;
+            }
+        }
+
+        typename ComponentJoinIterator::pointer runFirst;
+        size_t runCount = 0;
+
+        for (ComponentJoinIterator it(this, first, last); it.GetRow() < last; ++it) {
+            if (runCount > 0 && Follows(it.GetPointers(), runFirst, runCount, std::index_sequence_for<T..., OptionalsT...>())) {
+                runCount++;
+                continue;
+            }
+
+            if (runCount > 0) {
+                runFn(runFirst, runCount);
+            }
+
+            runFirst = it.GetPointers();
+            runCount = 1;
+        }
+
+        if (runCount > 0) {
+            runFn(runFirst, runCount);
+        }
     }
 };
 
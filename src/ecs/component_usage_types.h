@@ -20,6 +20,20 @@ class Unused : public ComponentPack<T...> {};
 template <typename... T>
 class Optional : public ComponentPack<T...> {};
 
+// Query filter leaving out the entities having any of T
+template <typename... T>
+class Exclude : public ComponentPack<T...> {};
+
+// Group view filter keeping only the entities whose T was changed, or added, since the running system last ran
+template <typename T, bool ADDED>
+class ChangeFilter {};
+
+template <typename T>
+class Changed : public ChangeFilter<T, false> {};
+
+template <typename T>
+class Added : public ChangeFilter<T, true> {};
+
 class ComponentGroupMask {
   public:
     ComponentMask component;
@@ -1,36 +1,118 @@
 #include "engine.h"
 
+#include <algorithm>
+
 namespace ECS {
 
 Entity DefaultEngineCore::CreateEntity() {
-    auto entity = Entity(entityIdManager.GetId());
+    ID id = entityIdManager.GetId();
+    auto entity = Entity(id, entityIdManager.GetGeneration(id));
     AddComponent(entity, entity);
     return entity;
 }
 
 void DefaultEngineCore::DeleteEntity(Entity entity) {
-    for (auto &cm : componentManagers) {
-        cm.second->RemoveComponent(entity);
+    if (!IsAlive(entity)) {
+        return;
+    }
+
+    auto it = entityTypeMap.find(entity);
+
+    if (it != entityTypeMap.end()) {
+        for (auto &query : queries) {
+            if (query->Matches(it->second)) {
+                query->Erase(entity);
+            }
+        }
+
+        for (auto id : it->second) {
+            componentManagers[id]->RemoveComponent(entity);
+        }
+
+        entityTypeMap.erase(it);
     }
 
     entityIdManager.FreeId(entity.GetId());
-    entityTypeMap.erase(entity);
 }
 
 void DefaultEngineCore::DeleteEntities(const std::vector<Entity> &entities) {
+    std::vector<std::vector<Entity>> entitiesByTypeId(componentManagers.size());
+    std::vector<std::vector<Entity>> entitiesByQuery(queries.size());
+
+    for (auto &entity : entities) {
+        if (!IsAlive(entity)) {
+            continue;
+        }
+
+        auto it = entityTypeMap.find(entity);
+
+        if (it != entityTypeMap.end()) {
+            for (auto id : it->second) {
+                entitiesByTypeId[id].push_back(entity);
+            }
+
+            for (size_t i = 0; i < queries.size(); i++) {
+                if (queries[i]->Matches(it->second)) {
+                    entitiesByQuery[i].push_back(entity);
+                }
+            }
+
+            entityTypeMap.erase(it);
+        }
+
+        entityIdManager.FreeId(entity.GetId());
+    }
+
+    for (size_t id = 0; id < entitiesByTypeId.size(); id++) {
+        if (!entitiesByTypeId[id].empty()) {
+            componentManagers[id]->RemoveComponents(entitiesByTypeId[id]);
+        }
+    }
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (!entitiesByQuery[i].empty()) {
+            std::sort(entitiesByQuery[i].begin(), entitiesByQuery[i].end());
+            queries[i]->Erase(entitiesByQuery[i]);
+        }
+    }
+}
+
+std::vector<Entity> DefaultEngineCore::AllocateEntities(size_t count, const ComponentMask &mask) {
+    std::vector<Entity> entities;
+    entities.reserve(count);
+
+    // Reused ids come smallest first and before new ids, so the entities are already sorted
+    for (size_t i = 0; i < count; i++) {
+        ID id = entityIdManager.GetId();
+        entities.emplace_back(id, entityIdManager.GetGeneration(id));
+    }
+
     for (auto &entity : entities) {
-        DeleteEntity(entity);
+        entityTypeMap.emplace_hint(entityTypeMap.end(), entity, mask);
     }
+
+    for (auto &query : queries) {
+        if (query->Matches(mask)) {
+            query->Insert(entities);
+        }
+    }
+
+    std::vector<std::pair<Entity, Entity>> rows;
+    rows.reserve(entities.size());
+
+    for (auto &entity : entities) {
+        rows.emplace_back(entity, entity);
+    }
+
+    GetComponentManager<Entity>()->AddComponents(std::move(rows));
+    return entities;
 }
 
 std::vector<Entity> DefaultEngineCore::GetEntities(ComponentMask mask) {
     std::vector<Entity> matchingEntities;
 
     for (auto &it : entityTypeMap) {
-        std::vector<ID> intersection;
-        std::set_intersection(it.second.begin(), it.second.end(), mask.begin(), mask.end(), std::back_inserter(intersection));
-
-        if (intersection.size() == mask.size()) {
+        if (it.second.Contains(mask)) {
             matchingEntities.push_back(it.first);
         }
     }
@@ -38,12 +120,87 @@ std::vector<Entity> DefaultEngineCore::GetEntities(ComponentMask mask) {
     return matchingEntities;
 }
 
+EntityQuery *DefaultEngineCore::GetQuery(const ComponentMask &mask, const ComponentMask &excluded) {
+    for (auto &query : queries) {
+        if (query->GetMask() == mask && query->GetExcluded() == excluded) {
+            return query.get();
+        }
+    }
+
+    queries.push_back(std::make_unique<EntityQuery>(mask, excluded, std::vector<Entity>()));
+    auto query = queries.back().get();
+
+    // The entity map is sorted, so the entities are appended
+    for (auto &it : entityTypeMap) {
+        if (query->Matches(it.second)) {
+            query->Insert(it.first);
+        }
+    }
+
+    // Adding or removing an excluded type also moves entities in and out of the query
+    ComponentMask types = mask;
+    types.insert(excluded);
+
+    for (auto id : types) {
+        if (id >= queriesByTypeId.size()) {
+            queriesByTypeId.resize(id + 1);
+        }
+
+        queriesByTypeId[id].push_back(query);
+    }
+
+    return query;
+}
+
+// mask already has the added type
+void DefaultEngineCore::OnComponentAdded(Entity entity, const ComponentMask &mask, ID id) {
+    if (id >= queriesByTypeId.size()) {
+        return;
+    }
+
+    for (auto query : queriesByTypeId[id]) {
+        if (query->Matches(mask)) {
+            query->Insert(entity);
+        } else if (query->GetExcluded().count(id)) {
+            query->Erase(entity);
+        }
+    }
+}
+
+// mask still has the removed type
+void DefaultEngineCore::OnComponentRemoved(Entity entity, const ComponentMask &mask, ID id) {
+    if (id >= queriesByTypeId.size()) {
+        return;
+    }
+
+    for (auto query : queriesByTypeId[id]) {
+        if (query->Matches(mask)) {
+            query->Erase(entity);
+        } else if (query->GetExcluded().count(id)) {
+            ComponentMask remaining = mask;
+            remaining.erase(id);
+
+            if (query->Matches(remaining)) {
+                query->Insert(entity);
+            }
+        }
+    }
+}
+
 void DefaultEngineCore::EntitiesCallFor(ComponentMask mask,
                                         std::function<void (std::vector<Entity>, Engine<DefaultEngineCore> *engine)> fn, Engine<DefaultEngineCore> *engine) {
     auto entities = GetEntities(mask);
     fn(entities, engine);
 }
 
+JobSystem *DefaultEngineCore::GetJobSystem() {
+    if (jobSystem == nullptr) {
+        jobSystem = std::make_unique<JobSystem>();
+    }
+
+    return jobSystem.get();
+}
+
 void DefaultEngineCore::Register(System system) {
     systemManager.Register(system);
 }
@@ -57,7 +214,17 @@ void DefaultEngineCore::Unregister(ID id) {
 }
 
 void DefaultEngineCore::CallAll() {
+    for (auto manager : observedManagers) {
+        manager->FlushObservers();
+    }
+
     systemManager.CallAll();
+
+    for (auto manager : bufferedManagers) {
+        manager->SwapBuffers();
+    }
+
+    events.ClearAll();
 }
 
 }
@@ -15,6 +15,11 @@
 #include "unique_ids_manager.h"
 #include "system_manager.h"
 #include "component_usage_types.h"
+#include "query.h"
+#include "job_system.h"
+#include "command_buffer.h"
+#include "event_channel.h"
+#include "component_batch.h"
 
 #include "../logging/logging.h"
 
@@ -22,6 +27,7 @@ namespace ECS {
 
 //void PrintEntityVector(const std::vector<Entity> &entities);
 
+// The core decides the storage layout, group views are returned as whatever view type the core provides
 template <typename EngineCoreT>
 class Engine {
   private:
@@ -35,6 +41,16 @@ class Engine {
         return core->CreateEntity();
     }
 
+    template <typename... ComponentsT>
+    std::vector<Entity> CreateEntities(size_t count, const ComponentsT &... components) {
+        return core->CreateEntities(count, components...);
+    }
+
+    template <typename ComponentT1, typename... ComponentsT>
+    std::vector<Entity> CreateEntities(const std::vector<ComponentT1> &components1, const std::vector<ComponentsT> &... components) {
+        return core->CreateEntities(components1, components...);
+    }
+
     template<typename... ComponentsT>
     void DeleteComponents(Entity entity) {
         core->template DeleteComponents<ComponentsT...>(entity);
@@ -44,6 +60,10 @@ class Engine {
         core->DeleteEntity(entity);
     }
 
+    bool IsAlive(Entity entity) const {
+        return core->IsAlive(entity);
+    }
+
     void DeleteEntities(const std::vector<Entity> &entities) {
         core->DeleteEntities(entities);
     }
@@ -53,11 +73,77 @@ class Engine {
         core->AddComponent(entity, data);
     }
 
+    // Marks the component as changed, GetComponent<const T> only reads it
     template <typename T>
     T *GetComponent(Entity entity) {
         return core->template GetComponent<T>(entity);
     }
 
+    // On a pool declared with BufferedSparseSetComponent, GetComponent<const T> and const group view elements return
+    // the current value. GetComponent<T>, GetNextComponent and the other view elements return the next value, which
+    // starts as a copy of the current one and becomes current at the end of CallAll. Other pools return the
+    // component itself.
+    template <typename T>
+    T *GetNextComponent(Entity entity) {
+        return core->template GetNextComponent<T>(entity);
+    }
+
+    // The next value if it was written this frame, otherwise the current one
+    template <typename T>
+    const T *GetLatestComponent(Entity entity) {
+        return core->template GetLatestComponent<T>(entity);
+    }
+
+    // Pointers returned by GetComponent<T> stay valid while this does not change
+    template <typename T>
+    uint64_t GetComponentVersion() {
+        return core->template GetComponentVersion<T>();
+    }
+
+    // Observers are called with (entity, component) right after a component is added or replaced and right before
+    // it is removed, DeleteEntity and deferred changes included. Changes they make to the observed type are applied
+    // after all of them ran. Passing ECS::Batched() instead calls fn(entities) once per frame, before the systems run.
+    // The returned handle is passed to Unobserve to remove the observer, an observer capturing an object has to be
+    // removed before the object is destroyed.
+    template <typename T, typename FnT, typename... BatchedT>
+    ObserverHandle OnAdd(FnT fn, BatchedT... batched) {
+        return core->template Observe<T>(ComponentEvent::ADD, fn, batched...);
+    }
+
+    template <typename T, typename FnT, typename... BatchedT>
+    ObserverHandle OnRemove(FnT fn, BatchedT... batched) {
+        return core->template Observe<T>(ComponentEvent::REMOVE, fn, batched...);
+    }
+
+    template <typename T, typename FnT, typename... BatchedT>
+    ObserverHandle OnReplace(FnT fn, BatchedT... batched) {
+        return core->template Observe<T>(ComponentEvent::REPLACE, fn, batched...);
+    }
+
+    // Not to be called from an observer of the same type and event
+    void Unobserve(const ObserverHandle &handle) {
+        core->Unobserve(handle);
+    }
+
+    // Per entity forms of Changed<T> and Added<T>: true if the entity has a T that was changed, or added, since the
+    // running system last ran
+    template <typename T>
+    bool IsChanged(Entity entity) {
+        return core->template IsChanged<std::remove_const_t<T>>(entity, false);
+    }
+
+    template <typename T>
+    bool IsAdded(Entity entity) {
+        return core->template IsChanged<std::remove_const_t<T>>(entity, true);
+    }
+
+    // Packs the entities having all of T... at the front of the T pools, in the same order, and keeps them packed
+    // on every add and remove. Group views requiring all of T... then walk the packed rows in lockstep.
+    template <typename... T>
+    void CreateOwnedGroup() {
+        core->template CreateOwnedGroup<T...>();
+    }
+
     std::vector<Entity> GetEntities(ComponentMask mask) {
         return core->GetEntities(mask);
     }
@@ -67,38 +153,147 @@ class Engine {
     }
 
     template <typename T>
-    const std::vector<std::pair<Entity, T>> *GetComponents() {
-        return core->template GetComponentsEntities<T>();
+    const std::vector<T> *GetComponents() {
+        return core->template GetComponents<T>();
     }
 
+    // Entities of the components returned by GetComponents, in the same order
     template <typename T>
-    const ComponentManagerView<T> GetComponentManagerView(std::vector<Entity> entities) {
-        return core->template GetComponentManagerView<T>(entities);
+    const std::vector<Entity> *GetComponentEntities() {
+        return core->template GetComponentEntities<T>();
     }
 
     template <typename... T>
-    ComponentGroupView<std::tuple<T...>, std::tuple<>> GetGroupView() {
+    auto GetGroupView() {
         return core->template GetGroupView<T...>();
     }
 
     template <typename... T, typename UnusedT1, typename... UnusedT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<>> GetGroupView(Unused<UnusedT1, UnusedT...> unused) {
+    auto GetGroupView(Unused<UnusedT1, UnusedT...> unused) {
         return core->template GetGroupView<T...>(unused);
     }
 
 
     template <typename... T, typename OptionalT1, typename... OptionalT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(Optional<OptionalT1, OptionalT...> opt) {
+    auto GetGroupView(Optional<OptionalT1, OptionalT...> opt) {
         return core->template GetGroupView<T...>(opt);
     }
 
     template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(Optional<OptionalT1, OptionalT...> opt, Unused<UnusedT...> unused) {
+    auto GetGroupView(Optional<OptionalT1, OptionalT...> opt, Unused<UnusedT...> unused) {
         return core->template GetGroupView<T...>(opt, unused);
     }
 
+    template <typename... T, typename... OptionalT>
+    auto GetGroupView(const Query<std::tuple<T...>, std::tuple<OptionalT...>> &query) {
+        return core->GetGroupView(query);
+    }
+
+    // Only the entities whose FilterT was changed (Changed<FilterT>) or added (Added<FilterT>) since the running
+    // system last ran. AddComponent, GetComponent and views handing out a non-const FilterT count as changes.
+    template <typename... T, typename FilterT, bool ADDED>
+    auto GetGroupView(ChangeFilter<FilterT, ADDED> filter) {
+        return core->template GetGroupView<T...>(filter);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename FilterT, bool ADDED>
+    auto GetGroupView(Optional<OptionalT1, OptionalT...> opt, ChangeFilter<FilterT, ADDED> filter) {
+        return core->template GetGroupView<T...>(opt, filter);
+    }
+
+    // Calls fn(commands, components...) for every entity of the group view on the core's job system. The callback
+    // must not change the engine directly, structural changes go through commands and are committed after the
+    // iteration.
+    template <typename... T, typename FnT, typename... ArgsT>
+    void ParallelEach(FnT fn, ArgsT... args) {
+        core->template RunParallel<T...>([&fn](auto &commands, auto &&forEachRow, auto &&) {
+            forEachRow([&](auto &&components) {
+                std::apply([&](auto &&... component) {
+                    fn(commands, component...);
+                }, components);
+            });
+        }, args...);
+    }
+
+    // Like ParallelEach, but fn(commands, batch) is called once per ComponentBatch of up to ECS_BATCH_SIZE rows.
+    // Rows that are consecutive in the pools, such as an owned group's prefix, are processed in the pools' storage.
+    template <typename... T, typename FnT, typename... ArgsT>
+    void ParallelEachBatch(FnT fn, ArgsT... args) {
+        using ViewT = decltype(core->template GetGroupView<T...>(args...));
+        using BatchT = ComponentBatch<std::decay_t<decltype(*std::declval<ViewT&>().begin())>>;
+
+        core->template RunParallel<T...>([&fn](auto &commands, auto &&, auto &&forEachRun) {
+            BatchT batch;
+
+            forEachRun([&](const auto &components, size_t count) {
+                size_t row = 0;
+
+                // Long runs skip the row by row fill, the batch points at the run's storage
+                if (count >= BatchT::SIZE / 2) {
+                    if (batch.size() > 0) {
+                        fn(commands, batch);
+                        batch.Flush();
+                    }
+
+                    for (; row < count; row += BatchT::SIZE) {
+                        batch.PushRun(components, row, std::min(count - row, BatchT::SIZE));
+                        fn(commands, batch);
+                        batch.Flush();
+                    }
+
+                    return;
+                }
+
+                for (; row < count; row++) {
+                    batch.Push(components, row);
+
+                    if (batch.full()) {
+                        fn(commands, batch);
+                        batch.Flush();
+                    }
+                }
+            });
+
+            if (batch.size() > 0) {
+                fn(commands, batch);
+                batch.Flush();
+            }
+        }, args...);
+    }
+
+    template <typename... T>
+    Query<std::tuple<T...>> CreateQuery() {
+        return core->template CreateQuery<T...>();
+    }
+
+    template <typename... T, typename UnusedT1, typename... UnusedT>
+    Query<std::tuple<T...>> CreateQuery(Unused<UnusedT1, UnusedT...> unused) {
+        return core->template CreateQuery<T...>(unused);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(Optional<OptionalT1, OptionalT...> opt) {
+        return core->template CreateQuery<T...>(opt);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(Optional<OptionalT1, OptionalT...> opt, Unused<UnusedT...> unused) {
+        return core->template CreateQuery<T...>(opt, unused);
+    }
+
+    // The query leaves out the entities having any of the excluded types
+    template <typename... T, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>> CreateQuery(Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return core->template CreateQuery<T...>(exclude);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(Optional<OptionalT1, OptionalT...> opt, Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return core->template CreateQuery<T...>(opt, exclude);
+    }
+
     template <typename T>
-    ComponentManager<T> *GetComponentManager() {
+    ComponentManagerOf<T> *GetComponentManager() {
         return core->template GetComponentManager<T>();
     }
 
@@ -118,6 +313,15 @@ class Engine {
         core->Unregister(id);
     }
 
+    template <typename T>
+    EventChannel<T> &GetEvents() {
+        return core->template GetEvents<T>();
+    }
+
+    JobSystem *GetJobSystem() {
+        return core->GetJobSystem();
+    }
+
     void CallAll() {
         core->CallAll();
     }
@@ -128,16 +332,85 @@ class DefaultEngineCore {
     SystemManager systemManager;
     UniqueIdsManager<DefaultEngineCore> entityIdManager;
     std::map<Entity, ComponentMask> entityTypeMap;
-    std::unordered_map<ID, std::unique_ptr<ComponentManagerBase>> componentManagers;
+    // Indexed by Component<T>::GetTypeId(), null for types that have no manager yet
+    std::vector<std::unique_ptr<ComponentManagerBase>> componentManagers;
+    std::vector<std::unique_ptr<EntityQuery>> queries;
+    // Queries whose mask contains the type, indexed by type id
+    std::vector<std::vector<EntityQuery*>> queriesByTypeId;
+    std::unique_ptr<JobSystem> jobSystem;
+    EventChannels events;
+    // Buffered pools, swapped at the end of CallAll
+    std::vector<ComponentManagerBase*> bufferedManagers;
+    // Managers with batched observers, flushed at the start of CallAll
+    std::vector<ComponentManagerBase*> observedManagers;
+    // Declared after the managers, so the groups are destroyed first
+    std::vector<std::unique_ptr<OwnedGroupBase>> groups;
+
+    EntityQuery *GetQuery(const ComponentMask &mask, const ComponentMask &excluded = ComponentMask());
+    void OnComponentAdded(Entity entity, const ComponentMask &mask, ID id);
+    void OnComponentRemoved(Entity entity, const ComponentMask &mask, ID id);
+
+    // Creates count entities with the mask and their Entity component, the returned entities are sorted
+    std::vector<Entity> AllocateEntities(size_t count, const ComponentMask &mask);
+
+    template <typename T>
+    void AddComponentRows(const std::vector<Entity> &entities, const std::vector<T> &components) {
+        std::vector<std::pair<Entity, T>> rows;
+        rows.reserve(entities.size());
+
+        for (size_t i = 0; i < entities.size(); i++) {
+            rows.emplace_back(entities[i], T(components[i]));
+        }
+
+        GetComponentManager<T>()->AddComponents(std::move(rows));
+    }
 
   public:
     Entity CreateEntity();
     void DeleteEntity(Entity entity);
+    // Every component pool and query is updated once for all the entities
     void DeleteEntities(const std::vector<Entity> &entities);
 
+    // Creates count entities with a copy of every component, every component pool is merged once
+    template <typename... ComponentsT>
+    std::vector<Entity> CreateEntities(size_t count, const ComponentsT &... components) {
+        auto entities = AllocateEntities(count, CreateMask<Entity, ComponentsT...>());
+        (GetComponentManager<ComponentsT>()->AddComponents(entities, components), ...);
+        return entities;
+    }
+
+    // Creates one entity per element, all the vectors must have the same size
+    template <typename ComponentT1, typename... ComponentsT>
+    std::vector<Entity> CreateEntities(const std::vector<ComponentT1> &components1, const std::vector<ComponentsT> &... components) {
+        if (((components.size() != components1.size()) || ...)) {
+            LOG_ERROR("debug", "CreateEntities called with component vectors of different sizes");
+            return {};
+        }
+
+        auto entities = AllocateEntities(components1.size(), CreateMask<Entity, ComponentT1, ComponentsT...>());
+        AddComponentRows(entities, components1);
+        (AddComponentRows(entities, components), ...);
+        return entities;
+    }
+
+    // False for deleted entities and for handles to an index that was reused since
+    bool IsAlive(Entity entity) const {
+        return entityIdManager.IsAlive(entity.GetId(), entity.GetGeneration());
+    }
+
     template <typename T>
     void DeleteComponent(Entity entity) {
-        entityTypeMap[entity].erase(Component<T>::GetTypeId());
+        if (!IsAlive(entity)) {
+            return;
+        }
+
+        auto &mask = entityTypeMap[entity];
+
+        if (mask.count(Component<T>::GetTypeId())) {
+            OnComponentRemoved(entity, mask, Component<T>::GetTypeId());
+            mask.erase(Component<T>::GetTypeId());
+        }
+
         GetComponentManager<T>()->RemoveComponent(entity);
     }
 
@@ -146,31 +419,182 @@ class DefaultEngineCore {
         (DeleteComponent<ComponentsT>(entity), ...);
     }
 
+    // Batched DeleteComponent, the pool is compacted once
+    template <typename T>
+    void DeleteComponent(const std::vector<Entity> &entities) {
+        std::vector<Entity> removed;
+        removed.reserve(entities.size());
+
+        for (auto &entity : entities) {
+            if (!IsAlive(entity)) {
+                continue;
+            }
+
+            auto &mask = entityTypeMap[entity];
+
+            if (mask.count(Component<T>::GetTypeId())) {
+                OnComponentRemoved(entity, mask, Component<T>::GetTypeId());
+                mask.erase(Component<T>::GetTypeId());
+                removed.push_back(entity);
+            }
+        }
+
+        GetComponentManager<T>()->RemoveComponents(removed);
+    }
+
+    // Batched AddComponent, the entities must be unique and the pool is merged once
+    template <typename T>
+    void AddComponents(std::vector<std::pair<Entity, T>> rows) {
+        size_t count = 0;
+
+        for (size_t i = 0; i < rows.size(); i++) {
+            if (!IsAlive(rows[i].first)) {
+                continue;
+            }
+
+            auto &mask = entityTypeMap[rows[i].first];
+
+            if (mask.count(Component<T>::GetTypeId()) == 0) {
+                mask.insert(Component<T>::GetTypeId());
+                OnComponentAdded(rows[i].first, mask, Component<T>::GetTypeId());
+            }
+
+            if (count != i) {
+                rows[count] = std::move(rows[i]);
+            }
+
+            count++;
+        }
+
+        rows.erase(rows.begin() + count, rows.end());
+        GetComponentManager<T>()->AddComponents(std::move(rows));
+    }
+
     template <typename T>
     void AddComponent(const Entity &entity, const T &data) {
-        // add a new entity
-        if (entityTypeMap.count(entity) == 0) {
-            entityTypeMap[entity].insert(Component<T>::GetTypeId());
-        } else {
-            entityTypeMap[entity].insert(Component<T>::GetTypeId());
+        if (!IsAlive(entity)) {
+            LOG_INFO("debug", "Component not added, entity %u is not alive", (unsigned int) entity.GetId());
+            return;
+        }
+
+        auto &mask = entityTypeMap[entity];
+
+        if (mask.count(Component<T>::GetTypeId()) == 0) {
+            mask.insert(Component<T>::GetTypeId());
+            OnComponentAdded(entity, mask, Component<T>::GetTypeId());
         }
 
         GetComponentManager<T>()->AddComponent(entity, data);
     }
 
+    // Const types share the manager of the component type
     template <typename T>
-    ComponentManager<T> *GetComponentManager() {
-        if (componentManagers.count(Component<T>::GetTypeId()) == 0) {
-            LOG_INFO("debug", "Added component manager for %u", Component<T>::GetTypeId());
-            componentManagers[Component<T>::GetTypeId()] = std::make_unique<ComponentManager<T>>();
+    ComponentManagerOf<T> *GetComponentManager() {
+        typedef std::remove_const_t<T> ComponentT;
+        ID id = Component<ComponentT>::GetTypeId();
+
+        if (id >= componentManagers.size()) {
+            componentManagers.resize(id + 1);
         }
 
-        return static_cast<ComponentManager<T>*>(componentManagers[Component<T>::GetTypeId()].get());
+        if (componentManagers[id] == nullptr) {
+            LOG_INFO("debug", "Added component manager for %u", id);
+            componentManagers[id] = std::make_unique<ComponentManager<ComponentT>>();
+            componentManagers[id]->SetChangeTick(systemManager.GetChangeTick());
+
+            if constexpr (ComponentManager<ComponentT>::IsBuffered()) {
+                bufferedManagers.push_back(componentManagers[id].get());
+            }
+        }
+
+        return static_cast<ComponentManager<ComponentT>*>(componentManagers[id].get());
     }
 
     template <typename T>
     T *GetComponent(Entity entity) {
-        return GetComponentManager<T>()->GetComponent(entity);
+        if constexpr (std::is_const_v<T>) {
+            return GetComponentManager<T>()->FindComponent(entity);
+        } else {
+            return GetComponentManager<T>()->GetComponent(entity);
+        }
+    }
+
+    template <typename T>
+    T *GetNextComponent(Entity entity) {
+        return GetComponentManager<T>()->GetNextComponent(entity);
+    }
+
+    template <typename T>
+    const T *GetLatestComponent(Entity entity) {
+        return GetComponentManager<T>()->GetLatestComponent(entity);
+    }
+
+    // Changes whenever pointers returned by GetComponent<T> may have been invalidated
+    template <typename T>
+    uint64_t GetComponentVersion() {
+        return GetComponentManager<T>()->GetVersion();
+    }
+
+    template <typename T, typename FnT>
+    ObserverHandle Observe(ComponentEvent event, FnT fn) {
+        return ObserverHandle{Component<T>::GetTypeId(), event, false, GetComponentManager<T>()->AddObserver(event, fn)};
+    }
+
+    template <typename T, typename FnT>
+    ObserverHandle Observe(ComponentEvent event, FnT fn, __attribute__((unused)) Batched batched) {
+        auto manager = GetComponentManager<T>();
+        ObserverHandle handle{Component<T>::GetTypeId(), event, true, manager->AddBatchObserver(event, fn)};
+
+        if (std::find(observedManagers.begin(), observedManagers.end(), manager) == observedManagers.end()) {
+            observedManagers.push_back(manager);
+        }
+
+        return handle;
+    }
+
+    void Unobserve(const ObserverHandle &handle) {
+        if (handle.IsValid() && handle.type < componentManagers.size() && componentManagers[handle.type] != nullptr) {
+            componentManagers[handle.type]->RemoveObserver(handle);
+        }
+    }
+
+    // True if the entity has a T changed, or added, since the running system last ran
+    template <typename T>
+    bool IsChanged(Entity entity, bool added) {
+        return GetComponentManager<T>()->IsChangedSince(entity, systemManager.GetLastRunTick(), added);
+    }
+
+    // A pool can be owned by one group only, and the group has to be created while no view of its pools is alive.
+    // Creating the same group again does nothing.
+    template <typename... T>
+    void CreateOwnedGroup() {
+        static_assert(sizeof...(T) > 0 && (ComponentManager<T>::IsSparseSet() && ...), "Owned groups need SPARSE_SET pools");
+
+        auto group = GetComponentManager<std::tuple_element_t<0, std::tuple<T...>>>()->GetOwningGroup();
+
+        if (group && group->GetOwnedCount() == sizeof...(T) && ((GetComponentManager<T>()->GetOwningGroup() == group) && ...)) {
+            return;
+        }
+
+        if (((GetComponentManager<T>()->GetOwningGroup() != nullptr) || ...)) {
+            LOG_ERROR("debug", "Owned group not created, one of its pools is owned by another group");
+            return;
+        }
+
+        if ((GetComponentManager<T>()->IsInUse() || ...)) {
+            LOG_ERROR("debug", "Owned group not created, one of its pools is in use");
+            return;
+        }
+
+        groups.push_back(std::make_unique<OwnedGroup<T...>>(GetComponentManager<T>()...));
+    }
+
+    // Entities whose T was changed, or added, since the running system last ran
+    template <typename T>
+    std::shared_ptr<const std::vector<Entity>> GetChangedEntities(bool added) {
+        auto entities = std::make_shared<std::vector<Entity>>();
+        GetComponentManager<T>()->CollectChanged(systemManager.GetLastRunTick(), added, *entities);
+        return entities;
     }
 
     std::vector<Entity> GetEntities(ComponentMask mask);
@@ -178,57 +602,124 @@ class DefaultEngineCore {
     void EntitiesCallFor(ComponentMask mask, std::function<void (std::vector<Entity>, Engine<DefaultEngineCore>*)> fn, Engine<DefaultEngineCore> *engine);
 
     template <typename T>
-    const std::vector<std::pair<Entity, T>> *GetComponentsEntities() {
-        return GetComponentManager<T>()->GetComponentEntityVector();
+    const std::vector<T> *GetComponents() {
+        return GetComponentManager<T>()->GetComponentVector();
     }
 
     template <typename T>
-    ComponentManagerView<T> GetComponentManagerView(std::vector<Entity> entities) {
-        return GetComponentManager<T>()->GetView(entities);
+    const std::vector<Entity> *GetComponentEntities() {
+        return GetComponentManager<T>()->GetEntityVector();
     }
 
     template <typename... T>
-    ComponentGroupView<std::tuple<T...>, std::tuple<>> GetGroupView() {
-        auto entities = GetEntities(CreateMask<T...>());
-        return ComponentGroupView<std::tuple<T...>, std::tuple<>>(entities, GetComponentManager<T>()...);
+    ComponentJoinView<std::tuple<T...>> GetGroupView() {
+        return ComponentJoinView<std::tuple<T...>>(GetComponentManager<T>()...);
     }
 
     template <typename... T, typename UnusedT1, typename... UnusedT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<>> GetGroupView(__attribute__((unused)) Unused<UnusedT1, UnusedT...> unused) {
-        auto entities = GetEntities(CreateMask<T..., UnusedT1, UnusedT...>());
-        return ComponentGroupView<std::tuple<T...>, std::tuple<>>(entities, GetComponentManager<T>()...);
+    ComponentJoinView<std::tuple<T...>, std::tuple<>, std::tuple<UnusedT1, UnusedT...>> GetGroupView(__attribute__((unused)) Unused<UnusedT1, UnusedT...> unused) {
+        return ComponentJoinView<std::tuple<T...>, std::tuple<>, std::tuple<UnusedT1, UnusedT...>>(GetComponentManager<T>()..., GetComponentManager<UnusedT1>(), GetComponentManager<UnusedT>()...);
     }
 
     template <typename... T, typename OptionalT1, typename... OptionalT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt) {
-        auto entities = GetEntities(CreateMask<T...>());
-        std::vector<Entity> entitiesWithOptional;
+    ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt) {
+        return ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(GetComponentManager<T>()..., GetComponentManager<OptionalT1>(), GetComponentManager<OptionalT>()...);
+    }
 
-        {
-            std::vector<Entity> aux;
-            aux = GetEntities(CreateMask<OptionalT1>());
-            entitiesWithOptional.insert(entitiesWithOptional.end(), aux.begin(), aux.end());
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
+    ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>, std::tuple<UnusedT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt, __attribute__((unused)) Unused<UnusedT...> unused) {
+        return ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>, std::tuple<UnusedT...>>(GetComponentManager<T>()..., GetComponentManager<OptionalT1>(), GetComponentManager<OptionalT>()..., GetComponentManager<UnusedT>()...);
+    }
 
-            ((aux = GetEntities(CreateMask<OptionalT>()), entitiesWithOptional.insert(entitiesWithOptional.end(), aux.begin(), aux.end())), ...);
-        }
+    template <typename... T>
+    Query<std::tuple<T...>> CreateQuery() {
+        return GetQuery(CreateMask<T...>());
+    }
+
+    template <typename... T, typename UnusedT1, typename... UnusedT>
+    Query<std::tuple<T...>> CreateQuery(__attribute__((unused)) Unused<UnusedT1, UnusedT...> unused) {
+        return GetQuery(CreateMask<T..., UnusedT1, UnusedT...>());
+    }
 
-        return ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(entities, GetComponentManager<T>()..., GetComponentManager<OptionalT1>(), GetComponentManager<OptionalT>()...);
+    template <typename... T, typename OptionalT1, typename... OptionalT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt) {
+        return GetQuery(CreateMask<T...>());
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename... UnusedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt, __attribute__((unused)) Unused<UnusedT...> unused) {
+        return GetQuery(CreateMask<T..., UnusedT...>());
     }
 
-    template <typename... T, typename UnusedT1, typename... UnusedT, typename OptionalT1, typename... OptionalT>
-    ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(Optional<OptionalT1, OptionalT...> opt, Unused<UnusedT1, UnusedT...> unused) {
-        auto entities = GetEntities(CreateMask<T..., UnusedT1, UnusedT...>());
-        std::vector<Entity> entitiesWithOptional;
+    template <typename... T, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>> CreateQuery(__attribute__((unused)) Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return GetQuery(CreateMask<T...>(), CreateMask<ExcludedT1, ExcludedT...>());
+    }
 
-        {
-            std::vector<Entity> aux;
-            aux = GetEntities(CreateMask<OptionalT1>());
-            entitiesWithOptional.insert(entitiesWithOptional.end(), aux.begin(), aux.end());
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename ExcludedT1, typename... ExcludedT>
+    Query<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> CreateQuery(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt,
+            __attribute__((unused)) Exclude<ExcludedT1, ExcludedT...> exclude) {
+        return GetQuery(CreateMask<T...>(), CreateMask<ExcludedT1, ExcludedT...>());
+    }
+
+    // The join is driven by the entities that pass the filter
+    template <typename... T, typename FilterT, bool ADDED>
+    ComponentJoinView<std::tuple<T...>> GetGroupView(__attribute__((unused)) ChangeFilter<FilterT, ADDED> filter) {
+        return ComponentJoinView<std::tuple<T...>>(GetChangedEntities<FilterT>(ADDED), GetComponentManager<T>()...);
+    }
+
+    template <typename... T, typename OptionalT1, typename... OptionalT, typename FilterT, bool ADDED>
+    ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>> GetGroupView(__attribute__((unused)) Optional<OptionalT1, OptionalT...> opt,
+            __attribute__((unused)) ChangeFilter<FilterT, ADDED> filter) {
+        return ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(GetChangedEntities<FilterT>(ADDED), GetComponentManager<T>()...,
+                GetComponentManager<OptionalT1>(), GetComponentManager<OptionalT>()...);
+    }
 
-            ((aux = GetEntities(CreateMask<OptionalT>()), entitiesWithOptional.insert(entitiesWithOptional.end(), aux.begin(), aux.end())), ...);
+    // The join is driven by the query's entity list, which is shared with the query
+    template <typename... T, typename... OptionalT>
+    ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT...>> GetGroupView(const Query<std::tuple<T...>, std::tuple<OptionalT...>> &query) {
+        auto entities = static_cast<EntityQuery*>(query.Get())->GetEntities();
+        return ComponentJoinView<std::tuple<T...>, std::tuple<OptionalT...>>(entities, GetComponentManager<T>()..., GetComponentManager<OptionalT>()...);
+    }
+
+    // Per frame events, cleared at the end of CallAll
+    template <typename T>
+    EventChannel<T> &GetEvents() {
+        return events.template Get<T>();
+    }
+
+    JobSystem *GetJobSystem();
+
+    // Calls job(commands, forEachRow, forEachRun) for ranges of the group view's driver rows split between the job
+    // system's threads, forEachRow(rowFn) walks the rows of the range and forEachRun(runFn) its runs of consecutive
+    // rows, see ComponentJoinView::ForEachRunInRange. The jobs must not change the engine directly,
+    // structural changes go through commands and are committed in thread order after the iteration.
+    template <typename... T, typename JobT, typename... ArgsT>
+    void RunParallel(JobT job, ArgsT... args) {
+        auto jobs = GetJobSystem();
+        std::vector<CommandBuffer<DefaultEngineCore>> commands;
+
+        for (unsigned int i = 0; i < jobs->GetThreadsCount(); i++) {
+            commands.emplace_back(this);
         }
 
-        return ComponentGroupView<std::tuple<T...>, std::tuple<OptionalT1, OptionalT...>>(entities, GetComponentManager<T>()..., GetComponentManager<OptionalT1>(), GetComponentManager<OptionalT>()...);
+        {
+            auto view = GetGroupView<T...>(args...);
+            size_t rows = view.GetRowsCount();
+            size_t grain = std::max<size_t>(ECS_PARALLEL_MIN_ROWS, rows / (jobs->GetThreadsCount() * 4));
+
+            jobs->Run((rows + grain - 1) / grain, [&](size_t range, unsigned int thread) {
+                job(commands[thread], [&](auto &&rowFn) {
+                    view.ForEachInRange(range * grain, std::min(rows, (range + 1) * grain), rowFn);
+                }, [&](auto &&runFn) {
+                    view.ForEachRunInRange(range * grain, std::min(rows, (range + 1) * grain), runFn);
+                });
+            });
+        }
+
+        for (auto &buffer : commands) {
+            buffer.Commit();
+        }
     }
 
     void Register(System system);
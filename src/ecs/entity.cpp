@@ -1,9 +0,0 @@
-#include "entity.h"
-
-namespace ECS {
-
-ID Entity::GetId() const {
-    return id;
-}
-
-}
@@ -1,33 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include "common.h"
 
 namespace ECS {
 
+// Index plus generation handle. The index is reused after the entity is deleted, the generation tells the
+// reused entity apart from stale handles to the deleted one.
 class Entity {
-    ID id;
+    uint32_t id;
+    uint32_t generation;
 
   public:
-    Entity() : id(0u) {}
-    Entity(const ID id) : id(id) {}
+    Entity() : id(0u), generation(0u) {}
+    explicit Entity(const ID id) : id(id), generation(0u) {}
+    Entity(const ID id, const uint32_t generation) : id(id), generation(generation) {}
 
-    ID GetId() const;
+    ID GetId() const {
+        return id;
+    }
+
+    uint32_t GetGeneration() const {
+        return generation;
+    }
 
-    operator int() const {
+    explicit operator int() const {
         return id;
     }
 
     bool operator==(const Entity& other) const {
-        return GetId() == other.GetId();
+        return id == other.id && generation == other.generation;
     }
 
     bool operator!=(const Entity& other) const {
-        return GetId() != other.GetId();
+        return !(*this == other);
     }
 
     bool operator<(const Entity& other) const {
-        return GetId() < other.GetId();
+        return id < other.id || (id == other.id && generation < other.generation);
     }
 };
 
@@ -37,7 +48,7 @@ namespace std {
 template <>
 struct hash<ECS::Entity> {
     size_t operator()(const ECS::Entity &p) const {
-        return hash<unsigned int>()(p.GetId());
+        return hash<uint64_t>()((uint64_t(p.GetGeneration()) << 32) | p.GetId());
     }
 };
 }
@@ -0,0 +1,32 @@
+#include "event_channel.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace ECS {
+
+ID EventTypeRegistry::GetTypeId(const std::type_index &type) {
+    static std::mutex mutex;
+    static std::unordered_map<std::type_index, ID> ids;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = ids.find(type);
+
+    if (it != ids.end()) {
+        return it->second;
+    }
+
+    ID id = ids.size();
+    ids[type] = id;
+    return id;
+}
+
+void EventChannels::ClearAll() {
+    for (auto &channel : channels) {
+        if (channel != nullptr) {
+            channel->Clear();
+        }
+    }
+}
+
+}
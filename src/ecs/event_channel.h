@@ -0,0 +1,101 @@
+#pragma once
+
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "common.h"
+
+namespace ECS {
+
+// Dense index per event type, separate from the component type ids so events do not use component mask bits
+class EventTypeRegistry {
+  public:
+    static ID GetTypeId(const std::type_index &type);
+};
+
+class EventChannelBase {
+  public:
+    virtual ~EventChannelBase() {}
+    virtual void Clear() = 0;
+};
+
+// Events of one type published during the current frame, in publish order. The engine clears every channel
+// after its systems ran, the storage is kept so a steady frame does not allocate.
+template <typename T>
+class EventChannel : public EventChannelBase {
+  private:
+    std::vector<T> events;
+
+  public:
+    static ID GetTypeId() {
+        static ID id = EventTypeRegistry::GetTypeId(std::type_index(typeid(EventChannel<T>)));
+        return id;
+    }
+
+    void Publish(const T &event) {
+        events.push_back(event);
+    }
+
+    void Publish(const std::vector<T> &batch) {
+        events.insert(events.end(), batch.begin(), batch.end());
+    }
+
+    template <typename... ArgsT>
+    T &Emplace(ArgsT &&... args) {
+        events.emplace_back(std::forward<ArgsT>(args)...);
+        return events.back();
+    }
+
+    size_t size() const {
+        return events.size();
+    }
+
+    bool empty() const {
+        return events.empty();
+    }
+
+    const T &operator[](size_t index) const {
+        return events[index];
+    }
+
+    typename std::vector<T>::const_iterator begin() const {
+        return events.begin();
+    }
+
+    typename std::vector<T>::const_iterator end() const {
+        return events.end();
+    }
+
+    virtual void Clear() override {
+        events.clear();
+    }
+};
+
+// One channel per event type, created on first use
+class EventChannels {
+  private:
+    // Indexed by EventChannel<T>::GetTypeId(), null for types that were never used
+    std::vector<std::unique_ptr<EventChannelBase>> channels;
+
+  public:
+    template <typename T>
+    EventChannel<T> &Get() {
+        ID id = EventChannel<T>::GetTypeId();
+
+        if (id >= channels.size()) {
+            channels.resize(id + 1);
+        }
+
+        if (channels[id] == nullptr) {
+            channels[id] = std::make_unique<EventChannel<T>>();
+        }
+
+        return *static_cast<EventChannel<T>*>(channels[id].get());
+    }
+
+    void ClearAll();
+};
+
+}
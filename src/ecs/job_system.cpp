@@ -0,0 +1,143 @@
+#include "job_system.h"
+
+#include <algorithm>
+
+namespace ECS {
+
+// Thread index inside the job system that is running a job on this thread, -1 outside of jobs
+static thread_local int currentJobThread = -1;
+
+JobSystem::JobSystem(unsigned int threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for (unsigned int i = 1; i < threads; i++) {
+        workers.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+
+    wakeCondition.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+bool JobSystem::PopJob(unsigned int thread, size_t &job) {
+    {
+        auto &queue = *queues[thread];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (!queue.jobs.empty()) {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            return true;
+        }
+    }
+
+    for (unsigned int i = 1; i < queues.size(); i++) {
+        auto &victim = *queues[(thread + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::WorkLoop(unsigned int thread) {
+    size_t job;
+    currentJobThread = thread;
+
+    while (pendingJobs.load(std::memory_order_acquire) > 0 && PopJob(thread, job)) {
+        (*jobFn)(job, thread);
+        pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    currentJobThread = -1;
+}
+
+void JobSystem::WorkerMain(unsigned int thread) {
+    unsigned long long seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait(lock, [this, seenGeneration]() {
+                return stopping || generation != seenGeneration;
+            });
+
+            if (stopping) {
+                return;
+            }
+
+            seenGeneration = generation;
+        }
+
+        WorkLoop(thread);
+    }
+}
+
+void JobSystem::Run(size_t jobs, const JobFnT &fn) {
+    if (jobs == 0) {
+        return;
+    }
+
+    if (currentJobThread >= 0 || queues.size() == 1) {
+        unsigned int thread = std::max(currentJobThread, 0);
+
+        for (size_t job = 0; job < jobs; job++) {
+            fn(job, thread);
+        }
+
+        return;
+    }
+
+    std::lock_guard<std::mutex> runLock(runMutex);
+
+    jobFn = &fn;
+    pendingJobs.store(jobs, std::memory_order_release);
+
+    // Contiguous blocks keep neighbouring jobs on the same thread unless they get stolen
+    size_t blockSize = (jobs + queues.size() - 1) / queues.size();
+
+    for (unsigned int i = 0; i < queues.size(); i++) {
+        std::lock_guard<std::mutex> lock(queues[i]->mutex);
+
+        for (size_t job = i * blockSize; job < std::min(jobs, (i + 1) * blockSize); job++) {
+            queues[i]->jobs.push_back(job);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        generation++;
+    }
+
+    wakeCondition.notify_all();
+
+    WorkLoop(0);
+
+    while (pendingJobs.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+
+    jobFn = nullptr;
+}
+
+}
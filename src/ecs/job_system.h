@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ECS {
+
+// Smallest number of rows handed to a single job by ParallelEach
+#ifndef ECS_PARALLEL_MIN_ROWS
+#define ECS_PARALLEL_MIN_ROWS 64
+#endif
+
+// Work-stealing thread pool. Each thread owns a queue of jobs, takes jobs from the front of its own queue
+// and steals from the back of the other queues once it runs out.
+class JobSystem {
+  private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    typedef std::function<void(size_t job, unsigned int thread)> JobFnT;
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+
+    std::mutex runMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    unsigned long long generation = 0;
+    bool stopping = false;
+
+    const JobFnT *jobFn = nullptr;
+    std::atomic<size_t> pendingJobs{0};
+
+    bool PopJob(unsigned int thread, size_t &job);
+    void WorkLoop(unsigned int thread);
+    void WorkerMain(unsigned int thread);
+
+  public:
+    // threads counts the calling thread too, 0 uses one thread per hardware core
+    JobSystem(unsigned int threads = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem &other) = delete;
+    JobSystem &operator=(const JobSystem &other) = delete;
+
+    unsigned int GetThreadsCount() const {
+        return queues.size();
+    }
+
+    // Calls fn(job, thread) for every job in [0, jobs) and returns once all of them have finished. The calling
+    // thread runs jobs as thread 0. Calling Run from inside a job runs the nested jobs serially on that thread.
+    void Run(size_t jobs, const JobFnT &fn);
+};
+
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "entity.h"
+
+#include <tuple>
+#include <vector>
+
+namespace ECS {
+
+template <typename ComponentT>
+class ComponentManager;
+
+// The pools owned by a group keep the entities that have all of the group's components at their front, in the
+// same order, so the first size() rows of every owned pool belong to the same entities
+class OwnedGroupBase {
+  protected:
+    size_t groupSize = 0;
+    // Shared by the owned pools, none of them is reordered while a view walks any of them
+    unsigned int viewsInUse = 0;
+
+  public:
+    virtual ~OwnedGroupBase() {}
+
+    size_t size() const {
+        return groupSize;
+    }
+
+    unsigned int *GetViewsInUse() {
+        return &viewsInUse;
+    }
+
+    virtual size_t GetOwnedCount() const = 0;
+    // Called after a component of an owned type was added to the entity
+    virtual void OnAdded(Entity entity) = 0;
+    // Called before a component of an owned type is removed from the entity
+    virtual void OnRemoving(Entity entity) = 0;
+    // Applies the changes deferred in all the owned pools
+    virtual void Commit() = 0;
+};
+
+// Owned pools must use SPARSE_SET storage, rows are swapped in and out of the prefix
+template <typename... T>
+class OwnedGroup : public OwnedGroupBase {
+  private:
+    std::tuple<ComponentManager<T>*...> managers;
+
+    bool HasAll(Entity entity) const {
+        return std::apply([entity](auto ...manager) {
+            return ((manager->GetSparsePos(entity) != ComponentManager<T>::INVALID_POS) && ...);
+        }, managers);
+    }
+
+    // Moves the row of the entity to row in every owned pool
+    void MoveTo(Entity entity, unsigned int row) {
+        std::apply([entity, row](auto ...manager) {
+            (manager->SwapRows(manager->GetSparsePos(entity), row), ...);
+        }, managers);
+    }
+
+  public:
+    // The entities already having all the components are packed when the group is created
+    OwnedGroup(ComponentManager<T>*... componentManagers) : managers(componentManagers...) {
+        (componentManagers->SetOwningGroup(this), ...);
+
+        std::vector<Entity> entities = *std::get<0>(managers)->GetEntityVector();
+
+        for (auto entity : entities) {
+            OnAdded(entity);
+        }
+    }
+
+    virtual size_t GetOwnedCount() const override {
+        return sizeof...(T);
+    }
+
+    virtual void OnAdded(Entity entity) override {
+        if (std::get<0>(managers)->GetSparsePos(entity) < groupSize || !HasAll(entity)) {
+            return;
+        }
+
+        MoveTo(entity, groupSize);
+        groupSize++;
+    }
+
+    virtual void OnRemoving(Entity entity) override {
+        // Rows past the prefix and missing rows (INVALID_POS) are not in the group
+        if (std::get<0>(managers)->GetSparsePos(entity) >= groupSize) {
+            return;
+        }
+
+        groupSize--;
+        MoveTo(entity, groupSize);
+    }
+
+    virtual void Commit() override {
+        std::apply([](auto ...manager) {
+            (manager->Commit(), ...);
+        }, managers);
+    }
+};
+
+}
@@ -0,0 +1,61 @@
+#include "query.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace ECS {
+
+EntityQuery::EntityQuery(const ComponentMask &mask, const ComponentMask &excluded, std::vector<Entity> entities) :
+    QueryBase(mask, excluded), entities(std::make_shared<std::vector<Entity>>(std::move(entities))) {}
+
+std::vector<Entity> &EntityQuery::GetMutableEntities() {
+    if (entities.use_count() > 1) {
+        entities = std::make_shared<std::vector<Entity>>(*entities);
+    }
+
+    return *entities;
+}
+
+void EntityQuery::Insert(Entity entity) {
+    auto &list = GetMutableEntities();
+
+    if (list.empty() || list.back() < entity) {
+        list.push_back(entity);
+        return;
+    }
+
+    auto it = std::lower_bound(list.begin(), list.end(), entity);
+
+    if (it == list.end() || *it != entity) {
+        list.insert(it, entity);
+    }
+}
+
+void EntityQuery::Erase(Entity entity) {
+    auto &list = GetMutableEntities();
+    auto it = std::lower_bound(list.begin(), list.end(), entity);
+
+    if (it != list.end() && *it == entity) {
+        list.erase(it);
+    }
+}
+
+void EntityQuery::Insert(const std::vector<Entity> &sortedEntities) {
+    auto &list = GetMutableEntities();
+    size_t oldSize = list.size();
+
+    list.insert(list.end(), sortedEntities.begin(), sortedEntities.end());
+    std::inplace_merge(list.begin(), list.begin() + oldSize, list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+}
+
+void EntityQuery::Erase(const std::vector<Entity> &sortedEntities) {
+    auto &list = GetMutableEntities();
+    std::vector<Entity> remaining;
+    remaining.reserve(list.size());
+
+    std::set_difference(list.begin(), list.end(), sortedEntities.begin(), sortedEntities.end(), std::back_inserter(remaining));
+    list = std::move(remaining);
+}
+
+}
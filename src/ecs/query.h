@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <tuple>
+#include <vector>
+#include "component.h"
+#include "entity.h"
+
+namespace ECS {
+
+// Query state owned by an engine core and kept up to date on structural changes
+class QueryBase {
+  protected:
+    ComponentMask mask;
+    ComponentMask excluded;
+
+  public:
+    QueryBase(const ComponentMask &mask, const ComponentMask &excluded) : mask(mask), excluded(excluded) {}
+    virtual ~QueryBase() {}
+
+    const ComponentMask &GetMask() const {
+        return mask;
+    }
+
+    const ComponentMask &GetExcluded() const {
+        return excluded;
+    }
+
+    bool Matches(const ComponentMask &entityMask) const {
+        return entityMask.Contains(mask) && !entityMask.Intersects(excluded);
+    }
+};
+
+// Entities matching the query, sorted by id
+class EntityQuery : public QueryBase {
+  private:
+    std::shared_ptr<std::vector<Entity>> entities;
+
+    // Views keep the list they were created with, so it is copied before changing it while one is alive
+    std::vector<Entity> &GetMutableEntities();
+
+  public:
+    EntityQuery(const ComponentMask &mask, const ComponentMask &excluded, std::vector<Entity> entities);
+
+    void Insert(Entity entity);
+    void Erase(Entity entity);
+    // Batched versions, the entities must be sorted
+    void Insert(const std::vector<Entity> &sortedEntities);
+    void Erase(const std::vector<Entity> &sortedEntities);
+
+    std::shared_ptr<const std::vector<Entity>> GetEntities() const {
+        return entities;
+    }
+};
+
+// Typed handle created once with Engine::CreateQuery and iterated every frame with Engine::GetGroupView
+template <typename ComponentsT, typename OptionalComponentsT = std::tuple<>>
+class Query {
+  private:
+    QueryBase *query;
+
+  public:
+    Query() : query(nullptr) {}
+    Query(QueryBase *query) : query(query) {}
+
+    QueryBase *Get() const {
+        return query;
+    }
+
+    bool IsValid() const {
+        return query != nullptr;
+    }
+};
+
+}
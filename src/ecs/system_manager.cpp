@@ -19,8 +19,15 @@ void SystemManager::Unregister(ID id) {
 
 void SystemManager::CallAll() {
     for (auto &it : systemsMap) {
+        changeTick++;
+        lastRunTick = it.second.lastRunTick;
         it.second.fn();
+        it.second.lastRunTick = changeTick;
     }
+
+    // Changes made between frames are newer than every system's last run
+    lastRunTick = changeTick;
+    changeTick++;
 }
 
 }
@@ -1,8 +1,9 @@
 #pragma once
 
 #include "unique_ids_manager.h"
+#include <cstdint>
 #include <functional>
-#include <unordered_map>
+#include <map>
 #include "component_usage_types.h"
 
 namespace ECS {
@@ -13,6 +14,8 @@ class System {
   private:
     friend class SystemManager;
     CallbackType fn;
+    // Change tick of the system's last run
+    uint64_t lastRunTick = 0;
 
   public:
     System(CallbackType fn) : fn(fn) {}
@@ -27,7 +30,12 @@ class SystemInterface {
 class SystemManager {
   private:
     UniqueIdsManager<SystemManager> idManager;
-    std::unordered_map<ID, System> systemsMap;
+    // Ordered by id so systems run in registration order, events published by a system reach the systems
+    // registered after it in the same frame
+    std::map<ID, System> systemsMap;
+    // Incremented before every system runs and after the last one, components are stamped with it when changed
+    uint64_t changeTick = 1;
+    uint64_t lastRunTick = 0;
 
   public:
     void Unregister(ID id);
@@ -35,6 +43,15 @@ class SystemManager {
     void Register(SystemInterface *sysInt);
 
     void CallAll();
+
+    const uint64_t *GetChangeTick() const {
+        return &changeTick;
+    }
+
+    // Last run of the running system, outside of CallAll the end of the last CallAll
+    uint64_t GetLastRunTick() const {
+        return lastRunTick;
+    }
 };
 
 #define StatelessSystem(Name, GameContext) \
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <queue>
+#include <vector>
 #include "common.h"
 
 namespace ECS {
@@ -9,26 +12,55 @@ template <typename ClientT>
 class UniqueIdsManager {
   private:
     ID lastId = 0;
-    std::queue<ID> reusableIds;
+    // Freed ids are reused smallest first, which keeps the ids in use dense
+    std::priority_queue<ID, std::vector<ID>, std::greater<ID>> reusableIds;
+    // Indexed by id, incremented every time the id is freed
+    std::vector<uint32_t> generations;
+    std::vector<bool> alive;
 
     ID GenerateId() {
-        return (++lastId);
+        ++lastId;
+        generations.resize(lastId + 1, 0);
+        alive.resize(lastId + 1, false);
+        return lastId;
     }
 
   public:
     ID GetId() {
+        ID id;
+
         if (reusableIds.empty()) {
-            return GenerateId();
+            id = GenerateId();
+        } else {
+            id = reusableIds.top();
+            reusableIds.pop();
         }
 
-        ID id = reusableIds.front();
-        reusableIds.pop();
+        alive[id] = true;
         return id;
     }
 
     void FreeId(const ID id) {
+        if (!IsAlive(id)) {
+            return;
+        }
+
+        alive[id] = false;
+        generations[id]++;
         reusableIds.push(id);
     }
+
+    bool IsAlive(const ID id) const {
+        return id < alive.size() && alive[id];
+    }
+
+    bool IsAlive(const ID id, const uint32_t generation) const {
+        return IsAlive(id) && generations[id] == generation;
+    }
+
+    uint32_t GetGeneration(const ID id) const {
+        return id < generations.size() ? generations[id] : 0;
+    }
 };
 
 }
@@ -0,0 +1,378 @@
+#include "aabb_tree.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Engine {
+
+// Enlarged boxes bigger than the box enlarged by this many margins are shrunk, so a shrinking box does not keep
+// its old leaf forever
+static const float MAX_MARGINS = 4.0f;
+
+AABBTree::AABBTree(float margin) : margin(margin) {}
+
+void AABBTree::Clear() {
+    nodes.clear();
+    root = NULL_NODE;
+    freeList = NULL_NODE;
+    proxiesCount = 0;
+}
+
+AABBTree::Bounds AABBTree::ToBounds(const Rectangle &box) {
+    return Bounds{std::min(box.x, box.x + box.w), std::min(box.y, box.y + box.h),
+                  std::max(box.x, box.x + box.w), std::max(box.y, box.y + box.h)};
+}
+
+AABBTree::Bounds AABBTree::Union(const Bounds &a, const Bounds &b) {
+    return Bounds{std::min(a.minX, b.minX), std::min(a.minY, b.minY), std::max(a.maxX, b.maxX), std::max(a.maxY, b.maxY)};
+}
+
+float AABBTree::Perimeter(const Bounds &bounds) {
+    return 2 * ((bounds.maxX - bounds.minX) + (bounds.maxY - bounds.minY));
+}
+
+bool AABBTree::Contains(const Bounds &outer, const Bounds &inner) {
+    return outer.minX <= inner.minX && outer.minY <= inner.minY && inner.maxX <= outer.maxX && inner.maxY <= outer.maxY;
+}
+
+bool AABBTree::Overlaps(const Bounds &a, const Bounds &b) {
+    return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+}
+
+AABBTree::Bounds AABBTree::Enlarge(const Bounds &bounds) const {
+    return Bounds{bounds.minX - margin, bounds.minY - margin, bounds.maxX + margin, bounds.maxY + margin};
+}
+
+int AABBTree::AllocateNode() {
+    int node = freeList;
+
+    // Free nodes are linked through their parent
+    if (node == NULL_NODE) {
+        node = (int) nodes.size();
+        nodes.emplace_back();
+    } else {
+        freeList = nodes[node].parent;
+    }
+
+    nodes[node].parent = NULL_NODE;
+    nodes[node].children[0] = NULL_NODE;
+    nodes[node].children[1] = NULL_NODE;
+    nodes[node].height = 0;
+    nodes[node].data = 0;
+    return node;
+}
+
+void AABBTree::FreeNode(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int AABBTree::CreateProxy(const Rectangle &box, uint32_t data) {
+    int proxy = AllocateNode();
+    nodes[proxy].box = ToBounds(box);
+    nodes[proxy].fat = Enlarge(nodes[proxy].box);
+    nodes[proxy].data = data;
+    InsertLeaf(proxy);
+    proxiesCount++;
+    return proxy;
+}
+
+void AABBTree::DestroyProxy(int proxy) {
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    proxiesCount--;
+}
+
+bool AABBTree::MoveProxy(int proxy, const Rectangle &box) {
+    auto bounds = ToBounds(box);
+    nodes[proxy].box = bounds;
+
+    Bounds largest{bounds.minX - MAX_MARGINS * margin, bounds.minY - MAX_MARGINS * margin,
+                   bounds.maxX + MAX_MARGINS * margin, bounds.maxY + MAX_MARGINS * margin};
+
+    if (Contains(nodes[proxy].fat, bounds) && Contains(largest, nodes[proxy].fat)) {
+        return false;
+    }
+
+    RemoveLeaf(proxy);
+    nodes[proxy].fat = Enlarge(bounds);
+    InsertLeaf(proxy);
+    return true;
+}
+
+uint32_t AABBTree::GetData(int proxy) const {
+    return nodes[proxy].data;
+}
+
+int AABBTree::GetProxiesCount() const {
+    return proxiesCount;
+}
+
+int AABBTree::GetHeight() const {
+    return root == NULL_NODE ? 0 : nodes[root].height;
+}
+
+// The sibling is picked by walking down the tree while the perimeter increase of the descent is smaller than the
+// cost of pairing the leaf with the current node
+void AABBTree::InsertLeaf(int leaf) {
+    if (root == NULL_NODE) {
+        root = leaf;
+        nodes[root].parent = NULL_NODE;
+        return;
+    }
+
+    auto bounds = nodes[leaf].fat;
+    int sibling = root;
+
+    while (!nodes[sibling].IsLeaf()) {
+        float perimeter = Perimeter(nodes[sibling].fat);
+        float combined = Perimeter(Union(nodes[sibling].fat, bounds));
+
+        float cost = 2 * combined;
+        float inheritance = 2 * (combined - perimeter);
+        float childCosts[2];
+
+        for (int i = 0; i < 2; i++) {
+            auto &child = nodes[nodes[sibling].children[i]];
+            childCosts[i] = Perimeter(Union(child.fat, bounds)) + inheritance;
+
+            if (!child.IsLeaf()) {
+                childCosts[i] -= Perimeter(child.fat);
+            }
+        }
+
+        if (cost < childCosts[0] && cost < childCosts[1]) {
+            break;
+        }
+
+        sibling = nodes[sibling].children[childCosts[0] < childCosts[1] ? 0 : 1];
+    }
+
+    int oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].fat = Union(nodes[sibling].fat, bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].children[0] = sibling;
+    nodes[newParent].children[1] = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent == NULL_NODE) {
+        root = newParent;
+    } else {
+        int slot = nodes[oldParent].children[0] == sibling ? 0 : 1;
+        nodes[oldParent].children[slot] = newParent;
+    }
+
+    Refit(oldParent);
+}
+
+void AABBTree::RemoveLeaf(int leaf) {
+    if (leaf == root) {
+        root = NULL_NODE;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].children[nodes[parent].children[0] == leaf ? 1 : 0];
+    nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+        return;
+    }
+
+    int slot = nodes[grandParent].children[0] == parent ? 0 : 1;
+    nodes[grandParent].children[slot] = sibling;
+    Refit(grandParent);
+}
+
+// Walks up to the root, rebalancing every node and recomputing its height and box
+void AABBTree::Refit(int node) {
+    while (node != NULL_NODE) {
+        node = Balance(node);
+
+        auto &children = nodes[node].children;
+        nodes[node].height = 1 + std::max(nodes[children[0]].height, nodes[children[1]].height);
+        nodes[node].fat = Union(nodes[children[0]].fat, nodes[children[1]].fat);
+
+        node = nodes[node].parent;
+    }
+}
+
+// Rotates the taller child up when the heights of the children differ by more than one and returns the node
+// that took the place of the given one
+int AABBTree::Balance(int a) {
+    if (nodes[a].IsLeaf()) {
+        return a;
+    }
+
+    int balance = nodes[nodes[a].children[1]].height - nodes[nodes[a].children[0]].height;
+
+    if (balance >= -1 && balance <= 1) {
+        return a;
+    }
+
+    int slot = balance > 1 ? 1 : 0;
+    int c = nodes[a].children[slot];
+    int b = nodes[a].children[1 - slot];
+
+    // The taller child of c stays under c, the other one takes the place of c under a
+    int keep = nodes[c].children[0];
+    int move = nodes[c].children[1];
+
+    if (nodes[keep].height < nodes[move].height) {
+        std::swap(keep, move);
+    }
+
+    int parent = nodes[a].parent;
+    nodes[c].parent = parent;
+    nodes[c].children[0] = a;
+    nodes[c].children[1] = keep;
+    nodes[a].parent = c;
+    nodes[a].children[slot] = move;
+    nodes[move].parent = a;
+
+    if (parent == NULL_NODE) {
+        root = c;
+    } else {
+        int parentSlot = nodes[parent].children[0] == a ? 0 : 1;
+        nodes[parent].children[parentSlot] = c;
+    }
+
+    nodes[a].fat = Union(nodes[b].fat, nodes[move].fat);
+    nodes[a].height = 1 + std::max(nodes[b].height, nodes[move].height);
+    nodes[c].fat = Union(nodes[a].fat, nodes[keep].fat);
+    nodes[c].height = 1 + std::max(nodes[a].height, nodes[keep].height);
+    return c;
+}
+
+// Calls fn with every leaf whose box overlaps bounds. The stack is local so queries can run concurrently.
+template <typename FnT>
+void AABBTree::Visit(const Bounds &bounds, FnT fn) const {
+    if (root == NULL_NODE) {
+        return;
+    }
+
+    std::vector<int> stack = {root};
+
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+
+        if (!Overlaps(nodes[node].fat, bounds)) {
+            continue;
+        }
+
+        if (nodes[node].IsLeaf()) {
+            if (Overlaps(nodes[node].box, bounds)) {
+                fn(node);
+            }
+
+            continue;
+        }
+
+        stack.push_back(nodes[node].children[0]);
+        stack.push_back(nodes[node].children[1]);
+    }
+}
+
+void AABBTree::QueryAABB(const Rectangle &box, std::vector<uint32_t> &result) const {
+    result.clear();
+
+    Visit(ToBounds(box), [this, &result](int leaf) {
+        result.push_back(nodes[leaf].data);
+    });
+}
+
+void AABBTree::QueryPoint(float x, float y, std::vector<uint32_t> &result) const {
+    result.clear();
+
+    Visit(Bounds{x, y, x, y}, [this, &result](int leaf) {
+        result.push_back(nodes[leaf].data);
+    });
+}
+
+// Clips [enter, exit] to the part of the ray between the two planes of one axis
+static bool ClipAxis(float origin, float direction, float min, float max, float &enter, float &exit) {
+    if (direction == 0) {
+        return origin >= min && origin <= max;
+    }
+
+    float inverse = 1.0f / direction;
+    float low = (min - origin) * inverse;
+    float high = (max - origin) * inverse;
+
+    if (low > high) {
+        std::swap(low, high);
+    }
+
+    enter = std::max(enter, low);
+    exit = std::min(exit, high);
+    return enter <= exit;
+}
+
+void AABBTree::Raycast(float x, float y, float directionX, float directionY, float maxDistance, std::vector<RayHit> &result) const {
+    result.clear();
+
+    if (root == NULL_NODE || maxDistance < 0) {
+        return;
+    }
+
+    float length = std::sqrt(directionX * directionX + directionY * directionY);
+
+    if (length == 0) {
+        Visit(Bounds{x, y, x, y}, [this, &result](int leaf) {
+            result.push_back({nodes[leaf].data, 0});
+        });
+    } else {
+        directionX /= length;
+        directionY /= length;
+
+        auto hit = [x, y, directionX, directionY, maxDistance](const Bounds &bounds, float &distance) {
+            float enter = 0;
+            float exit = maxDistance;
+
+            if (!ClipAxis(x, directionX, bounds.minX, bounds.maxX, enter, exit) ||
+                    !ClipAxis(y, directionY, bounds.minY, bounds.maxY, enter, exit)) {
+                return false;
+            }
+
+            distance = enter;
+            return true;
+        };
+
+        std::vector<int> stack = {root};
+        float distance;
+
+        while (!stack.empty()) {
+            int node = stack.back();
+            stack.pop_back();
+
+            if (!hit(nodes[node].fat, distance)) {
+                continue;
+            }
+
+            if (nodes[node].IsLeaf()) {
+                if (hit(nodes[node].box, distance)) {
+                    result.push_back({nodes[node].data, distance});
+                }
+
+                continue;
+            }
+
+            stack.push_back(nodes[node].children[0]);
+            stack.push_back(nodes[node].children[1]);
+        }
+    }
+
+    std::sort(result.begin(), result.end(), [](const RayHit &a, const RayHit &b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.data < b.data);
+    });
+}
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "utils.h"
+
+namespace Engine {
+
+// Dynamic bounding volume tree over axis aligned boxes. Every leaf stores its box enlarged by a margin, so a box
+// that moves a little stays inside its leaf and only the box is updated. Boxes leaving their enlarged box are
+// reinserted, and the tree is kept balanced with rotations. Queries do not modify the tree, so they can run
+// concurrently.
+class AABBTree {
+  public:
+    static constexpr int NULL_NODE = -1;
+
+    struct RayHit {
+        uint32_t data;
+        // Distance from the origin along the direction, 0 when the origin is inside the box
+        float distance;
+    };
+
+  private:
+    struct Bounds {
+        float minX, minY, maxX, maxY;
+    };
+
+    struct Node {
+        Bounds fat;
+        // Box given by the user, only set for leaves
+        Bounds box;
+        int parent;
+        int children[2];
+        // Leaves have height 0, free nodes -1
+        int height;
+        uint32_t data;
+
+        bool IsLeaf() const {
+            return children[0] == NULL_NODE;
+        }
+    };
+
+    float margin;
+    int root = NULL_NODE;
+    int freeList = NULL_NODE;
+    int proxiesCount = 0;
+    std::vector<Node> nodes;
+
+    static Bounds ToBounds(const Rectangle &box);
+    static Bounds Union(const Bounds &a, const Bounds &b);
+    static float Perimeter(const Bounds &bounds);
+    static bool Contains(const Bounds &outer, const Bounds &inner);
+    static bool Overlaps(const Bounds &a, const Bounds &b);
+
+    Bounds Enlarge(const Bounds &bounds) const;
+    int AllocateNode();
+    void FreeNode(int node);
+    void InsertLeaf(int leaf);
+    void RemoveLeaf(int leaf);
+    int Balance(int node);
+    void Refit(int node);
+
+    template <typename FnT>
+    void Visit(const Bounds &bounds, FnT fn) const;
+
+  public:
+    // Boxes are enlarged by margin on every side in their leaves
+    AABBTree(float margin = 4.0f);
+
+    void Clear();
+
+    // Returns the proxy of the box, proxies are reused after DestroyProxy
+    int CreateProxy(const Rectangle &box, uint32_t data);
+    void DestroyProxy(int proxy);
+    // Returns true when the proxy was reinserted because the box left its enlarged box
+    bool MoveProxy(int proxy, const Rectangle &box);
+
+    uint32_t GetData(int proxy) const;
+    int GetProxiesCount() const;
+    // Height of the root, 0 for a single box
+    int GetHeight() const;
+
+    // Data of the boxes overlapping box, boxes touching on an edge overlap. The results are not sorted.
+    void QueryAABB(const Rectangle &box, std::vector<uint32_t> &result) const;
+    // Data of the boxes containing the point, points on an edge are contained
+    void QueryPoint(float x, float y, std::vector<uint32_t> &result) const;
+    // Boxes hit by the ray from (x, y) along the direction within maxDistance, sorted by distance. The direction
+    // does not need to be normalized, a zero direction only hits the boxes containing the origin.
+    void Raycast(float x, float y, float directionX, float directionY, float maxDistance, std::vector<RayHit> &result) const;
+};
+
+}
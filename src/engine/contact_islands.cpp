@@ -0,0 +1,108 @@
+#include "contact_islands.h"
+
+#include <utility>
+
+namespace Engine {
+
+unsigned int ContactIslands::Find(unsigned int body) {
+    // Path halving
+    while (parents[body] != body) {
+        parents[body] = parents[parents[body]];
+        body = parents[body];
+    }
+
+    return body;
+}
+
+void ContactIslands::Union(unsigned int bodyA, unsigned int bodyB) {
+    bodyA = Find(bodyA);
+    bodyB = Find(bodyB);
+
+    if (bodyA == bodyB) {
+        return;
+    }
+
+    if (sizes[bodyA] < sizes[bodyB]) {
+        std::swap(bodyA, bodyB);
+    }
+
+    parents[bodyB] = bodyA;
+    sizes[bodyA] += sizes[bodyB];
+}
+
+void ContactIslands::Clear(unsigned int bodies) {
+    parents.resize(bodies);
+    sizes.assign(bodies, 1);
+
+    for (unsigned int i = 0; i < bodies; i++) {
+        parents[i] = i;
+    }
+
+    contacts.clear();
+    islandContacts.clear();
+    islandOffsets.assign(1, 0);
+}
+
+void ContactIslands::Add(unsigned int bodyA, unsigned int bodyB) {
+    contacts.push_back({bodyA, bodyB});
+
+    if (bodyA != STATIC_BODY && bodyB != STATIC_BODY) {
+        Union(bodyA, bodyB);
+    }
+}
+
+void ContactIslands::Build() {
+    // Island of every root body, contacts between static bodies get an island of their own
+    std::vector<unsigned int> islandOfRoot(parents.size(), STATIC_BODY);
+    std::vector<unsigned int> islandOfContact(contacts.size());
+    islandOffsets.assign(1, 0);
+
+    auto newIsland = [this]() {
+        islandOffsets.push_back(0);
+        return (unsigned int) islandOffsets.size() - 2;
+    };
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        auto body = contacts[i].first != STATIC_BODY ? contacts[i].first : contacts[i].second;
+
+        if (body == STATIC_BODY) {
+            islandOfContact[i] = newIsland();
+        } else {
+            auto root = Find(body);
+
+            if (islandOfRoot[root] == STATIC_BODY) {
+                islandOfRoot[root] = newIsland();
+            }
+
+            islandOfContact[i] = islandOfRoot[root];
+        }
+
+        islandOffsets[islandOfContact[i] + 1]++;
+    }
+
+    for (size_t island = 1; island < islandOffsets.size(); island++) {
+        islandOffsets[island] += islandOffsets[island - 1];
+    }
+
+    // Stable counting sort by island
+    std::vector<unsigned int> next(islandOffsets.begin(), islandOffsets.end() - 1);
+    islandContacts.resize(contacts.size());
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        islandContacts[next[islandOfContact[i]]++] = i;
+    }
+}
+
+size_t ContactIslands::GetIslandsCount() const {
+    return islandOffsets.size() - 1;
+}
+
+const std::vector<unsigned int> &ContactIslands::GetContacts() const {
+    return islandContacts;
+}
+
+const std::vector<unsigned int> &ContactIslands::GetOffsets() const {
+    return islandOffsets;
+}
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace Engine {
+
+// Splits the contacts between bodies into islands, the connected components of the contact graph. Contacts of
+// different islands share no body, so the islands can be solved independently. Static bodies never join islands,
+// since solving a contact does not change them.
+class ContactIslands {
+  public:
+    static constexpr unsigned int STATIC_BODY = ~0u;
+
+  private:
+    std::vector<unsigned int> parents;
+    std::vector<unsigned int> sizes;
+    std::vector<std::pair<unsigned int, unsigned int>> contacts;
+    std::vector<unsigned int> islandContacts;
+    std::vector<unsigned int> islandOffsets = {0};
+
+    unsigned int Find(unsigned int body);
+    void Union(unsigned int bodyA, unsigned int bodyB);
+
+  public:
+    // Removes the contacts, the bodies are identified by indices in [0, bodies)
+    void Clear(unsigned int bodies);
+    // Contacts are identified by their insertion index, either body can be STATIC_BODY
+    void Add(unsigned int bodyA, unsigned int bodyB);
+
+    // Groups the contacts by island. Islands are numbered in the order of their first contact and the contacts
+    // of an island keep their insertion order.
+    void Build();
+
+    size_t GetIslandsCount() const;
+    // Contacts of the island are GetContacts()[GetOffsets()[island] .. GetOffsets()[island + 1])
+    const std::vector<unsigned int> &GetContacts() const;
+    const std::vector<unsigned int> &GetOffsets() const;
+};
+
+}
@@ -0,0 +1,166 @@
+#include "spatial_hash_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Engine {
+
+// Cells per box side when the cell size is picked from the boxes
+static const float ADAPTIVE_CELL_SCALE = 2.0f;
+// Boxes covering more cells are paired with every box instead of being hashed
+static const double MAX_BOX_CELLS = 1024;
+
+SpatialHashGrid::SpatialHashGrid(float cellSize) : cellSize(cellSize) {}
+
+void SpatialHashGrid::SetCellSize(float cellSize) {
+    this->cellSize = cellSize;
+}
+
+float SpatialHashGrid::GetCellSize() const {
+    return usedCellSize;
+}
+
+void SpatialHashGrid::Clear() {
+    boxes.clear();
+}
+
+void SpatialHashGrid::Insert(const Rectangle &box) {
+    boxes.push_back(box);
+}
+
+float SpatialHashGrid::ComputeCellSize() const {
+    if (cellSize > 0) {
+        return cellSize;
+    }
+
+    double total = 0;
+
+    for (auto &box : boxes) {
+        total += std::max(std::fabs(box.w), std::fabs(box.h));
+    }
+
+    float average = boxes.empty() ? 0 : (float)(total / boxes.size());
+    return std::max(1.0f, ADAPTIVE_CELL_SCALE * average);
+}
+
+// Clamped so boxes far outside of the int range do not overflow
+static int ToCell(float coordinate) {
+    return (int) std::max(-1e9f, std::min(1e9f, std::floor(coordinate)));
+}
+
+static uint64_t CellKey(int x, int y) {
+    return ((uint64_t)(uint32_t) x << 32) | (uint32_t) y;
+}
+
+bool SpatialHashGrid::IsOversized(const CellRange &range) {
+    return ((double) range.maxX - range.minX + 1) * ((double) range.maxY - range.minY + 1) > MAX_BOX_CELLS;
+}
+
+SpatialHashGrid::CellRange SpatialHashGrid::ToRange(const Rectangle &box) const {
+    float inverse = 1.0f / usedCellSize;
+    CellRange range;
+    range.minX = ToCell(std::min(box.x, box.x + box.w) * inverse);
+    range.minY = ToCell(std::min(box.y, box.y + box.h) * inverse);
+    range.maxX = ToCell(std::max(box.x, box.x + box.w) * inverse);
+    range.maxY = ToCell(std::max(box.y, box.y + box.h) * inverse);
+    return range;
+}
+
+void SpatialHashGrid::Build() {
+    ranges.clear();
+    entries.clear();
+    oversized.clear();
+    usedCellSize = ComputeCellSize();
+
+    for (unsigned int i = 0; i < boxes.size(); i++) {
+        auto range = ToRange(boxes[i]);
+        ranges.push_back(range);
+
+        if (IsOversized(range)) {
+            oversized.push_back(i);
+            continue;
+        }
+
+        for (int x = range.minX; x <= range.maxX; x++) {
+            for (int y = range.minY; y <= range.maxY; y++) {
+                entries.push_back({CellKey(x, y), i});
+            }
+        }
+    }
+
+    std::sort(entries.begin(), entries.end());
+}
+
+void SpatialHashGrid::Query(const Rectangle &box, std::vector<unsigned int> &result) const {
+    result.clear();
+
+    if (boxes.empty()) {
+        return;
+    }
+
+    auto range = ToRange(box);
+
+    if (IsOversized(range)) {
+        for (unsigned int i = 0; i < boxes.size(); i++) {
+            result.push_back(i);
+        }
+
+        return;
+    }
+
+    for (int x = range.minX; x <= range.maxX; x++) {
+        for (int y = range.minY; y <= range.maxY; y++) {
+            uint64_t cell = CellKey(x, y);
+            auto it = std::lower_bound(entries.begin(), entries.end(), CellEntry{cell, 0});
+
+            for (; it != entries.end() && it->cell == cell; ++it) {
+                result.push_back(it->box);
+            }
+        }
+    }
+
+    result.insert(result.end(), oversized.begin(), oversized.end());
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+const std::vector<std::pair<unsigned int, unsigned int>> &SpatialHashGrid::FindPairs() {
+    pairs.clear();
+    Build();
+
+    for (size_t first = 0; first < entries.size();) {
+        size_t last = first + 1;
+
+        while (last < entries.size() && entries[last].cell == entries[first].cell) {
+            last++;
+        }
+
+        for (size_t i = first; i < last; i++) {
+            for (size_t j = i + 1; j < last; j++) {
+                auto &a = ranges[entries[i].box];
+                auto &b = ranges[entries[j].box];
+
+                // Boxes sharing several cells are only reported from the first one they share
+                if (CellKey(std::max(a.minX, b.minX), std::max(a.minY, b.minY)) == entries[first].cell) {
+                    pairs.push_back({entries[i].box, entries[j].box});
+                }
+            }
+        }
+
+        first = last;
+    }
+
+    for (size_t i = 0; i < oversized.size(); i++) {
+        for (unsigned int box = 0; box < boxes.size(); box++) {
+            // Pairs of oversized boxes are reported by the first of them
+            if (box != oversized[i] && !std::binary_search(oversized.begin(), oversized.begin() + i, box)) {
+                pairs.push_back({std::min(box, oversized[i]), std::max(box, oversized[i])});
+            }
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+namespace Engine {
+
+// Broadphase for axis aligned boxes. Every box is hashed into the uniform grid cells it covers and only boxes
+// sharing a cell become candidate pairs, so the narrow phase skips boxes that are far apart.
+class SpatialHashGrid {
+  private:
+    struct CellRange {
+        int minX, minY, maxX, maxY;
+    };
+
+    struct CellEntry {
+        uint64_t cell;
+        unsigned int box;
+
+        bool operator<(const CellEntry &other) const {
+            return cell < other.cell || (cell == other.cell && box < other.box);
+        }
+    };
+
+    float cellSize;
+    float usedCellSize = 0;
+    std::vector<Rectangle> boxes;
+    std::vector<CellRange> ranges;
+    std::vector<CellEntry> entries;
+    std::vector<unsigned int> oversized;
+    std::vector<std::pair<unsigned int, unsigned int>> pairs;
+
+    float ComputeCellSize() const;
+    CellRange ToRange(const Rectangle &box) const;
+    static bool IsOversized(const CellRange &range);
+
+  public:
+    // A cell size <= 0 picks it every frame from the average size of the inserted boxes
+    SpatialHashGrid(float cellSize = 0);
+
+    void SetCellSize(float cellSize);
+    // Cell size used by the last Build
+    float GetCellSize() const;
+
+    void Clear();
+    // Boxes are identified by their insertion index
+    void Insert(const Rectangle &box);
+
+    // Hashes the inserted boxes into the grid, Query uses the grid of the last Build or FindPairs
+    void Build();
+    // Boxes sharing at least one cell with box, sorted and without duplicates
+    void Query(const Rectangle &box, std::vector<unsigned int> &result) const;
+
+    // Builds the grid and returns the candidate pairs (i, j) with i < j of boxes sharing at least one cell, without
+    // duplicates and sorted. Boxes touching on an edge both cover the cell of that edge, so they are reported as well.
+    const std::vector<std::pair<unsigned int, unsigned int>> &FindPairs();
+};
+
+}
@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+
+#include "../../src/ecs/engine.h"
+#include "../../src/ecs/archetype_engine_core.h"
+#include "../../src/engine/texture.h"
+#include "../../src/engine/resource_manager.h"
+
+typedef Engine::SharedResource<Engine::Texture> SharedTexturePtr;
+typedef Engine::UniqueResource<Engine::Texture> UniqueTexturePtr;
+
+#include "../../src/biecs/biecs.h"
+
+// VelocityMovementSystem only asks the window for its bounds
+struct TestWindow {
+    Engine::Rectangle GetPosition() {
+        return Engine::Rectangle(0, 0, 100, 100);
+    }
+};
+
+template <typename EngineCoreT>
+struct TestContext {
+    ECS::Engine<EngineCoreT> *engine;
+    TestWindow *window;
+    float *dt;
+};
+
+template <typename EngineCoreT>
+class BIECSSystemsTest : public ::testing::Test {
+  protected:
+    EngineCoreT core;
+    ECS::Engine<EngineCoreT> engineFacade{&core};
+    ECS::Engine<EngineCoreT> *engine = &engineFacade;
+    TestWindow window;
+    float dt = 1;
+    TestContext<EngineCoreT> gameContext{engine, &window, &dt};
+};
+
+using EngineCoreTypes = ::testing::Types<ECS::DefaultEngineCore, ECS::ArchetypeEngineCore>;
+TYPED_TEST_SUITE(BIECSSystemsTest, EngineCoreTypes);
+
+TYPED_TEST(BIECSSystemsTest, MoveAndBounceOffAStaticWall) {
+    auto engine = this->engine;
+
+    auto ball = engine->CreateEntity();
+    engine->AddComponent(ball, BIECS::Transform2D(0, 0));
+    engine->AddComponent(ball, BIECS::Velocity2D(10, 0));
+    engine->AddComponent(ball, BIECS::Rigidbody());
+    engine->AddComponent(ball, BIECS::Collider(0, 0, 10, 10));
+
+    auto wall = engine->CreateEntity();
+    engine->AddComponent(wall, BIECS::Transform2D(25, 8));
+    engine->AddComponent(wall, BIECS::Collider(0, 0, 10, 10));
+    engine->AddComponent(wall, BIECS::StaticCollider());
+
+    auto spatialIndex = new BIECS::SpatialIndexSystem(&this->gameContext);
+    engine->Register(new BIECS::PhysicsSystem(&this->gameContext));
+    engine->Register(new BIECS::CollisionDetectionSystem(&this->gameContext));
+    engine->Register(new BIECS::CollisionResolutionSystem(&this->gameContext));
+    engine->Register(spatialIndex);
+
+    std::vector<ECS::Entity> found;
+
+    // The ball moves by its velocity, the next transform becoming current at the end of the frame
+    engine->CallAll();
+    EXPECT_EQ(*engine->template GetComponent<const BIECS::Transform2D>(ball), BIECS::Transform2D(10, 0));
+
+    spatialIndex->QueryPoint(glm::vec2(15, 5), found);
+    EXPECT_EQ(found, std::vector<ECS::Entity> {ball});
+    spatialIndex->QueryPoint(glm::vec2(30, 12), found);
+    EXPECT_EQ(found, std::vector<ECS::Entity> {wall});
+
+    // Moved into the wall, so the resolution reflects the velocity
+    engine->CallAll();
+    EXPECT_LT(engine->template GetComponent<const BIECS::Velocity2D>(ball)->x, 0);
+
+    // Deleting the wall removes it from the index through the observers
+    engine->DeleteEntity(wall);
+    engine->CallAll();
+    spatialIndex->QueryPoint(glm::vec2(30, 12), found);
+    EXPECT_TRUE(found.empty());
+}
+
+TYPED_TEST(BIECSSystemsTest, VelocityMovementKeepsInsideTheWindow) {
+    auto engine = this->engine;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < 2; i++) {
+        auto entity = engine->CreateEntity();
+        engine->AddComponent(entity, BIECS::Transform2D(80, 10 * i));
+        engine->AddComponent(entity, BIECS::Velocity2D(15, 5));
+        engine->AddComponent(entity, BIECS::Scaling(1, 1));
+        engine->AddComponent(entity, BIECS::Collider(0, 0, 10, 10));
+        engine->AddComponent(entity, BIECS::VelocityMoved());
+        entities.push_back(entity);
+    }
+
+    engine->Register(new BIECS::VelocityMovementSystem(&this->gameContext));
+    engine->CallAll();
+
+    // Moving right would leave the window, so only the move down is kept
+    for (int i = 0; i < 2; i++) {
+        EXPECT_EQ(*engine->template GetComponent<const BIECS::Transform2D>(entities[i]), BIECS::Transform2D(80, 10 * i + 5));
+    }
+}
@@ -27,6 +27,20 @@ struct Component {
     }
 };
 
+SparseSetComponent(Component<5>);
+
+// (entity, component) rows of the pool, in row order
+template <typename ComponentT>
+static std::vector<std::pair<ECS::Entity, ComponentT>> Rows(ECS::ComponentManager<ComponentT> *manager) {
+    std::vector<std::pair<ECS::Entity, ComponentT>> rows;
+
+    for (size_t i = 0; i < manager->GetEntityVector()->size(); i++) {
+        rows.emplace_back((*manager->GetEntityVector())[i], (*manager->GetComponentVector())[i]);
+    }
+
+    return rows;
+}
+
 class ECSComponentManagerTest : public ::testing::Test {
   protected:
     std::unique_ptr<ECS::ComponentManager<Component<1>>> manager;
@@ -115,11 +129,170 @@ TEST_F(ECSComponentManagerTest, GetComponentsAndEntities) {
         manager->RemoveComponent(ECS::Entity(i));
     }
 
-    auto componentsEntities = std::vector<std::pair<ECS::Entity, Component<1>>>(*manager->GetComponentEntityVector());
+    auto componentsEntities = Rows(manager.get());
 
     EXPECT_EQ(componentsEntities, expectedComponentsEntities);
 }
 
+TEST_F(ECSComponentManagerTest, AddComponentTwiceReplaces) {
+    manager->AddComponent(ECS::Entity(1), Component<1>(1, 1));
+    manager->AddComponent(ECS::Entity(1), Component<1>(2, 2));
+
+    EXPECT_EQ(manager->size(), (size_t) 1);
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(1)), Component<1>(2, 2));
+}
+
+TEST_F(ECSComponentManagerTest, AddRemoveComponentsBatched) {
+    const int numEntities = 100;
+    std::vector<std::pair<ECS::Entity, Component<1>>> rows;
+
+    for (int i = numEntities; i >= 1; i -= 2) {
+        manager->AddComponent(ECS::Entity(i), Component<1>(i, 0));
+    }
+
+    for (int i = numEntities - 1; i >= 1; i -= 2) {
+        rows.emplace_back(ECS::Entity(i), Component<1>(i, i));
+    }
+
+    // Existing rows are overwritten
+    rows.emplace_back(ECS::Entity(numEntities), Component<1>(numEntities, numEntities));
+    manager->AddComponents(rows);
+
+    auto componentsEntities = Rows(manager.get());
+    ASSERT_EQ((int) componentsEntities.size(), numEntities);
+
+    for (int i = 0; i < numEntities; i++) {
+        EXPECT_EQ(componentsEntities[i].first, ECS::Entity(i + 1));
+    }
+
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(numEntities)), Component<1>(numEntities, numEntities));
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(3)), Component<1>(3, 3));
+
+    std::vector<ECS::Entity> toRemove;
+
+    for (int i = numEntities; i >= 1; i -= 3) {
+        toRemove.push_back(ECS::Entity(i));
+    }
+
+    toRemove.push_back(ECS::Entity(numEntities * 2));
+    manager->RemoveComponents(toRemove);
+
+    for (int i = 1; i <= numEntities; i++) {
+        EXPECT_EQ(manager->GetComponent(ECS::Entity(i)) == nullptr, (numEntities - i) % 3 == 0);
+    }
+}
+
+TEST_F(ECSComponentManagerTest, DeferredChangesKeepLastPerEntity) {
+    manager->AddComponent(ECS::Entity(2), Component<1>(2, 0));
+    manager->AddComponent(ECS::Entity(4), Component<1>(4, 0));
+
+    manager->SignalViewStarted();
+
+    manager->AddComponent(ECS::Entity(1), Component<1>(1, 1));
+    manager->RemoveComponent(ECS::Entity(1));
+    manager->RemoveComponent(ECS::Entity(2));
+    manager->AddComponent(ECS::Entity(2), Component<1>(2, 2));
+    manager->AddComponent(ECS::Entity(3), Component<1>(3, 1));
+    manager->AddComponent(ECS::Entity(3), Component<1>(3, 3));
+    manager->RemoveComponent(ECS::Entity(4));
+
+    // Nothing changes while the view is alive
+    EXPECT_EQ(manager->size(), (size_t) 2);
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(2)), Component<1>(2, 0));
+
+    manager->SignalViewFinished();
+
+    auto expected = std::vector<std::pair<ECS::Entity, Component<1>>>({
+        {ECS::Entity(2), Component<1>(2, 2)},
+        {ECS::Entity(3), Component<1>(3, 3)}
+    });
+    EXPECT_EQ(Rows(manager.get()), expected);
+}
+
+class ECSSparseSetComponentManagerTest : public ::testing::Test {
+  protected:
+    std::unique_ptr<ECS::ComponentManager<Component<5>>> manager;
+
+    ECSSparseSetComponentManagerTest() {
+        manager = std::make_unique<ECS::ComponentManager<Component<5>>>();
+    }
+};
+
+TEST_F(ECSSparseSetComponentManagerTest, AddRemoveComponent) {
+    EXPECT_TRUE(ECS::ComponentManager<Component<5>>::IsSparseSet());
+
+    const int numEntities = 3 * 10;
+
+    // Insert in reverse order, the storage must not depend on entity order
+    for (int i = numEntities; i >= 1; i--) {
+        manager->AddComponent(ECS::Entity(i), Component<5>(i, i * 2));
+    }
+
+    for (int i = 1; i <= numEntities; i += 3) {
+        manager->RemoveComponent(ECS::Entity(i));
+    }
+
+    // Removing a missing component is a no-op
+    manager->RemoveComponent(ECS::Entity(1));
+    manager->RemoveComponent(ECS::Entity(numEntities * 10));
+
+    EXPECT_EQ(manager->size(), (size_t) (numEntities - numEntities / 3));
+
+    for (int i = 1; i <= numEntities; i++) {
+        auto component = manager->GetComponent(ECS::Entity(i));
+
+        if (i % 3 == 1) {
+            EXPECT_EQ(component, nullptr);
+        } else {
+            EXPECT_EQ(*component, Component<5>(i, i * 2));
+        }
+    }
+
+    manager->AddComponent(ECS::Entity(1), Component<5>(1, 100));
+    manager->AddComponent(ECS::Entity(2), Component<5>(2, 200));
+
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(1)), Component<5>(1, 100));
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(2)), Component<5>(2, 200));
+    EXPECT_EQ(manager->GetComponent(ECS::Entity(4)), nullptr);
+
+    // Same index with another generation is a different entity
+    EXPECT_EQ(manager->GetComponent(ECS::Entity(2, 1)), nullptr);
+    manager->RemoveComponent(ECS::Entity(2, 1));
+    EXPECT_EQ(*manager->GetComponent(ECS::Entity(2)), Component<5>(2, 200));
+}
+
+TEST_F(ECSSparseSetComponentManagerTest, Iterate) {
+    const int numEntities = 20;
+    std::vector<ECS::Entity> entities;
+    std::vector<Component<5>> expectedComponents;
+
+    for (int i = numEntities; i >= 1; i--) {
+        manager->AddComponent(ECS::Entity(i), Component<5>(i, i * 2));
+    }
+
+    for (int i = 1; i <= numEntities; i += 4) {
+        entities.push_back(ECS::Entity(i));
+        expectedComponents.push_back(Component<5>(i, i * 2));
+    }
+
+    std::vector<Component<5>> components;
+
+    {
+        ECS::ComponentJoinView<std::tuple<Component<5>>> view(std::make_shared<const std::vector<ECS::Entity>>(entities), manager.get());
+
+        for (auto [component] : view) {
+            components.push_back(component);
+        }
+
+        // Deferred until the view is destroyed
+        manager->RemoveComponent(ECS::Entity(1));
+        EXPECT_NE(manager->GetComponent(ECS::Entity(1)), nullptr);
+    }
+
+    EXPECT_EQ(manager->GetComponent(ECS::Entity(1)), nullptr);
+    EXPECT_EQ(components, expectedComponents);
+}
+
 TEST(ECSComponentIterator, Iterate) {
     std::unique_ptr<ECS::ComponentManagerBase> managerBase;
     ECS::ComponentManager<Component<1>>* manager;
@@ -131,7 +304,7 @@ TEST(ECSComponentIterator, Iterate) {
     std::vector<ECS::Entity> entities;
 
     for (int i = 1; i < numEntities; i += 4) {
-        entities.push_back(i);
+        entities.push_back(ECS::Entity(i));
     }
 
     std::vector<Component<1>> expectedComponents;
@@ -144,14 +317,11 @@ TEST(ECSComponentIterator, Iterate) {
         }
     }
 
-    auto view = manager->GetView(entities);
+    ECS::ComponentJoinView<std::tuple<Component<1>>> view(std::make_shared<const std::vector<ECS::Entity>>(entities), manager);
     std::vector<Component<1>> components;
 
-    int i = 1;
-
-    for (auto it : view) {
-        components.push_back(it);
-        i++;
+    for (auto [component] : view) {
+        components.push_back(component);
     }
 
     std::sort(components.begin(), components.end());
@@ -170,17 +340,14 @@ TEST(ECSComponentGroupIterator, IterateOneComponentManager) {
     std::vector<ECS::Entity> entities;
 
     for (int i = 1; i < numEntities / 4; i++) {
-        entities.push_back(i);
+        entities.push_back(ECS::Entity(i));
     }
 
     for (int i = 1; i <= numEntities; i++) {
         managers[0]->AddComponent(ECS::Entity(i), Component<1>(i, i * 2));
     }
 
-    std::vector<ECS::ComponentManagerBase*> basePtr;
-    basePtr.push_back(managersBase[0].get());
-    //auto it = ECS::ComponentGroupView<Component<1>>(entities, basePtr);
-    ECS::ComponentGroupView<std::tuple<Component<1>>> view(entities, managers[0]);
+    ECS::ComponentJoinView<std::tuple<Component<1>>> view(std::make_shared<const std::vector<ECS::Entity>>(entities), managers[0]);
     int i = 1;
 
     for (auto it : view) {
@@ -226,19 +393,19 @@ TEST(ECSComponentGroupIterator, IterateMultipleComponentManagers) {
         switch ((i - 1) % numManagers) {
         case 0:
             manager1->AddComponent(ECS::Entity(i), Component<1>(i, i * 1));
-            entities[0].push_back(i);
+            entities[0].push_back(ECS::Entity(i));
 
         case 1:
             manager2->AddComponent(ECS::Entity(i), Component<2>(i, i * 2));
-            entities[1].push_back(i);
+            entities[1].push_back(ECS::Entity(i));
 
         case 2:
             manager3->AddComponent(ECS::Entity(i), Component<3>(i, i * 3));
-            entities[2].push_back(i);
+            entities[2].push_back(ECS::Entity(i));
 
         case 3:
             manager4->AddComponent(ECS::Entity(i), Component<4>(i, i * 4));
-            entities[3].push_back(i);
+            entities[3].push_back(ECS::Entity(i));
         }
     }
 
@@ -309,32 +476,26 @@ TEST(ECSComponentGroupIterator, IterateMultipleComponentManagers) {
         switch ((i - 1) % numManagers) {
         case 0:
             manager1->AddComponent(ECS::Entity(i), Component<1>(i, i * 1));
-            entities[0].push_back(i);
+            entities[0].push_back(ECS::Entity(i));
             [[fallthrough]];
 
         case 1:
             manager2->AddComponent(ECS::Entity(i), Component<2>(i, i * 2));
-            entities[1].push_back(i);
+            entities[1].push_back(ECS::Entity(i));
             [[fallthrough]];
 
         case 2:
             manager3->AddComponent(ECS::Entity(i), Component<3>(i, i * 3));
-            entities[2].push_back(i);
+            entities[2].push_back(ECS::Entity(i));
             [[fallthrough]];
 
         case 3:
             manager4->AddComponent(ECS::Entity(i), Component<4>(i, i * 4));
-            entities[3].push_back(i);
+            entities[3].push_back(ECS::Entity(i));
             [[fallthrough]];
         }
     }
 
-    std::vector<ECS::ComponentManagerBase*> basePtr;
-
-    for (int i = 0; i < numManagers; i++) {
-        basePtr.push_back(managersBase[i].get());
-    }
-
     std::vector<ECS::Entity> entityIntersection = entities[0];
 
     for (int i = 1; i < numManagers; i++) {
@@ -347,12 +508,12 @@ TEST(ECSComponentGroupIterator, IterateMultipleComponentManagers) {
 
     //entityIntersection.erase(entityIntersection.begin() + 1, entityIntersection.end());
 
-    auto view = ECS::ComponentGroupView<std::tuple<Component<1>, Component<2>, Component<3>, Component<4>>>(
-                    entityIntersection,
-                    manager1,
-                    manager2,
-                    manager3,
-                    manager4);
+    ECS::ComponentJoinView<std::tuple<Component<1>, Component<2>, Component<3>, Component<4>>> view(
+                std::make_shared<const std::vector<ECS::Entity>>(entityIntersection),
+                manager1,
+                manager2,
+                manager3,
+                manager4);
 
     int i = 1;
 
@@ -365,3 +526,176 @@ TEST(ECSComponentGroupIterator, IterateMultipleComponentManagers) {
         i += numManagers;
     }
 }
+
+TEST(ECSComponentJoinView, SeekComponent) {
+    ECS::ComponentManager<Component<1>> manager;
+
+    for (int i = 0; i < 100; i++) {
+        manager.AddComponent(ECS::Entity(3 * i + 1), Component<1>(i, i));
+    }
+
+    unsigned int pos = 0;
+
+    for (int i = 0; i < 300; i++) {
+        auto component = manager.SeekComponent(ECS::Entity(i + 1), pos);
+
+        if (i % 3 == 0) {
+            ASSERT_NE(component, nullptr);
+            EXPECT_EQ(*component, Component<1>(i / 3, i / 3));
+        } else {
+            EXPECT_EQ(component, nullptr);
+        }
+    }
+
+    // Seeking backwards restarts the search
+    auto component = manager.SeekComponent(ECS::Entity(1), pos);
+    ASSERT_NE(component, nullptr);
+    EXPECT_EQ(*component, Component<1>(0, 0));
+    EXPECT_EQ(manager.SeekComponent(ECS::Entity(1000), pos), nullptr);
+}
+
+TEST(ECSComponentJoinView, Join) {
+    ECS::ComponentManager<Component<1>> manager1;
+    ECS::ComponentManager<Component<2>> manager2;
+    ECS::ComponentManager<Component<3>> managerOptional;
+    ECS::ComponentManager<Component<5>> managerUnused;
+
+    const int numEntities = 1000;
+
+    for (int i = 1; i <= numEntities; i++) {
+        manager1.AddComponent(ECS::Entity(i), Component<1>(i, 1));
+
+        if (i % 2 == 0) {
+            manager2.AddComponent(ECS::Entity(i), Component<2>(i, 2));
+        }
+
+        if (i % 4 == 0) {
+            managerOptional.AddComponent(ECS::Entity(i), Component<3>(i, 3));
+        }
+    }
+
+    // Sparse set pool filled in descending order
+    for (int i = numEntities; i >= 1; i--) {
+        if (i % 3 == 0) {
+            managerUnused.AddComponent(ECS::Entity(i), Component<5>(i, 5));
+        }
+    }
+
+    std::vector<int> joined;
+
+    {
+        ECS::ComponentJoinView<std::tuple<Component<1>, Component<2>>, std::tuple<Component<3>>> view(&manager1, &manager2, &managerOptional);
+
+        for (auto [component1, component2, optComponent] : view) {
+            EXPECT_EQ(component1.x, component2.x);
+            EXPECT_EQ(optComponent != nullptr, component1.x % 4 == 0);
+
+            if (optComponent) {
+                EXPECT_EQ(optComponent->x, component1.x);
+            }
+
+            joined.push_back(component1.x);
+        }
+    }
+
+    EXPECT_EQ((int) joined.size(), numEntities / 2);
+    EXPECT_TRUE(std::is_sorted(joined.begin(), joined.end()));
+
+    joined.clear();
+
+    {
+        ECS::ComponentJoinView<std::tuple<Component<2>>, std::tuple<>, std::tuple<Component<5>>> view(&manager2, &managerUnused);
+
+        for (auto [component2] : view) {
+            EXPECT_EQ(component2.x % 6, 0);
+            joined.push_back(component2.x);
+        }
+    }
+
+    EXPECT_EQ((int) joined.size(), numEntities / 6);
+
+    joined.clear();
+
+    {
+        auto entities = std::make_shared<const std::vector<ECS::Entity>>(std::vector<ECS::Entity>({ECS::Entity(2), ECS::Entity(3), ECS::Entity(4), ECS::Entity(8), ECS::Entity(999), ECS::Entity(1000)}));
+        ECS::ComponentJoinView<std::tuple<Component<2>>, std::tuple<Component<3>>> view(entities, &manager2, &managerOptional);
+
+        for (auto [component2, optComponent] : view) {
+            joined.push_back(component2.x);
+        }
+    }
+
+    EXPECT_EQ(joined, std::vector<int>({2, 4, 8, 1000}));
+}
+
+struct Tag {};
+
+TEST(ECSTagComponentManager, MembershipBits) {
+    EXPECT_TRUE(ECS::ComponentManager<Tag>::IsTag());
+    EXPECT_FALSE(ECS::ComponentManager<Component<1>>::IsTag());
+
+    ECS::ComponentManager<Tag> tags;
+    ECS::ComponentManager<Component<1>> manager;
+    const int numEntities = 200;
+
+    for (int i = numEntities; i >= 1; i--) {
+        manager.AddComponent(ECS::Entity(i), Component<1>(i, 1));
+
+        if (i % 5 == 0) {
+            tags.AddComponent(ECS::Entity(i), Tag());
+        }
+    }
+
+    auto version = tags.GetVersion();
+    tags.AddComponent(ECS::Entity(5), Tag());
+    EXPECT_EQ(tags.GetVersion(), version);
+
+    tags.RemoveComponents({ECS::Entity(10), ECS::Entity(11), ECS::Entity(15)});
+    EXPECT_NE(tags.GetVersion(), version);
+    EXPECT_EQ(tags.size(), (size_t) (numEntities / 5 - 2));
+
+    EXPECT_NE(tags.GetComponent(ECS::Entity(5)), nullptr);
+    EXPECT_EQ(tags.GetComponent(ECS::Entity(10)), nullptr);
+    EXPECT_EQ(tags.GetComponent(ECS::Entity(5, 1)), nullptr);
+    EXPECT_TRUE(tags.GetEntityVector()->empty());
+
+    std::vector<int> joined;
+
+    {
+        // The tag is the smallest pool and drives the join
+        ECS::ComponentJoinView<std::tuple<Component<1>, Tag>> view(&manager, &tags);
+
+        for (auto [component, tag] : view) {
+            joined.push_back(component.x);
+
+            // Tags flipped during the walk do not move anything
+            if (component.x == 20) {
+                tags.RemoveComponent(ECS::Entity(25));
+                tags.AddComponent(ECS::Entity(21), Tag());
+            }
+        }
+    }
+
+    std::vector<int> expected;
+
+    for (int i = 5; i <= numEntities; i += 5) {
+        if (i != 10 && i != 15 && i != 25) {
+            expected.push_back(i);
+        }
+    }
+
+    EXPECT_EQ(joined, expected);
+
+    joined.clear();
+
+    {
+        ECS::ComponentJoinView<std::tuple<Component<1>>, std::tuple<>, std::tuple<Tag>> view(&manager, &tags);
+
+        for (auto [component] : view) {
+            joined.push_back(component.x);
+        }
+    }
+
+    expected.insert(expected.begin() + 2, 21);
+    EXPECT_EQ(joined, expected);
+}
@@ -67,3 +67,36 @@ TEST(ECSComponentTest, CreateMaskTemplate) {
     EXPECT_EQ(mask, maskUnion);
     EXPECT_EQ(mask, expectedMaskUnion);
 }
+
+TEST(ECSComponentTest, TypeIdDense) {
+    class D {};
+    class E {};
+
+    auto d = ECS::Component<D>::GetTypeId();
+    auto e = ECS::Component<E>::GetTypeId();
+
+    EXPECT_LT(d, (ECS::ID) ECS_MAX_COMPONENT_TYPES);
+    EXPECT_LT(e, (ECS::ID) ECS_MAX_COMPONENT_TYPES);
+    EXPECT_NE(d, e);
+    EXPECT_EQ(d, ECS::Component<D>::GetTypeId());
+}
+
+TEST(ECSComponentTest, MaskContains) {
+    auto mask = ECS::CreateMask({1, 64, 130});
+
+    EXPECT_EQ(mask.size(), (size_t) 3);
+    EXPECT_TRUE(mask.Contains(ECS::CreateMask({1, 130})));
+    EXPECT_TRUE(mask.Contains(ECS::ComponentMask()));
+    EXPECT_FALSE(mask.Contains(ECS::CreateMask({1, 2})));
+    EXPECT_TRUE(mask.Intersects(ECS::CreateMask({2, 64})));
+    EXPECT_FALSE(mask.Intersects(ECS::CreateMask({2, 65})));
+
+    std::vector<ECS::ID> ids(mask.begin(), mask.end());
+    EXPECT_EQ(ids, std::vector<ECS::ID>({1, 64, 130}));
+
+    EXPECT_EQ(mask.erase(64), (size_t) 1);
+    EXPECT_EQ(mask.erase(64), (size_t) 0);
+    EXPECT_EQ(mask.count(64), (size_t) 0);
+    EXPECT_EQ(mask, ECS::CreateMask({1, 130}));
+    EXPECT_EQ(std::hash<ECS::ComponentMask>()(mask), std::hash<ECS::ComponentMask>()(ECS::CreateMask({130, 1})));
+}
@@ -1,9 +1,55 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+
 #include "../../src/ecs/engine.h"
+#include "../../src/ecs/archetype_engine_core.h"
 
-TEST(ECSEngineTest, AddComponent) {
-    ECS::Engine<ECS::DefaultEngineCore> *engine = new ECS::Engine(new ECS::DefaultEngineCore());
+struct Position {
+    float x, y;
+};
+
+struct Speed {
+    float x, y;
+};
+
+FloatArraysComponent(Position, 2);
+FloatArraysComponent(Speed, 2);
+
+struct Heading {
+    float angle;
+};
+
+struct Thrust {
+    float power;
+};
+
+SparseSetComponent(Heading);
+SparseSetComponent(Thrust);
+FloatArraysComponent(Heading, 1);
+FloatArraysComponent(Thrust, 1);
+
+struct Pose {
+    float x, y;
+};
+
+BufferedSparseSetComponent(Pose);
+FloatArraysComponent(Pose, 2);
+
+template <typename EngineCoreT>
+class ECSEngineTest : public ::testing::Test {
+  protected:
+    EngineCoreT core;
+    ECS::Engine<EngineCoreT> engineFacade{&core};
+    ECS::Engine<EngineCoreT> *engine = &engineFacade;
+};
+
+using EngineCoreTypes = ::testing::Types<ECS::DefaultEngineCore, ECS::ArchetypeEngineCore>;
+TYPED_TEST_SUITE(ECSEngineTest, EngineCoreTypes);
+
+TYPED_TEST(ECSEngineTest, AddComponent) {
+    auto engine = this->engine;
 
     const int numEntities = 3 * 3;
     ECS::Entity entities[numEntities];
@@ -37,7 +83,7 @@ TEST(ECSEngineTest, AddComponent) {
         for (; i < numEntities; i++) {
             engine->AddComponent(entities[i], (i));
             engine->AddComponent(entities[i], (1.0f * i));
-            expectedIntAndFloat.push_back(entities[i].GetId());
+            expectedIntAndFloat.push_back(entities[i]);
             expectedInt.push_back(entities[i]);
             expectedFloat.push_back(entities[i]);
         }
@@ -57,12 +103,199 @@ TEST(ECSEngineTest, AddComponent) {
     EXPECT_EQ(matchingIntAndFloat, expectedIntAndFloat);
 }
 
-TEST(ECSEngineTest, GetComponentEmpty) {
-    ECS::Engine<ECS::DefaultEngineCore> *engine = new ECS::Engine(new ECS::DefaultEngineCore());
+TYPED_TEST(ECSEngineTest, GetComponentEmpty) {
+    auto engine = this->engine;
     auto matchingInt = engine->GetEntities(ECS::CreateMask<int>());
     EXPECT_EQ(matchingInt.size(), (size_t) 0);
 }
 
+TEST(ECSDefaultEngineCoreTest, ComponentManagerRegistry) {
+    ECS::DefaultEngineCore core;
+    ECS::Engine<ECS::DefaultEngineCore> engine(&core);
+
+    auto managerInt = engine.GetComponentManager<int>();
+    auto managerFloat = engine.GetComponentManager<float>();
+
+    EXPECT_NE((void *) managerInt, (void *) managerFloat);
+    EXPECT_EQ(managerInt, engine.GetComponentManager<int>());
+    EXPECT_EQ(managerFloat, engine.GetComponentManager<float>());
+
+    auto entity = engine.CreateEntity();
+    engine.AddComponent(entity, 1);
+    engine.AddComponent(entity, 2.0f);
+    engine.DeleteEntity(entity);
+
+    EXPECT_EQ(managerInt->GetComponent(entity), nullptr);
+    EXPECT_EQ(managerFloat->GetComponent(entity), nullptr);
+    EXPECT_EQ(engine.GetComponentManager<ECS::Entity>()->GetComponent(entity), nullptr);
+}
+
+TYPED_TEST(ECSEngineTest, AddComponentKeepsOtherComponents) {
+    auto engine = this->engine;
+
+    const int numEntities = 1000;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < numEntities; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+    }
+
+    for (int i = 0; i < numEntities; i += 2) {
+        engine->AddComponent(entities[i], 2.0f * i);
+    }
+
+    for (int i = 0; i < numEntities; i += 3) {
+        engine->AddComponent(entities[i], -i);
+    }
+
+    for (int i = 0; i < numEntities; i++) {
+        ASSERT_NE(engine->template GetComponent<int>(entities[i]), nullptr);
+        EXPECT_EQ(*engine->template GetComponent<int>(entities[i]), i % 3 == 0 ? -i : i);
+        EXPECT_EQ(*engine->template GetComponent<ECS::Entity>(entities[i]), entities[i]);
+
+        if (i % 2 == 0) {
+            ASSERT_NE(engine->template GetComponent<float>(entities[i]), nullptr);
+            EXPECT_EQ(*engine->template GetComponent<float>(entities[i]), 2.0f * i);
+        } else {
+            EXPECT_EQ(engine->template GetComponent<float>(entities[i]), nullptr);
+        }
+    }
+}
+
+TYPED_TEST(ECSEngineTest, DeleteComponentsAndEntities) {
+    auto engine = this->engine;
+
+    const int numEntities = 1000;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < numEntities; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+        engine->AddComponent(entities[i], 1.0f * i);
+    }
+
+    std::vector<ECS::Entity> expectedFloat;
+
+    for (int i = 0; i < numEntities; i++) {
+        if (i % 2 == 0) {
+            engine->template DeleteComponents<float>(entities[i]);
+        } else if (i % 3 == 0) {
+            engine->DeleteEntity(entities[i]);
+        } else {
+            expectedFloat.push_back(entities[i]);
+        }
+    }
+
+    EXPECT_EQ(engine->GetEntities(ECS::CreateMask<float>()), expectedFloat);
+
+    for (int i = 0; i < numEntities; i++) {
+        if (i % 2 == 0) {
+            ASSERT_NE(engine->template GetComponent<int>(entities[i]), nullptr);
+            EXPECT_EQ(*engine->template GetComponent<int>(entities[i]), i);
+            EXPECT_EQ(engine->template GetComponent<float>(entities[i]), nullptr);
+        } else if (i % 3 != 0) {
+            ASSERT_NE(engine->template GetComponent<float>(entities[i]), nullptr);
+            EXPECT_EQ(*engine->template GetComponent<float>(entities[i]), 1.0f * i);
+        }
+    }
+}
+
+TYPED_TEST(ECSEngineTest, GetGroupView) {
+    auto engine = this->engine;
+
+    const int numEntities = 1000;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < numEntities; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+
+        if (i % 2 == 0) {
+            engine->AddComponent(entities[i], 1.0f * i);
+        }
+
+        if (i % 4 == 0) {
+            engine->AddComponent(entities[i], 1.0 * i);
+        }
+    }
+
+    std::vector<int> values;
+
+    for (auto [entity, valueInt, valueFloat] : engine->template GetGroupView<ECS::Entity, int, float>()) {
+        EXPECT_EQ((int) entity.GetId() - 1, valueInt);
+        EXPECT_EQ(1.0f * valueInt, valueFloat);
+        valueFloat = -valueFloat;
+        values.push_back(valueInt);
+    }
+
+    std::sort(values.begin(), values.end());
+    EXPECT_EQ((int) values.size(), numEntities / 2);
+
+    for (int i = 0; i < (int) values.size(); i++) {
+        EXPECT_EQ(values[i], 2 * i);
+        EXPECT_EQ(*engine->template GetComponent<float>(entities[2 * i]), -2.0f * i);
+    }
+
+    int withOptional = 0;
+
+    for (auto [valueInt, valueDouble] : engine->template GetGroupView<int>(ECS::Optional<double>())) {
+        if (valueInt % 4 == 0) {
+            ASSERT_NE(valueDouble, nullptr);
+            EXPECT_EQ(*valueDouble, 1.0 * valueInt);
+            withOptional++;
+        } else {
+            EXPECT_EQ(valueDouble, nullptr);
+        }
+    }
+
+    EXPECT_EQ(withOptional, numEntities / 4);
+
+    int withUnused = 0;
+
+    for (auto [valueInt] : engine->template GetGroupView<int>(ECS::Unused<double>())) {
+        EXPECT_EQ(valueInt % 4, 0);
+        withUnused++;
+    }
+
+    EXPECT_EQ(withUnused, numEntities / 4);
+}
+
+TYPED_TEST(ECSEngineTest, StructuralChangesDuringIteration) {
+    auto engine = this->engine;
+
+    const int numEntities = 100;
+
+    for (int i = 0; i < numEntities; i++) {
+        auto entity = engine->CreateEntity();
+        engine->AddComponent(entity, i);
+    }
+
+    int iterations = 0;
+
+    for (auto [entity, value] : engine->template GetGroupView<ECS::Entity, int>()) {
+        iterations++;
+
+        if (value % 2 == 0) {
+            engine->DeleteEntity(entity);
+        } else {
+            engine->AddComponent(entity, 1.0f * value);
+        }
+
+        auto spawned = engine->CreateEntity();
+        engine->AddComponent(spawned, numEntities + value);
+    }
+
+    EXPECT_EQ(iterations, numEntities);
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<int>()).size(), numEntities / 2 + numEntities);
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<int, float>()).size(), numEntities / 2);
+
+    for (auto [value, valueFloat] : engine->template GetGroupView<int, float>()) {
+        EXPECT_EQ(value % 2, 1);
+        EXPECT_EQ(1.0f * value, valueFloat);
+    }
+}
+
 /*
 TEST(ECSEngineTest, EntitiesCallFor) {
     ECS::Engine<ECS::DefaultEngineCore> *engine = new ECS::Engine(new ECS::DefaultEngineCore());
@@ -276,15 +509,9 @@ TEST(ECSEngineTest, ComponentsCallForGetComponentsTuple) {
     auto entities2 = engine->GetEntities(mask);
     std::sort(entities2.begin(), entities2.end());
 
-    auto viewInt = engine->GetComponentManagerView<int>(entities2);
-    auto viewFloat = engine->GetComponentManagerView<float>(entities2);
-
-    for (auto component : viewInt) {
-        componentValuesInt.push_back(component);
-    }
-
-    for (auto component : viewFloat) {
-        componentValuesFloat.push_back(component);
+    for (auto [componentInt, componentFloat] : engine->GetGroupView<int, float>()) {
+        componentValuesInt.push_back(componentInt);
+        componentValuesFloat.push_back(componentFloat);
     }
 
     std::sort(componentValuesInt.begin(), componentValuesInt.end());
@@ -403,15 +630,9 @@ TEST(ECSEngineTest, DeleteEntities) {
     auto entities2 = engine->GetEntities(mask);
     std::sort(entities2.begin(), entities2.end());
 
-    auto viewInt = engine->GetComponentManagerView<int>(entities2);
-    auto viewFloat = engine->GetComponentManagerView<float>(entities2);
-
-    for (auto component : viewInt) {
-        componentValuesInt.push_back(component);
-    }
-
-    for (auto component : viewFloat) {
-        componentValuesFloat.push_back(component);
+    for (auto [componentInt, componentFloat] : engine->GetGroupView<int, float>()) {
+        componentValuesInt.push_back(componentInt);
+        componentValuesFloat.push_back(componentFloat);
     }
 
     std::sort(componentValuesInt.begin(), componentValuesInt.end());
@@ -487,3 +708,716 @@ TEST(ECSEngineTest, DeleteEntities) {
     }
 }*/
 
+
+TYPED_TEST(ECSEngineTest, QueryUpdatesIncrementally) {
+    auto engine = this->engine;
+
+    auto query = engine->template CreateQuery<ECS::Entity, int>(ECS::Optional<float>(), ECS::Unused<double>());
+    auto sameQuery = engine->template CreateQuery<ECS::Entity, int>(ECS::Optional<float>(), ECS::Unused<double>());
+    EXPECT_EQ(query.Get(), sameQuery.Get());
+
+    const int numEntities = 100;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < numEntities; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+        engine->AddComponent(entities[i], 1.0 * i);
+
+        if (i % 2 == 0) {
+            engine->AddComponent(entities[i], 1.0f * i);
+        }
+    }
+
+    auto collect = [engine, &query]() {
+        std::vector<int> values;
+
+        for (auto [entity, value, optFloat] : engine->GetGroupView(query)) {
+            EXPECT_EQ(*engine->template GetComponent<int>(entity), value);
+            EXPECT_EQ(optFloat != nullptr, value % 2 == 0);
+            values.push_back(value);
+        }
+
+        std::sort(values.begin(), values.end());
+        return values;
+    };
+
+    std::vector<int> expected;
+
+    for (int i = 0; i < numEntities; i++) {
+        expected.push_back(i);
+    }
+
+    EXPECT_EQ(collect(), expected);
+
+    for (int i = 0; i < numEntities; i += 3) {
+        engine->template DeleteComponents<double>(entities[i]);
+    }
+
+    for (int i = 1; i < numEntities; i += 3) {
+        engine->DeleteEntity(entities[i]);
+    }
+
+    expected.clear();
+
+    for (int i = 2; i < numEntities; i += 3) {
+        expected.push_back(i);
+    }
+
+    EXPECT_EQ(collect(), expected);
+
+    int iterations = 0;
+
+    for (auto [entity, value, optFloat] : engine->GetGroupView(query)) {
+        engine->DeleteEntity(entity);
+        iterations++;
+    }
+
+    EXPECT_EQ(iterations, (int) expected.size());
+    EXPECT_TRUE(collect().empty());
+}
+
+TYPED_TEST(ECSEngineTest, QueryExcludesTypes) {
+    auto engine = this->engine;
+
+    const int numEntities = 30;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < numEntities; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+
+        if (i % 2 == 0) {
+            engine->AddComponent(entities[i], 1.0 * i);
+        }
+    }
+
+    auto query = engine->template CreateQuery<ECS::Entity, int>(ECS::Optional<float>(), ECS::Exclude<double>());
+    auto unfiltered = engine->template CreateQuery<ECS::Entity, int>(ECS::Optional<float>());
+    EXPECT_NE(query.Get(), unfiltered.Get());
+
+    auto collect = [engine, &query]() {
+        std::vector<int> values;
+
+        for (auto [entity, value, optFloat] : engine->GetGroupView(query)) {
+            values.push_back(value);
+        }
+
+        std::sort(values.begin(), values.end());
+        return values;
+    };
+
+    std::vector<int> expected;
+
+    for (int i = 1; i < numEntities; i += 2) {
+        expected.push_back(i);
+    }
+
+    EXPECT_EQ(collect(), expected);
+
+    // Removing the excluded type brings the entity in, adding it takes the entity out
+    engine->template DeleteComponents<double>(entities[0]);
+    engine->AddComponent(entities[1], 1.0);
+    engine->AddComponent(entities[3], 1.0f);
+    expected.erase(expected.begin());
+    expected.insert(expected.begin(), 0);
+
+    EXPECT_EQ(collect(), expected);
+}
+
+TYPED_TEST(ECSEngineTest, ParallelEach) {
+    auto engine = this->engine;
+
+    const int numEntities = 5000;
+
+    for (int i = 0; i < numEntities; i++) {
+        auto entity = engine->CreateEntity();
+        engine->AddComponent(entity, i);
+
+        if (i % 2 == 0) {
+            engine->AddComponent(entity, 1.0f * i);
+        }
+    }
+
+    std::atomic<int> iterations{0};
+
+    engine->template ParallelEach<ECS::Entity, int>([&iterations](auto &commands, ECS::Entity entity, int &value, float *optFloat) {
+        iterations++;
+        EXPECT_EQ(optFloat != nullptr, value % 2 == 0);
+        value *= 2;
+
+        if (value % 3 == 0) {
+            commands.DeleteEntity(entity);
+        } else if (optFloat == nullptr) {
+            commands.AddComponent(entity, 1.0 * value);
+        }
+    }, ECS::Optional<float>());
+
+    EXPECT_EQ(iterations, numEntities);
+
+    int remaining = 0;
+
+    for (auto [value, optDouble] : engine->template GetGroupView<int>(ECS::Optional<double>())) {
+        remaining++;
+        EXPECT_EQ(value % 2, 0);
+        EXPECT_NE(value % 3, 0);
+        EXPECT_EQ(optDouble != nullptr, value % 4 != 0);
+
+        if (optDouble != nullptr) {
+            EXPECT_EQ(*optDouble, 1.0 * value);
+        }
+    }
+
+    EXPECT_EQ(remaining, numEntities - (numEntities + 2) / 3);
+}
+
+TYPED_TEST(ECSEngineTest, ParallelEachBatch) {
+    auto engine = this->engine;
+
+    const int numEntities = 1000;
+
+    for (int i = 0; i < numEntities; i++) {
+        auto entity = engine->CreateEntity();
+        engine->AddComponent(entity, Position{1.0f * i, -1.0f * i});
+
+        if (i % 3 == 0) {
+            engine->AddComponent(entity, Speed{2.0f, 3.0f});
+        }
+    }
+
+    std::atomic<int> rows{0};
+
+    engine->template ParallelEachBatch<ECS::Entity, Position>([&rows](auto &commands, auto &batch) {
+        EXPECT_LE(batch.size(), (size_t) ECS_BATCH_SIZE);
+        // The entities were created in order, so the positions of a batch are consecutive in the pool
+        EXPECT_TRUE(batch.template IsPacked<1>());
+        rows += batch.size();
+
+        const float *speed = batch.template Read<2>();
+        float *position = batch.template Write<1>();
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            EXPECT_EQ(batch.template Get<1>(i)->x, position[2 * i]);
+            EXPECT_EQ(batch.template Get<2>(i) != nullptr, speed[2 * i] != 0);
+
+            position[2 * i] += speed[2 * i];
+            position[2 * i + 1] += speed[2 * i + 1];
+
+            if (batch.template Get<2>(i) == nullptr) {
+                commands.AddComponent(*batch.template Get<0>(i), 1);
+            }
+        }
+    }, ECS::Optional<Speed>());
+
+    EXPECT_EQ(rows, numEntities);
+
+    int moved = 0;
+
+    for (auto [position, optSpeed, optInt] : engine->template GetGroupView<Position>(ECS::Optional<Speed, int>())) {
+        int i = (optSpeed == nullptr) ? (int) position.x : (int) position.x - 2;
+        EXPECT_EQ(position.y, optSpeed == nullptr ? -1.0f * i : -1.0f * i + 3);
+        EXPECT_EQ(optSpeed == nullptr, optInt != nullptr);
+        moved += optSpeed != nullptr;
+    }
+
+    EXPECT_EQ(moved, (numEntities + 2) / 3);
+}
+
+TYPED_TEST(ECSEngineTest, CreateAndDeleteEntitiesInBulk) {
+    auto engine = this->engine;
+
+    auto query = engine->template CreateQuery<ECS::Entity, int>();
+    auto single = engine->CreateEntity();
+    engine->AddComponent(single, 7);
+
+    const int numEntities = 1000;
+    auto entities = engine->CreateEntities(numEntities, 5, 2.0f);
+    ASSERT_EQ((int) entities.size(), numEntities);
+    EXPECT_TRUE(std::is_sorted(entities.begin(), entities.end()));
+
+    std::vector<int> values;
+    std::vector<double> doubles;
+
+    for (int i = 0; i < numEntities; i++) {
+        values.push_back(i);
+        doubles.push_back(0.5 * i);
+    }
+
+    auto perEntity = engine->CreateEntities(values, doubles);
+    ASSERT_EQ((int) perEntity.size(), numEntities);
+    EXPECT_TRUE(engine->CreateEntities(values, std::vector<double>(3)).empty());
+
+    for (int i = 0; i < numEntities; i++) {
+        EXPECT_EQ(*engine->template GetComponent<ECS::Entity>(entities[i]), entities[i]);
+        EXPECT_EQ(*engine->template GetComponent<int>(entities[i]), 5);
+        EXPECT_EQ(*engine->template GetComponent<float>(entities[i]), 2.0f);
+        EXPECT_EQ(*engine->template GetComponent<int>(perEntity[i]), i);
+        EXPECT_EQ(*engine->template GetComponent<double>(perEntity[i]), 0.5 * i);
+        EXPECT_EQ(engine->template GetComponent<float>(perEntity[i]), nullptr);
+    }
+
+    auto count = [engine, &query]() {
+        int iterations = 0;
+
+        for (auto [entity, value] : engine->GetGroupView(query)) {
+            EXPECT_EQ(*engine->template GetComponent<int>(entity), value);
+            iterations++;
+        }
+
+        return iterations;
+    };
+
+    EXPECT_EQ(count(), 2 * numEntities + 1);
+
+    std::vector<ECS::Entity> toDelete;
+
+    for (int i = 0; i < numEntities; i += 2) {
+        toDelete.push_back(entities[i]);
+        toDelete.push_back(perEntity[numEntities - 1 - i]);
+    }
+
+    // Duplicates and stale handles are ignored
+    toDelete.push_back(entities[0]);
+    engine->DeleteEntities(toDelete);
+    engine->DeleteEntities(toDelete);
+
+    EXPECT_EQ(count(), numEntities + 1);
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<float>()).size(), numEntities / 2);
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<double>()).size(), numEntities / 2);
+    EXPECT_EQ(*engine->template GetComponent<int>(single), 7);
+
+    for (int i = 0; i < numEntities; i++) {
+        EXPECT_EQ(engine->IsAlive(entities[i]), i % 2 == 1);
+        EXPECT_EQ(engine->template GetComponent<int>(entities[i]) != nullptr, i % 2 == 1);
+    }
+
+    // Deleted ids are reused smallest first
+    auto reused = engine->CreateEntities(3, 9);
+    EXPECT_EQ(reused[0].GetId(), entities[0].GetId());
+    EXPECT_EQ(reused[1].GetId(), entities[2].GetId());
+    EXPECT_EQ(*engine->template GetComponent<int>(reused[2]), 9);
+}
+
+TYPED_TEST(ECSEngineTest, CommandBuffer) {
+    auto engine = this->engine;
+
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < 10; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], i);
+    }
+
+    ECS::CommandBuffer<TypeParam> commands(&this->core);
+
+    commands.AddComponent(entities[0], 1.0f);
+    commands.template DeleteComponents<float>(entities[0]);
+    commands.template DeleteComponents<int>(entities[1]);
+    commands.AddComponent(entities[2], 2.0f);
+    commands.AddComponent(entities[2], 3.0f);
+    commands.AddComponent(entities[3], 30);
+    commands.DeleteEntity(entities[4]);
+    commands.AddComponent(entities[4], 4.0f);
+    EXPECT_FALSE(commands.empty());
+
+    EXPECT_EQ(engine->template GetComponent<float>(entities[2]), nullptr);
+    commands.Commit();
+    EXPECT_TRUE(commands.empty());
+
+    EXPECT_EQ(engine->template GetComponent<float>(entities[0]), nullptr);
+    EXPECT_EQ(engine->template GetComponent<int>(entities[1]), nullptr);
+    EXPECT_EQ(*engine->template GetComponent<float>(entities[2]), 3.0f);
+    EXPECT_EQ(*engine->template GetComponent<int>(entities[3]), 30);
+    EXPECT_FALSE(engine->IsAlive(entities[4]));
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<int>()).size(), 8);
+    EXPECT_EQ((int) engine->GetEntities(ECS::CreateMask<float>()).size(), 1);
+}
+
+TYPED_TEST(ECSEngineTest, EventChannels) {
+    auto engine = this->engine;
+
+    std::vector<int> received;
+    std::vector<size_t> doubles;
+
+    engine->Register([engine]() {
+        for (int i = 0; i < 5; i++) {
+            engine->template GetEvents<int>().Publish(i);
+        }
+
+        engine->template GetEvents<double>().Publish(std::vector<double> {1.0, 2.0});
+    });
+
+    engine->Register([engine, &received, &doubles]() {
+        for (int event : engine->template GetEvents<int>()) {
+            received.push_back(event);
+        }
+
+        doubles.push_back(engine->template GetEvents<double>().size());
+    });
+
+    engine->CallAll();
+    EXPECT_EQ(received, (std::vector<int> {0, 1, 2, 3, 4}));
+    EXPECT_TRUE(engine->template GetEvents<int>().empty());
+    EXPECT_TRUE(engine->template GetEvents<double>().empty());
+
+    engine->CallAll();
+    EXPECT_EQ(received.size(), 10u);
+    EXPECT_EQ(doubles, (std::vector<size_t> {2, 2}));
+}
+
+TYPED_TEST(ECSEngineTest, ComponentVersion) {
+    auto engine = this->engine;
+
+    auto first = engine->CreateEntity();
+    auto second = engine->CreateEntity();
+    engine->AddComponent(first, 1);
+
+    auto version = engine->template GetComponentVersion<int>();
+    int *component = engine->template GetComponent<int>(first);
+
+    // Overwriting keeps the rows in place
+    engine->AddComponent(first, 2);
+    EXPECT_EQ(engine->template GetComponentVersion<int>(), version);
+    EXPECT_EQ(engine->template GetComponent<int>(first), component);
+    EXPECT_EQ(*component, 2);
+
+    engine->AddComponent(second, 3);
+    EXPECT_NE(engine->template GetComponentVersion<int>(), version);
+
+    version = engine->template GetComponentVersion<int>();
+    engine->template DeleteComponents<int>(first);
+    EXPECT_NE(engine->template GetComponentVersion<int>(), version);
+}
+
+TYPED_TEST(ECSEngineTest, BufferedNextValuesBecomeCurrentAtEndOfFrame) {
+    auto engine = this->engine;
+    std::vector<ECS::Entity> entities;
+
+    for (int i = 0; i < 4; i++) {
+        entities.push_back(engine->CreateEntity());
+        engine->AddComponent(entities[i], Pose{1.0f * i, 0});
+    }
+
+    auto version = engine->template GetComponentVersion<Pose>();
+    auto current = engine->template GetComponent<const Pose>(entities[1]);
+
+    engine->template GetNextComponent<Pose>(entities[1])->y = 5;
+    EXPECT_EQ(current->y, 0);
+    EXPECT_EQ(engine->template GetLatestComponent<Pose>(entities[1])->x, 1);
+    EXPECT_EQ(engine->template GetLatestComponent<Pose>(entities[1])->y, 5);
+    EXPECT_EQ(engine->template GetLatestComponent<Pose>(entities[2])->y, 0);
+
+    // Const elements read the current values, the other ones write the next values
+    for (auto [entity, pose] : engine->template GetGroupView<ECS::Entity, const Pose>()) {
+        EXPECT_EQ(pose.y, 0);
+    }
+
+    for (auto [pose] : engine->template GetGroupView<Pose>()) {
+        pose.x += 10;
+    }
+
+    EXPECT_EQ(current->x, 1);
+    EXPECT_EQ(engine->template GetLatestComponent<Pose>(entities[1])->x, 11);
+
+    // GetComponent<T> writes the next value as well, so the view's write to the same row does not replace it
+    engine->template GetComponent<Pose>(entities[2])->y = 3;
+
+    engine->CallAll();
+
+    for (int i = 0; i < 4; i++) {
+        EXPECT_EQ(engine->template GetComponent<const Pose>(entities[i])->x, 10.0f + i);
+    }
+
+    EXPECT_EQ(current->y, 5);
+    EXPECT_EQ(engine->template GetComponent<const Pose>(entities[2])->y, 3);
+    EXPECT_EQ(engine->template GetComponentVersion<Pose>(), version);
+
+    // The next values move with their rows
+    engine->template GetNextComponent<Pose>(entities[3])->y = 7;
+    engine->template DeleteComponents<Pose>(entities[0]);
+
+    engine->template ParallelEachBatch<Pose>([](auto &, auto &batch) {
+        float *pose = batch.template Write<0>();
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            pose[2 * i + 1] += 1;
+        }
+    });
+
+    engine->AddComponent(entities[2], 1);
+    engine->CallAll();
+
+    EXPECT_EQ(engine->template GetComponent<const Pose>(entities[1])->y, 6);
+    EXPECT_EQ(engine->template GetComponent<const Pose>(entities[2])->y, 4);
+    EXPECT_EQ(engine->template GetComponent<const Pose>(entities[3])->y, 8);
+}
+
+TYPED_TEST(ECSEngineTest, ChangedAndAddedSinceLastRun) {
+    auto engine = this->engine;
+
+    auto first = engine->CreateEntity();
+    auto second = engine->CreateEntity();
+    engine->AddComponent(first, Position{1, 1});
+    engine->AddComponent(second, Position{2, 2});
+
+    std::vector<ECS::Entity> changed;
+    std::vector<ECS::Entity> added;
+
+    engine->Register([&]() {
+        changed.clear();
+        added.clear();
+
+        for (auto [entity, position] : engine->template GetGroupView<ECS::Entity, const Position>(ECS::Changed<Position>())) {
+            changed.push_back(entity);
+        }
+
+        for (auto [entity] : engine->template GetGroupView<ECS::Entity>(ECS::Added<Position>())) {
+            added.push_back(entity);
+        }
+
+        std::sort(changed.begin(), changed.end());
+        std::sort(added.begin(), added.end());
+
+        // The per entity checks agree with the filters
+        for (auto entity : {first, second}) {
+            EXPECT_EQ(engine->template IsChanged<Position>(entity), std::find(changed.begin(), changed.end(), entity) != changed.end());
+            EXPECT_EQ(engine->template IsAdded<Position>(entity), std::find(added.begin(), added.end(), entity) != added.end());
+        }
+    });
+
+    engine->CallAll();
+    EXPECT_EQ(changed, (std::vector<ECS::Entity> {first, second}));
+    EXPECT_EQ(added, (std::vector<ECS::Entity> {first, second}));
+
+    engine->CallAll();
+    EXPECT_TRUE(changed.empty());
+    EXPECT_TRUE(added.empty());
+
+    // Taking a mutable pointer counts as a change, reading through a const view does not
+    engine->template GetComponent<Position>(second)->x = 3;
+
+    for (auto [position] : engine->template GetGroupView<const Position>()) {
+        EXPECT_GT(position.x, 0);
+    }
+
+    std::atomic<int> filtered{0};
+
+    engine->template ParallelEach<ECS::Entity, const Position>([&](auto &, ECS::Entity entity, const Position &) {
+        EXPECT_EQ(entity, second);
+        filtered++;
+    }, ECS::Changed<Position>());
+
+    EXPECT_EQ(filtered, 1);
+    engine->CallAll();
+    EXPECT_EQ(changed, (std::vector<ECS::Entity> {second}));
+    EXPECT_TRUE(added.empty());
+
+    // Non-const view elements are stamped as they are handed out
+    auto third = engine->CreateEntity();
+    engine->AddComponent(third, Position{4, 4});
+
+    for (auto [position] : engine->template GetGroupView<Position>()) {
+        position.y += 1;
+    }
+
+    engine->CallAll();
+    EXPECT_EQ(changed, (std::vector<ECS::Entity> {first, second, third}));
+    EXPECT_EQ(added, (std::vector<ECS::Entity> {third}));
+
+    engine->template ParallelEachBatch<Position>([](auto &, auto &batch) {
+        float *positions = batch.template Write<0>();
+
+        for (size_t i = 0; i < 2 * batch.size(); i++) {
+            positions[i] += 1;
+        }
+    });
+
+    engine->CallAll();
+    EXPECT_EQ(changed, (std::vector<ECS::Entity> {first, second, third}));
+    EXPECT_TRUE(added.empty());
+}
+
+TYPED_TEST(ECSEngineTest, ObserversSeeAddReplaceAndRemove) {
+    auto engine = this->engine;
+
+    std::vector<std::pair<ECS::Entity, float>> added;
+    std::vector<std::pair<ECS::Entity, float>> replaced;
+    std::vector<std::pair<ECS::Entity, float>> removed;
+    std::vector<ECS::Entity> addedBatch;
+
+    engine->template OnAdd<Position>([&](ECS::Entity entity, Position &position) {
+        added.push_back({entity, position.x});
+    });
+    auto replaceHandle = engine->template OnReplace<Position>([&](ECS::Entity entity, Position &position) {
+        replaced.push_back({entity, position.x});
+    });
+    engine->template OnRemove<Position>([&](ECS::Entity entity, Position &position) {
+        removed.push_back({entity, position.x});
+    });
+    engine->template OnAdd<Position>([&](const std::vector<ECS::Entity> &entities) {
+        addedBatch.insert(addedBatch.end(), entities.begin(), entities.end());
+    }, ECS::Batched());
+
+    auto first = engine->CreateEntity();
+    auto second = engine->CreateEntity();
+    engine->AddComponent(first, Position{1, 0});
+    engine->AddComponent(first, Position{2, 0});
+    engine->AddComponent(second, Position{3, 0});
+
+    EXPECT_EQ(added, (std::vector<std::pair<ECS::Entity, float>> {{first, 1}, {second, 3}}));
+    EXPECT_EQ(replaced, (std::vector<std::pair<ECS::Entity, float>> {{first, 2}}));
+    EXPECT_TRUE(addedBatch.empty());
+
+    engine->Unobserve(replaceHandle);
+    engine->AddComponent(first, Position{2, 0});
+    EXPECT_EQ(replaced.size(), 1u);
+
+    // Changes made while a view is alive are observed when they are committed
+    for (auto [entity, position] : engine->template GetGroupView<ECS::Entity, Position>()) {
+        if (entity == second) {
+            engine->template DeleteComponents<Position>(entity);
+        }
+    }
+
+    EXPECT_EQ(removed, (std::vector<std::pair<ECS::Entity, float>> {{second, 3}}));
+
+    engine->DeleteEntity(first);
+    EXPECT_EQ(removed, (std::vector<std::pair<ECS::Entity, float>> {{second, 3}, {first, 2}}));
+
+    engine->CallAll();
+    EXPECT_EQ(addedBatch, (std::vector<ECS::Entity> {first, second}));
+}
+
+// The first size() rows of every owned pool hold the same entities, and those are exactly the entities having
+// all of the owned components
+static void ExpectPacked(ECS::Engine<ECS::DefaultEngineCore> &engine, std::vector<ECS::Entity> expected) {
+    auto headings = engine.GetComponents<Heading>();
+    auto headingEntities = engine.GetComponentEntities<Heading>();
+    auto thrusts = engine.GetComponents<Thrust>();
+    auto thrustEntities = engine.GetComponentEntities<Thrust>();
+    size_t size = engine.GetComponentManager<Heading>()->GetOwningGroup()->size();
+    std::vector<ECS::Entity> packed;
+
+    ASSERT_EQ(size, expected.size());
+
+    for (size_t i = 0; i < size; i++) {
+        EXPECT_EQ((*headingEntities)[i], (*thrustEntities)[i]);
+        EXPECT_EQ((*headings)[i].angle, (*thrusts)[i].power);
+        packed.push_back((*headingEntities)[i]);
+    }
+
+    std::sort(packed.begin(), packed.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(packed, expected);
+
+    std::vector<ECS::Entity> joined;
+
+    for (auto [entity, heading, thrust, speed] : engine.GetGroupView<ECS::Entity, Heading, Thrust>(ECS::Optional<Speed>())) {
+        EXPECT_EQ(heading.angle, thrust.power);
+        EXPECT_EQ(speed != nullptr, entity.GetId() % 2 == 0);
+        joined.push_back(entity);
+    }
+
+    std::sort(joined.begin(), joined.end());
+    EXPECT_EQ(joined, expected);
+}
+
+TEST(ECSEngineOwnedGroupTest, PacksAndKeepsPrefix) {
+    ECS::DefaultEngineCore core;
+    ECS::Engine<ECS::DefaultEngineCore> engine(&core);
+    std::vector<ECS::Entity> entities;
+    std::vector<ECS::Entity> expected;
+
+    for (int i = 0; i < 30; i++) {
+        auto entity = engine.CreateEntity();
+        entities.push_back(entity);
+        float value = (float) entity.GetId();
+
+        if (i % 3 != 0) {
+            engine.AddComponent(entity, Heading{value});
+        }
+
+        if (i % 2 != 0) {
+            engine.AddComponent(entity, Thrust{value});
+        }
+
+        if (entity.GetId() % 2 == 0) {
+            engine.AddComponent(entity, Speed{value, value});
+        }
+
+        if (i % 3 != 0 && i % 2 != 0) {
+            expected.push_back(entity);
+        }
+    }
+
+    engine.CreateOwnedGroup<Heading, Thrust>();
+    engine.CreateOwnedGroup<Heading, Thrust>();
+    ExpectPacked(engine, expected);
+
+    // Joining and leaving the group
+    engine.AddComponent(entities[0], Heading{(float) entities[0].GetId()});
+    engine.AddComponent(entities[0], Thrust{(float) entities[0].GetId()});
+    engine.DeleteComponents<Heading>(entities[1]);
+    engine.DeleteEntity(entities[5]);
+    expected.erase(std::remove(expected.begin(), expected.end(), entities[1]), expected.end());
+    expected.erase(std::remove(expected.begin(), expected.end(), entities[5]), expected.end());
+    expected.push_back(entities[0]);
+    ExpectPacked(engine, expected);
+
+    // Changes made while a view of any owned pool is alive are applied when it finishes
+    for (auto [entity, heading] : engine.GetGroupView<ECS::Entity, Heading>()) {
+        if (entity == entities[2]) {
+            engine.AddComponent(entity, Thrust{heading.angle});
+            engine.DeleteComponents<Thrust>(entities[7]);
+        }
+    }
+
+    expected.erase(std::remove(expected.begin(), expected.end(), entities[7]), expected.end());
+    expected.push_back(entities[2]);
+    ExpectPacked(engine, expected);
+
+    engine.DeleteEntities(expected);
+    ExpectPacked(engine, {});
+}
+
+TEST(ECSEngineOwnedGroupTest, BatchesWorkOnThePrefix) {
+    ECS::DefaultEngineCore core;
+    ECS::Engine<ECS::DefaultEngineCore> engine(&core);
+    const int numEntities = 300;
+
+    for (int i = 0; i < numEntities; i++) {
+        auto entity = engine.CreateEntity();
+        engine.AddComponent(entity, Heading{1.0f * i});
+
+        if (i % 4 != 0) {
+            engine.AddComponent(entity, Thrust{0.5f});
+        }
+    }
+
+    engine.CreateOwnedGroup<Heading, Thrust>();
+
+    const Heading *prefix = engine.GetComponents<Heading>()->data();
+    int rows = 0;
+
+    engine.ParallelEachBatch<Heading, Thrust>([&](auto &, auto &batch) {
+        EXPECT_TRUE(batch.template IsPacked<0>());
+        EXPECT_TRUE(batch.template IsPacked<1>());
+        EXPECT_EQ(batch.template Get<0>(0), prefix + rows);
+
+        float *heading = batch.template Write<0>();
+        const float *thrust = batch.template Read<1>();
+        EXPECT_EQ(heading, &batch.template Get<0>(0)->angle);
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            heading[i] += thrust[i];
+        }
+
+        rows += batch.size();
+    });
+
+    EXPECT_EQ(rows, numEntities - numEntities / 4);
+
+    for (auto [heading, thrust] : engine.GetGroupView<Heading>(ECS::Optional<Thrust>())) {
+        EXPECT_EQ(heading.angle != (int) heading.angle, thrust != nullptr);
+    }
+}
@@ -1,10 +1,23 @@
 #include "../../src/ecs/entity.h"
 #include "../../src/ecs/engine.h"
 
+#include "../../src/ecs/archetype_engine_core.h"
+
 #include "gtest/gtest.h"
 
-TEST(ECSEntityTest, Id) {
-    auto engine = new ECS::Engine(new ECS::DefaultEngineCore());
+template <typename EngineCoreT>
+class ECSEntityTest : public ::testing::Test {
+  protected:
+    EngineCoreT core;
+    ECS::Engine<EngineCoreT> engineFacade{&core};
+    ECS::Engine<EngineCoreT> *engine = &engineFacade;
+};
+
+using EntityEngineCoreTypes = ::testing::Types<ECS::DefaultEngineCore, ECS::ArchetypeEngineCore>;
+TYPED_TEST_SUITE(ECSEntityTest, EntityEngineCoreTypes);
+
+TYPED_TEST(ECSEntityTest, Id) {
+    auto engine = this->engine;
 
     const int numEntities = 3;
     ECS::Entity entities[numEntities];
@@ -19,8 +32,8 @@ TEST(ECSEntityTest, Id) {
     }
 }
 
-TEST(ECSEntityTest, IdReusedTrivial) {
-    auto engine = new ECS::Engine(new ECS::DefaultEngineCore());
+TYPED_TEST(ECSEntityTest, IdReusedTrivial) {
+    auto engine = this->engine;
 
     const int numEntities = 10;
     ECS::Entity entities[numEntities];
@@ -35,7 +48,7 @@ TEST(ECSEntityTest, IdReusedTrivial) {
     }
 
     for (int i = 0; i < numEntities; i++) {
-        engine->DeleteEntity(entities[i].GetId());
+        engine->DeleteEntity(entities[i]);
     }
 
     for (int i = 0; i < numEntities; i++) {
@@ -48,8 +61,8 @@ TEST(ECSEntityTest, IdReusedTrivial) {
     }
 }
 
-TEST(ECSEntityTest, IdReusedIntertwined) {
-    auto engine = new ECS::Engine(new ECS::DefaultEngineCore());
+TYPED_TEST(ECSEntityTest, IdReusedIntertwined) {
+    auto engine = this->engine;
 
     const int numEntities = 10;
     ECS::Entity entities[numEntities];
@@ -66,7 +79,7 @@ TEST(ECSEntityTest, IdReusedIntertwined) {
     for (int i = numEntities - 1; i >= 0; i--) {
         ECS::ID id = entities[i].GetId();
 
-        engine->DeleteEntity(entities[i].GetId());
+        engine->DeleteEntity(entities[i]);
 
         entities[i] = engine->CreateEntity();
         EXPECT_EQ(entities[i].GetId(), id);
@@ -80,3 +93,53 @@ TEST(ECSEntityTest, IdReusedIntertwined) {
         }
     }
 }
+
+TYPED_TEST(ECSEntityTest, IdReusedLowestFirst) {
+    auto engine = this->engine;
+
+    const int numEntities = 10;
+    ECS::Entity entities[numEntities];
+
+    for (int i = 0; i < numEntities; i++) {
+        entities[i] = engine->CreateEntity();
+    }
+
+    engine->DeleteEntity(entities[7]);
+    engine->DeleteEntity(entities[2]);
+    engine->DeleteEntity(entities[5]);
+
+    EXPECT_EQ(engine->CreateEntity().GetId(), entities[2].GetId());
+    EXPECT_EQ(engine->CreateEntity().GetId(), entities[5].GetId());
+    EXPECT_EQ(engine->CreateEntity().GetId(), entities[7].GetId());
+    EXPECT_EQ(engine->CreateEntity().GetId(), (ECS::ID) numEntities + 1u);
+}
+
+TYPED_TEST(ECSEntityTest, StaleHandles) {
+    auto engine = this->engine;
+
+    auto stale = engine->CreateEntity();
+    engine->AddComponent(stale, 1);
+    EXPECT_TRUE(engine->IsAlive(stale));
+
+    engine->DeleteEntity(stale);
+    EXPECT_FALSE(engine->IsAlive(stale));
+
+    auto reused = engine->CreateEntity();
+    engine->AddComponent(reused, 2);
+
+    EXPECT_EQ(reused.GetId(), stale.GetId());
+    EXPECT_NE(reused.GetGeneration(), stale.GetGeneration());
+    EXPECT_NE(reused, stale);
+    EXPECT_FALSE(engine->IsAlive(stale));
+    EXPECT_TRUE(engine->IsAlive(reused));
+
+    EXPECT_EQ(engine->template GetComponent<int>(stale), nullptr);
+    engine->AddComponent(stale, 3);
+    engine->template DeleteComponents<int>(stale);
+    engine->DeleteEntity(stale);
+
+    EXPECT_TRUE(engine->IsAlive(reused));
+    ASSERT_NE(engine->template GetComponent<int>(reused), nullptr);
+    EXPECT_EQ(*engine->template GetComponent<int>(reused), 2);
+    EXPECT_EQ(engine->GetEntities(ECS::CreateMask<int>()), std::vector<ECS::Entity>({reused}));
+}
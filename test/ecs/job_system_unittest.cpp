@@ -0,0 +1,60 @@
+#include "../../src/ecs/job_system.h"
+
+#include <atomic>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+TEST(ECSJobSystemTest, RunsEveryJobOnce) {
+    ECS::JobSystem jobs(4);
+    EXPECT_EQ(jobs.GetThreadsCount(), 4u);
+
+    const size_t numJobs = 1000;
+
+    for (int repeat = 0; repeat < 10; repeat++) {
+        std::vector<std::atomic<int>> runs(numJobs);
+        std::atomic<bool> validThreads{true};
+
+        jobs.Run(numJobs, [&](size_t job, unsigned int thread) {
+            runs[job]++;
+
+            if (thread >= jobs.GetThreadsCount()) {
+                validThreads = false;
+            }
+        });
+
+        for (auto &count : runs) {
+            EXPECT_EQ(count, 1);
+        }
+
+        EXPECT_TRUE(validThreads);
+    }
+}
+
+TEST(ECSJobSystemTest, NestedRun) {
+    ECS::JobSystem jobs(3);
+
+    std::atomic<int> total{0};
+
+    jobs.Run(8, [&](size_t job, unsigned int thread) {
+        jobs.Run(job, [&](size_t, unsigned int nestedThread) {
+            EXPECT_EQ(nestedThread, thread);
+            total++;
+        });
+    });
+
+    EXPECT_EQ(total, 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7);
+}
+
+TEST(ECSJobSystemTest, SingleThread) {
+    ECS::JobSystem jobs(1);
+
+    std::vector<size_t> order;
+
+    jobs.Run(5, [&](size_t job, unsigned int thread) {
+        EXPECT_EQ(thread, 0u);
+        order.push_back(job);
+    });
+
+    EXPECT_EQ(order, std::vector<size_t>({0, 1, 2, 3, 4}));
+}
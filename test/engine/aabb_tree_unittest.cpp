@@ -0,0 +1,119 @@
+#include "../../src/engine/aabb_tree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+static bool Overlaps(const Engine::Rectangle &a, const Engine::Rectangle &b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+static std::vector<uint32_t> Sorted(std::vector<uint32_t> values) {
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+TEST(AABBTreeTest, QueriesMatchLinearScan) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(0, 1000);
+    std::uniform_real_distribution<float> size(1, 40);
+    std::uniform_real_distribution<float> step(-10, 10);
+
+    Engine::AABBTree tree(2.0f);
+    std::vector<Engine::Rectangle> boxes;
+    std::vector<int> proxies;
+    std::vector<bool> alive;
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        boxes.push_back(Engine::Rectangle(position(random), position(random), size(random), size(random)));
+        proxies.push_back(tree.CreateProxy(boxes[i], i));
+        alive.push_back(true);
+    }
+
+    for (int frame = 0; frame < 10; frame++) {
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (!alive[i]) {
+                continue;
+            }
+
+            if (frame == 5 && i % 3 == 0) {
+                tree.DestroyProxy(proxies[i]);
+                alive[i] = false;
+                continue;
+            }
+
+            boxes[i].x += step(random);
+            boxes[i].y += step(random);
+            tree.MoveProxy(proxies[i], boxes[i]);
+        }
+    }
+
+    int aliveCount = (int) std::count(alive.begin(), alive.end(), true);
+    EXPECT_EQ(tree.GetProxiesCount(), aliveCount);
+    EXPECT_LE(tree.GetHeight(), 2 * (int) std::ceil(std::log2(aliveCount)));
+
+    std::vector<uint32_t> result;
+
+    for (int query = 0; query < 100; query++) {
+        Engine::Rectangle area(position(random), position(random), 4 * size(random), 4 * size(random));
+        std::vector<uint32_t> expected;
+
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (alive[i] && Overlaps(area, boxes[i])) {
+                expected.push_back(i);
+            }
+        }
+
+        tree.QueryAABB(area, result);
+        EXPECT_EQ(Sorted(result), expected);
+
+        float x = position(random);
+        float y = position(random);
+        expected.clear();
+
+        for (uint32_t i = 0; i < boxes.size(); i++) {
+            if (alive[i] && Overlaps(Engine::Rectangle(x, y, 0, 0), boxes[i])) {
+                expected.push_back(i);
+            }
+        }
+
+        tree.QueryPoint(x, y, result);
+        EXPECT_EQ(Sorted(result), expected);
+    }
+}
+
+TEST(AABBTreeTest, RaycastSortsHitsByDistance) {
+    Engine::AABBTree tree;
+    tree.CreateProxy(Engine::Rectangle(30, -5, 10, 10), 0);
+    tree.CreateProxy(Engine::Rectangle(10, -5, 10, 10), 1);
+    tree.CreateProxy(Engine::Rectangle(10, 20, 10, 10), 2);
+    tree.CreateProxy(Engine::Rectangle(-5, -5, 10, 10), 3);
+    int moving = tree.CreateProxy(Engine::Rectangle(100, -5, 10, 10), 4);
+
+    std::vector<Engine::AABBTree::RayHit> hits;
+    tree.Raycast(0, 0, 2, 0, 50, hits);
+
+    ASSERT_EQ(hits.size(), 3u);
+    EXPECT_EQ(hits[0].data, 3u);
+    EXPECT_FLOAT_EQ(hits[0].distance, 0);
+    EXPECT_EQ(hits[1].data, 1u);
+    EXPECT_FLOAT_EQ(hits[1].distance, 10);
+    EXPECT_EQ(hits[2].data, 0u);
+    EXPECT_FLOAT_EQ(hits[2].distance, 30);
+
+    // Small moves stay inside the enlarged box, the ray only sees the moved box
+    EXPECT_FALSE(tree.MoveProxy(moving, Engine::Rectangle(101, -5, 10, 10)));
+    tree.Raycast(0, 0, 1, 0, 1000, hits);
+    ASSERT_EQ(hits.size(), 4u);
+    EXPECT_EQ(hits[3].data, 4u);
+    EXPECT_FLOAT_EQ(hits[3].distance, 101);
+
+    tree.Raycast(15, 0, 0, 1, 100, hits);
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(hits[0].data, 1u);
+    EXPECT_EQ(hits[1].data, 2u);
+    EXPECT_FLOAT_EQ(hits[1].distance, 20);
+}
@@ -0,0 +1,88 @@
+#include "../../src/engine/contact_islands.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+static const unsigned int STATIC = Engine::ContactIslands::STATIC_BODY;
+
+static std::vector<std::vector<unsigned int>> GetIslands(const Engine::ContactIslands &islands) {
+    std::vector<std::vector<unsigned int>> result;
+
+    for (size_t island = 0; island < islands.GetIslandsCount(); island++) {
+        result.emplace_back(islands.GetContacts().begin() + islands.GetOffsets()[island],
+                            islands.GetContacts().begin() + islands.GetOffsets()[island + 1]);
+    }
+
+    return result;
+}
+
+TEST(ContactIslandsTest, GroupsConnectedContacts) {
+    Engine::ContactIslands islands;
+    islands.Clear(6);
+
+    islands.Add(0, 1);
+    islands.Add(2, STATIC);
+    islands.Add(3, 4);
+    islands.Add(1, 5);
+    // The static body does not connect 2 and 3
+    islands.Add(STATIC, 3);
+    islands.Add(STATIC, STATIC);
+    islands.Add(5, 1);
+    islands.Build();
+
+    auto expected = std::vector<std::vector<unsigned int>> {{0, 3, 6}, {1}, {2, 4}, {5}};
+    EXPECT_EQ(GetIslands(islands), expected);
+}
+
+TEST(ContactIslandsTest, IslandsShareNoBody) {
+    std::mt19937 random(11);
+    const unsigned int bodies = 500;
+    std::uniform_int_distribution<unsigned int> body(0, bodies + 50);
+
+    std::vector<std::pair<unsigned int, unsigned int>> contacts;
+    Engine::ContactIslands islands;
+    islands.Clear(bodies);
+
+    for (int i = 0; i < 400; i++) {
+        // Indices past the bodies count stand for static bodies
+        auto a = body(random), b = body(random);
+        contacts.push_back({a < bodies ? a : STATIC, b < bodies ? b : STATIC});
+        islands.Add(contacts.back().first, contacts.back().second);
+    }
+
+    islands.Build();
+
+    std::vector<int> islandOfBody(bodies, -1);
+    std::vector<bool> seen(contacts.size(), false);
+    auto result = GetIslands(islands);
+
+    for (size_t island = 0; island < result.size(); island++) {
+        for (size_t i = 0; i < result[island].size(); i++) {
+            auto contact = result[island][i];
+            ASSERT_FALSE(seen[contact]);
+            seen[contact] = true;
+
+            if (i > 0) {
+                EXPECT_LT(result[island][i - 1], contact);
+            }
+
+            for (auto b : {contacts[contact].first, contacts[contact].second}) {
+                if (b == STATIC) {
+                    continue;
+                }
+
+                if (islandOfBody[b] < 0) {
+                    islandOfBody[b] = island;
+                }
+
+                EXPECT_EQ(islandOfBody[b], (int) island);
+            }
+        }
+    }
+
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), true), (long) contacts.size());
+}
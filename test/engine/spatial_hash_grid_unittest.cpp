@@ -0,0 +1,118 @@
+#include "../../src/engine/spatial_hash_grid.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+static bool Overlaps(const Engine::Rectangle &a, const Engine::Rectangle &b) {
+    return a.x <= b.x + b.w && b.x <= a.x + a.w && a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+TEST(SpatialHashGridTest, FindsEveryOverlap) {
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> position(0, 1000);
+    std::uniform_real_distribution<float> size(1, 40);
+
+    std::vector<Engine::Rectangle> boxes;
+
+    for (int i = 0; i < 2000; i++) {
+        boxes.push_back(Engine::Rectangle(position(random), position(random), size(random), size(random)));
+    }
+
+    // Oversized box, touching boxes and a box inside another one
+    boxes.push_back(Engine::Rectangle(-5000, -5000, 20000, 20000));
+    boxes.push_back(Engine::Rectangle(2000, 2000, 10, 10));
+    boxes.push_back(Engine::Rectangle(2010, 2000, 10, 10));
+    boxes.push_back(Engine::Rectangle(2002, 2002, 2, 2));
+
+    for (float cellSize : {0.0f, 5.0f, 64.0f, 5000.0f}) {
+        Engine::SpatialHashGrid grid(cellSize);
+
+        for (auto &box : boxes) {
+            grid.Insert(box);
+        }
+
+        auto pairs = grid.FindPairs();
+        EXPECT_TRUE(std::is_sorted(pairs.begin(), pairs.end()));
+        EXPECT_TRUE(std::adjacent_find(pairs.begin(), pairs.end()) == pairs.end());
+
+        std::vector<std::pair<unsigned int, unsigned int>> overlapping;
+
+        for (auto [i, j] : pairs) {
+            EXPECT_LT(i, j);
+
+            if (Overlaps(boxes[i], boxes[j])) {
+                overlapping.push_back({i, j});
+            }
+        }
+
+        std::vector<std::pair<unsigned int, unsigned int>> expected;
+
+        for (unsigned int i = 0; i < boxes.size(); i++) {
+            for (unsigned int j = i + 1; j < boxes.size(); j++) {
+                if (Overlaps(boxes[i], boxes[j])) {
+                    expected.push_back({i, j});
+                }
+            }
+        }
+
+        EXPECT_EQ(overlapping, expected);
+
+        if (cellSize > 0) {
+            EXPECT_EQ(grid.GetCellSize(), cellSize);
+        }
+    }
+}
+
+TEST(SpatialHashGridTest, SkipsFarBoxes) {
+    Engine::SpatialHashGrid grid(10);
+
+    grid.Insert(Engine::Rectangle(0, 0, 5, 5));
+    grid.Insert(Engine::Rectangle(100, 100, 5, 5));
+    grid.Insert(Engine::Rectangle(3, 3, 5, 5));
+
+    auto pairs = grid.FindPairs();
+    ASSERT_EQ(pairs.size(), 1u);
+    EXPECT_EQ(pairs[0], std::make_pair(0u, 2u));
+
+    grid.Clear();
+    EXPECT_TRUE(grid.FindPairs().empty());
+}
+
+TEST(SpatialHashGridTest, QueryFindsEveryOverlap) {
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(0, 500);
+    std::uniform_real_distribution<float> size(1, 60);
+
+    Engine::SpatialHashGrid grid;
+    std::vector<Engine::Rectangle> boxes;
+
+    for (int i = 0; i < 300; i++) {
+        boxes.push_back(Engine::Rectangle(position(random), position(random), size(random), size(random)));
+        grid.Insert(boxes.back());
+    }
+
+    grid.Build();
+
+    std::vector<unsigned int> result;
+
+    for (int i = 0; i < 300; i++) {
+        Engine::Rectangle box(position(random), position(random), size(random), size(random));
+        grid.Query(box, result);
+
+        EXPECT_TRUE(std::is_sorted(result.begin(), result.end()));
+        EXPECT_TRUE(std::adjacent_find(result.begin(), result.end()) == result.end());
+
+        for (unsigned int j = 0; j < boxes.size(); j++) {
+            if (Overlaps(box, boxes[j])) {
+                EXPECT_TRUE(std::binary_search(result.begin(), result.end(), j));
+            }
+        }
+    }
+
+    grid.Query(Engine::Rectangle(-1e6, -1e6, 2e6, 2e6), result);
+    EXPECT_EQ(result.size(), boxes.size());
+}